@@ -0,0 +1,47 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "tiny_glfw_renderer.h"
+
+using namespace tiny_glfw_renderer;
+
+const std::string SHADER_DIR = "../example/shaders/";
+const std::string MODEL_DIR = "../example/models/";
+const std::string MVP_VERT = SHADER_DIR + "mvp.vert";
+const std::string FRAG = SHADER_DIR + "point.frag";
+
+int main() {
+    Initialize();
+    Window window(640, 480, "Test");
+
+    const GLuint program(LoadProgram(MVP_VERT, FRAG));
+    const GLint model_location(glGetUniformLocation(program, "model"));
+    const GLint view_location(glGetUniformLocation(program, "view"));
+    const GLint proj_location(glGetUniformLocation(program, "projection"));
+
+    // parsed on worker threads, uploaded at most 64KiB per frame
+    AssetLoader loader;
+    auto cube = loader.load(MODEL_DIR + "cube.obj");
+
+    glClearColor(1.0f, 1.0f, 1.0f, 0.0f);
+    glfwSetTime(0.0);
+    while (window.ShouldClose() == GL_FALSE) {
+        glClear(GL_COLOR_BUFFER_BIT);
+        loader.update(64 << 10);
+
+        glUseProgram(program);
+
+        const Matrix model(Matrix::Rotate(window.GetTime(), 0.0f, 1.0f, 0.0f));
+        glUniformMatrix4fv(model_location, 1, GL_FALSE, model.Data());
+        static constexpr Matrix view(Matrix::LookAt(
+            3.0f, 4.0f, 5.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+        glUniformMatrix4fv(view_location, 1, GL_FALSE, view.Data());
+        const GLfloat fovy(window.GetScale() * 0.01f);
+        const Matrix projection(
+            Matrix::Perspective(fovy, window.GetAspect(), 1.0f, 10.0f));
+        glUniformMatrix4fv(proj_location, 1, GL_FALSE, projection.Data());
+
+        if (cube->ready()) cube->get()->draw(GL_LINE_LOOP);
+        window.SwapBuffers();
+    }
+}
@@ -0,0 +1,59 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "tiny_glfw_renderer.h"
+
+using namespace tiny_glfw_renderer;
+
+int main() {
+    Initialize();
+    Window window(640, 480, "Test");
+
+    // thousands of annotation boxes and leader lines in one draw call;
+    // S toggles between the keep_aspect and keep_scale mappings
+    SpriteBatch batch(16384);
+    SpriteBatch::Fit fit(SpriteBatch::KEEP_ASPECT);
+
+    glClearColor(1.0f, 1.0f, 1.0f, 0.0f);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    bool reported(false);
+    while (window.ShouldClose() == GL_FALSE) {
+        InputEvent e;
+        while (window.PollEvent(e)) {
+            if (e.type == InputEvent::KEY && e.action == GLFW_PRESS &&
+                e.code == GLFW_KEY_S) {
+                fit = fit == SpriteBatch::KEEP_ASPECT
+                          ? SpriteBatch::KEEP_SCALE
+                          : SpriteBatch::KEEP_ASPECT;
+            }
+        }
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        const GLfloat t(static_cast<GLfloat>(window.GetTime()));
+        batch.begin(window, fit);
+        for (int j = 0; j < 40; j++) {
+            for (int i = 0; i < 50; i++) {
+                const GLfloat x(-1.0f + i * 0.04f), y(-0.9f + j * 0.045f);
+                const GLfloat pulse(0.5f + 0.5f * std::sin(t + 0.1f * i));
+                batch.fillRect(x, y, 0.03f, 0.03f,
+                               {{pulse, 0.2f, 1.0f - pulse, 0.3f}});
+                batch.rect(x, y, 0.03f, 0.03f, 1.0f,
+                           {{0.1f, 0.1f, 0.1f, 1.0f}});
+            }
+        }
+        for (int i = 0; i < 32; i++) {
+            const GLfloat a(6.2831853f * i / 32 + 0.2f * t);
+            batch.line(0.0f, 0.0f, 0.8f * std::cos(a), 0.8f * std::sin(a),
+                       2.0f, {{0.0f, 0.0f, 0.0f, 0.8f}});
+        }
+        batch.end();
+        if (!reported) {
+            std::cout << "draw calls per frame: " << batch.draws()
+                      << std::endl;
+            reported = true;
+        }
+
+        window.SwapBuffers();
+    }
+}
@@ -0,0 +1,95 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "tiny_glfw_renderer.h"
+
+using namespace tiny_glfw_renderer;
+
+const std::string SHADER_DIR = "../example/shaders/";
+const std::string MVP_VERT = SHADER_DIR + "naive_mvp.vert";
+const std::string FRAG = SHADER_DIR + "clustered.frag";
+
+int main() {
+    Initialize();
+    Window window(640, 480, "Test");
+
+    // uniform locations and block bindings are reflected at link time
+    Program program(LoadProgram(MVP_VERT, FRAG, true));
+
+    // material
+    static constexpr Material color = {{{0.6f, 0.6f, 0.6f}},  // Kamb
+                                       {{0.6f, 0.6f, 0.6f}},  // Kdiff
+                                       {{0.3f, 0.3f, 0.3f}},  // Kspec
+                                       30.0f};                // Kshi
+    const Uniform<Material> material(&color);
+    const GLuint material_binding(program.binding("Material"_hash));
+
+    // 256 small lights on rings around a floor of spheres
+    static constexpr int Lcount(256);
+    LightManager lights;
+    lights.attach(program.id());
+    for (int i = 0; i < Lcount; i++) {
+        const GLfloat h(static_cast<GLfloat>(i % 3) / 2.0f);
+        const PointLight l = {{{0.0f, 0.0f, 0.0f, 1.0f}},
+                              {{0.02f, 0.02f, 0.02f}},
+                              {{1.0f - h, 0.3f + 0.5f * h, h}},
+                              {{0.5f, 0.5f, 0.5f}},
+                              1.5f};
+        lights.add(l);
+    }
+
+    auto sphere = SolidSphere(16);
+
+    GLfloat normal_mat[9];
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+    glFrontFace(GL_CCW);
+    glCullFace(GL_BACK);
+    glEnable(GL_CULL_FACE);
+    glClearDepth(1.0);
+    glDepthFunc(GL_LESS);
+    glEnable(GL_DEPTH_TEST);
+
+    glfwSetTime(0.0);
+    while (window.ShouldClose() == GL_FALSE) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        program.use();
+
+        const GLfloat t(static_cast<GLfloat>(window.GetTime()));
+        for (int i = 0; i < Lcount; i++) {
+            const GLfloat a(0.3f * t + 6.2831853f * i / Lcount);
+            const GLfloat r(2.0f + 6.0f * (i % 16) / 16.0f);
+            lights.light(i).position = {
+                {r * std::cos(a), 0.3f, r * std::sin(a), 1.0f}};
+        }
+
+        // view/projection
+        static constexpr Matrix view(Matrix::LookAt(
+            0.0f, 8.0f, 14.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+        program.set("view"_hash, view);
+        const GLfloat fovy(window.GetScale() * 0.01f);
+        const GLfloat aspect(window.GetAspect());
+        const Matrix projection(
+            Matrix::Perspective(fovy, aspect, 1.0f, 40.0f));
+        program.set("projection"_hash, projection);
+
+        // cluster the lights for this view
+        lights.update(view, fovy, aspect, 1.0f, 40.0f, window.GetWidth(),
+                      window.GetHeight());
+        lights.bind();
+
+        material.select(0, material_binding);
+        for (int z = -8; z <= 8; z += 2) {
+            for (int x = -8; x <= 8; x += 2) {
+                const Matrix model(Matrix::TRS(x, 0.0f, z, Matrix::Identity(),
+                                               0.8f, 0.8f, 0.8f));
+                program.set("model"_hash, model);
+                (view * model).GetNormalMatrix(normal_mat);
+                program.set("normal_mat"_hash, normal_mat);
+                sphere->draw(GL_TRIANGLES);
+            }
+        }
+
+        window.SwapBuffers();
+    }
+}
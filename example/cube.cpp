@@ -13,23 +13,10 @@ int main() {
     Initialize();
     Window window(640, 480, "Test");
 
-    const GLuint program(LoadProgram(MVP_VERT, FRAG, true));
-
-    // mvp
-    const GLint model_location(glGetUniformLocation(program, "model"));
-    const GLint view_location(glGetUniformLocation(program, "view"));
-    const GLint proj_location(glGetUniformLocation(program, "projection"));
-
-    // light
-    const GLint normal_location(glGetUniformLocation(program, "normal_mat"));
-    const GLint Lpos_location(glGetUniformLocation(program, "Lpos"));
-    const GLint Lamb_location(glGetUniformLocation(program, "Lamb"));
-    const GLint Ldiff_location(glGetUniformLocation(program, "Ldiff"));
-    const GLint Lspec_location(glGetUniformLocation(program, "Lspec"));
+    // uniform locations and block bindings are reflected at link time
+    Program program(LoadProgram(MVP_VERT, FRAG, true));
 
     // material
-    const GLint material_location(glGetUniformBlockIndex(program, "material"));
-    glUniformBlockBinding(program, material_location, 0);
     static constexpr Material color[] = {{{{0.6f, 0.6f, 0.2f}},  // Kamb
                                           {{0.6f, 0.6f, 0.2f}},  // Kdiff
                                           {{0.3f, 0.3f, 0.3f}},  // Kspec
@@ -39,6 +26,7 @@ int main() {
                                           {{0.4f, 0.4f, 0.4f}},
                                           60.0f}};
     const Uniform<Material> material(color, 2);
+    const GLuint material_binding(program.binding("Material"_hash));
 
     // geometry
     auto cube = SolidCube(1.0f);
@@ -47,6 +35,7 @@ int main() {
     // light
     GLfloat normal_mat[9];
     static constexpr int Lcount(2);
+    Vector view_Lpos[Lcount];
     static constexpr Vector Lpos[] = {{{0.0f, 0.0f, 5.0f, 1.0f}},
                                       {{8.0f, 0.0f, 0.0f, 1.0f}}};
     static constexpr GLfloat Lamb[] = {0.2f, 0.1f, 0.1f, 0.1f, 0.1f, 0.1f};
@@ -69,55 +58,54 @@ int main() {
     while (window.ShouldClose() == GL_FALSE) {
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        glUseProgram(program);
+        program.use();
 
         // translation
         const GLfloat *const position(window.GetLocation());
-        const Matrix r(Matrix::Rotate(glfwGetTime(), 0.0f, 1.0f, 0.0f));
+        const Matrix r(Matrix::Rotate(window.GetTime(), 0.0f, 1.0f, 0.0f));
         const Matrix translation(
             Matrix::Translate(position[0], position[1], 0.0f) * r);
 
         // model matrix
         const Matrix model(translation);
-        glUniformMatrix4fv(model_location, 1, GL_FALSE, model.Data());
+        program.set("model"_hash, model);
 
         // view matrix
-        const Matrix view(Matrix::LookAt(3.0f, 4.0f, 5.0f, 0.0f, 0.0f, 0.0f,
-                                         0.0f, 1.0f, 0.0f));
-        glUniformMatrix4fv(view_location, 1, GL_FALSE, view.Data());
+        static constexpr Matrix view(Matrix::LookAt(
+            3.0f, 4.0f, 5.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+        program.set("view"_hash, view);
 
         // normal
         const Matrix modelview(view * model);
         modelview.GetNormalMatrix(normal_mat);
-        glUniformMatrix3fv(normal_location, 1, GL_FALSE, normal_mat);
+        program.set("normal_mat"_hash, normal_mat);
 
         // projection matrix
         const GLfloat fovy(window.GetScale() * 0.01f);
         const GLfloat aspect(window.GetAspect());
         const Matrix projection(Matrix::Perspective(fovy, aspect, 1.0f, 10.0f));
-        glUniformMatrix4fv(proj_location, 1, GL_FALSE, projection.Data());
+        program.set("projection"_hash, projection);
 
         // light
-        for (int i = 0; i < Lcount; i++) {
-            glUniform4fv(Lpos_location + i, 1, (view * Lpos[i]).data());
-        }
-        glUniform3fv(Lamb_location, Lcount, Lamb);
-        glUniform3fv(Ldiff_location, Lcount, Ldiff);
-        glUniform3fv(Lspec_location, Lcount, Lspec);
-
-        material.select(0);
+        for (int i = 0; i < Lcount; i++) view_Lpos[i] = view * Lpos[i];
+        program.set("Lpos"_hash, view_Lpos[0].data(), Lcount);
+        program.set("Lamb"_hash, Lamb, Lcount);
+        program.set("Ldiff"_hash, Ldiff, Lcount);
+        program.set("Lspec"_hash, Lspec, Lcount);
+
+        material.select(0, material_binding);
         sphere->draw(GL_TRIANGLES);
 
         // model2
         const Matrix model2(translation * Matrix::Translate(0.0f, 0.0f, 3.0f));
-        glUniformMatrix4fv(model_location, 1, GL_FALSE, model2.Data());
+        program.set("model"_hash, model2);
 
         // normals
         const Matrix modelview2(view * model2);
         modelview2.GetNormalMatrix(normal_mat);
-        glUniformMatrix3fv(normal_location, 1, GL_FALSE, normal_mat);
+        program.set("normal_mat"_hash, normal_mat);
 
-        material.select(1);
+        material.select(1, material_binding);
         cube->draw(GL_TRIANGLES);
 
         window.SwapBuffers();
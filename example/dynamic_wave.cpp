@@ -0,0 +1,73 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "tiny_glfw_renderer.h"
+
+using namespace tiny_glfw_renderer;
+
+const std::string SHADER_DIR = "../example/shaders/";
+const std::string ASPECT_VERT = SHADER_DIR + "keep_aspect.vert";
+const std::string FRAG = SHADER_DIR + "point.frag";
+
+int main() {
+    Initialize();
+    Window window(640, 480, "Test");
+
+    const GLuint program(LoadProgram(ASPECT_VERT, FRAG));
+    const GLint aspect_location(glGetUniformLocation(program, "aspect"));
+
+    static constexpr GLsizei samples(256);
+    DynamicGeometry2D wave(2, samples);
+
+    // A string driven at its left end. The wave equation is integrated at
+    // a fixed 120 Hz whatever the frame rate, which keeps it stable, and
+    // drawn between the last two steps.
+    FixedTimestep clock(1.0 / 120.0);
+    const GLfloat dx(2.0f / (samples - 1));
+    const GLfloat speed(0.5f);
+    const GLfloat k(std::pow(speed * static_cast<GLfloat>(clock.step()) / dx,
+                             2.0f));
+    std::vector<GLfloat> prev(samples, 0.0f), curr(samples, 0.0f);
+    std::vector<GLfloat> next(samples, 0.0f);
+    double simulated(0.0);
+
+    // uncapped swaps, paced by the limiter instead
+    window.SetSwapInterval(0);
+    FrameLimiter limiter(120.0);
+
+    glClearColor(1.0f, 1.0f, 1.0f, 0.0f);
+    glfwSetTime(0.0);
+    while (window.ShouldClose() == GL_FALSE) {
+        for (int n = clock.advance(window.GetTime()); n > 0; n--) {
+            simulated += clock.step();
+            next[0] = 0.25f * static_cast<GLfloat>(std::sin(3.0 * simulated));
+            for (GLsizei i = 1; i + 1 < samples; i++) {
+                next[i] = curr[i] + 0.998f * (curr[i] - prev[i]) +
+                          k * (curr[i - 1] - 2.0f * curr[i] + curr[i + 1]);
+            }
+            prev.swap(curr);
+            curr.swap(next);
+        }
+
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        glUseProgram(program);
+        glUniform1f(aspect_location, window.GetAspect());
+
+        // regenerate vertices directly into the mapped ring region
+        const GLfloat alpha(clock.alpha());
+        wave.begin(samples);
+        Vertex2D* const vtx(wave.mapVertices());
+        if (vtx != nullptr) {
+            for (GLsizei i = 0; i < samples; i++) {
+                const GLfloat x(dx * i - 1.0f);
+                vtx[i] = {{x, prev[i] + alpha * (curr[i] - prev[i])}};
+            }
+            wave.unmapVertices();
+        }
+
+        wave.draw(GL_LINE_STRIP);
+        limiter.wait();
+        window.SwapBuffers();
+    }
+}
@@ -0,0 +1,79 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "tiny_glfw_renderer.h"
+
+using namespace tiny_glfw_renderer;
+
+// Compares a captured run (TGR_CAPTURE=<name> ./<example>.out) against its
+// golden files:
+//   golden.out <golden>.ppm <capture>.ppm [<golden>.csv <capture>.csv]
+// Fails when a golden file is missing, more than 0.1% of the pixels differ
+// noticeably or the median frame time grows by more than 10%. With
+// TGR_BLESS set the golden files are (re)written from the capture instead.
+static constexpr double DELTA_E(2.3);
+static constexpr double BAD_FRACTION(0.001);
+static constexpr double SLOWDOWN(1.10);
+
+static bool Bless(const std::string& golden, const std::string& capture) {
+    std::ifstream src(capture, std::ios::binary);
+    std::ofstream dst(golden, std::ios::binary);
+    dst << src.rdbuf();
+    std::cout << "Blessed " << golden << std::endl;
+    return dst.good();
+}
+
+static bool Missing(const std::string& golden) {
+    if (std::ifstream(golden).good()) return false;
+    std::cout << "FAIL missing " << golden << " (bless with TGR_BLESS=1)"
+              << std::endl;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 3 && argc != 5) {
+        std::cerr << "Usage: " << argv[0]
+                  << " golden.ppm capture.ppm [golden.csv capture.csv]"
+                  << std::endl;
+        return 2;
+    }
+    const bool bless(std::getenv("TGR_BLESS") != nullptr);
+    bool pass(true);
+
+    Image golden, capture;
+    if (!ReadImage(argv[2], capture)) return 1;
+    if (bless) {
+        pass = Bless(argv[1], argv[2]);
+    } else if (Missing(argv[1])) {
+        pass = false;
+    } else if (ReadImage(argv[1], golden)) {
+        const ImageDiff diff(CompareImages(golden, capture, DELTA_E));
+        const bool ok(diff.bad_fraction <= BAD_FRACTION);
+        std::cout << (ok ? "PASS" : "FAIL") << " image: mean dE " << diff.mean
+                  << ", max dE " << diff.max << ", "
+                  << 100.0 * diff.bad_fraction << "% above " << DELTA_E
+                  << std::endl;
+        pass = pass && ok;
+    } else {
+        pass = false;
+    }
+
+    if (argc == 5) {
+        FrameStats base, run;
+        if (!ReadFrameStats(argv[4], run)) return 1;
+        if (bless) {
+            pass = Bless(argv[3], argv[4]) && pass;
+        } else if (Missing(argv[3])) {
+            pass = false;
+        } else if (ReadFrameStats(argv[3], base)) {
+            const bool ok(run.median <= base.median * SLOWDOWN);
+            std::cout << (ok ? "PASS" : "FAIL") << " time: median "
+                      << run.median << " ms (golden " << base.median
+                      << " ms), p95 " << run.p95 << " ms" << std::endl;
+            pass = pass && ok;
+        } else {
+            pass = false;
+        }
+    }
+    return pass ? 0 : 1;
+}
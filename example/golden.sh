@@ -0,0 +1,28 @@
+#!/bin/sh
+# Runs every example headlessly for a fixed number of frames and compares
+# the last frame and the frame times with example/golden/ (or $TGR_GOLDEN).
+# Run from the build directory. A missing golden file fails; run with
+# TGR_BLESS=1 to (re)write the golden files from this run.
+set -u
+GOLDEN=${TGR_GOLDEN:-../example/golden}
+CAPTURE=captures
+FRAMES=${TGR_FRAMES:-120}
+mkdir -p "$GOLDEN" "$CAPTURE"
+
+status=0
+for exe in ./*.out; do
+    name=$(basename "$exe" .out)
+    # async_load and point_cloud stream from worker threads, so their last
+    # frame depends on timing
+    case "$name" in golden | replay | async_load | point_cloud) continue ;; esac
+    echo "== $name"
+    if ! TGR_CAPTURE="$CAPTURE/$name" TGR_FRAMES="$FRAMES" "$exe" \
+        > /dev/null; then
+        echo "FAIL run"
+        status=1
+        continue
+    fi
+    ./golden.out "$GOLDEN/$name.ppm" "$CAPTURE/$name.ppm" \
+        "$GOLDEN/$name.csv" "$CAPTURE/$name.csv" || status=1
+done
+exit $status
@@ -0,0 +1,107 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "tiny_glfw_renderer.h"
+
+using namespace tiny_glfw_renderer;
+
+const std::string SHADER_DIR = "../example/shaders/";
+const std::string MVP_VERT = SHADER_DIR + "naive_mvp.vert";
+const std::string FRAG = SHADER_DIR + "normal_point.frag";
+
+// Dense bumpy sphere standing in for a scanned mesh.
+static void Scan(int samples, std::vector<Vertex3D>& vtx,
+                 std::vector<GLuint>& idx) {
+    const float PI = 3.141592653f;
+    const int slices(2 * samples), stacks(samples);
+    for (int j = 0; j <= stacks; j++) {
+        const float t(PI * j / stacks);
+        for (int i = 0; i <= slices; i++) {
+            const float s(2.0f * PI * i / slices);
+            const float n[3] = {std::sin(t) * std::sin(s), std::cos(t),
+                                std::sin(t) * std::cos(s)};
+            const float r(1.0f +
+                          0.05f * std::sin(12.0f * s) * std::sin(9.0f * t));
+            vtx.push_back(
+                {{r * n[0], r * n[1], r * n[2]}, {n[0], n[1], n[2]}});
+        }
+    }
+    for (int j = 0; j < stacks; j++) {
+        for (int i = 0; i < slices; i++) {
+            const GLuint k0(j * (slices + 1) + i), k1(k0 + 1);
+            const GLuint k2(k0 + slices + 1), k3(k2 + 1);
+            for (GLuint k : {k0, k2, k3, k0, k3, k1}) idx.emplace_back(k);
+        }
+    }
+}
+
+int main() {
+    Initialize();
+    Window window(640, 480, "Test");
+
+    Program program(LoadProgram(MVP_VERT, FRAG, true));
+    static constexpr Material color[] = {{{{0.5f, 0.5f, 0.5f}},
+                                          {{0.6f, 0.6f, 0.6f}},
+                                          {{0.3f, 0.3f, 0.3f}},
+                                          30.0f}};
+    const Uniform<Material> material(color, 1);
+
+    std::vector<Vertex3D> vtx;
+    std::vector<GLuint> idx;
+    Scan(400, vtx, idx);
+    MeshletGeometry mesh(static_cast<GLsizei>(vtx.size()), vtx.data(),
+                         static_cast<GLsizei>(idx.size()), idx.data());
+    std::cout << idx.size() / 3 << " triangles in " << mesh.meshlets().size()
+              << " meshlets" << std::endl;
+
+    static constexpr Vector Lpos[] = {{{0.0f, 0.0f, 5.0f, 1.0f}},
+                                      {{8.0f, 0.0f, 0.0f, 1.0f}}};
+    static constexpr GLfloat Lamb[] = {0.2f, 0.1f, 0.1f, 0.1f, 0.1f, 0.1f};
+    static constexpr GLfloat Ldiff[] = {1.0f, 0.5f, 0.5f, 0.9f, 0.9f, 0.9f};
+    static constexpr GLfloat Lspec[] = {1.0f, 0.5f, 0.5f, 0.9f, 0.9f, 0.9f};
+
+    glClearColor(0.1f, 0.1f, 0.4f, 0.0f);
+    glFrontFace(GL_CCW);
+    glCullFace(GL_BACK);
+    glEnable(GL_CULL_FACE);
+    glEnable(GL_DEPTH_TEST);
+
+    int frame(0);
+    while (window.ShouldClose() == GL_FALSE) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        program.use();
+
+        const GLfloat *const position(window.GetLocation());
+        const Matrix model(
+            Matrix::Translate(2.0f * position[0], 2.0f * position[1], 0.0f) *
+            Matrix::Rotate(window.GetTime(), 0.0f, 1.0f, 0.0f));
+        static constexpr Matrix view(Matrix::LookAt(
+            0.0f, 0.0f, 3.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+        const Matrix projection(
+            Matrix::Perspective(window.GetScale() * 0.01f, window.GetAspect(),
+                                1.0f, 10.0f));
+        const Matrix modelview(view * model);
+        GLfloat normal_mat[9];
+        modelview.GetNormalMatrix(normal_mat);
+        program.set("model"_hash, model);
+        program.set("view"_hash, view);
+        program.set("projection"_hash, projection);
+        program.set("normal_mat"_hash, normal_mat);
+        Vector view_Lpos[2] = {view * Lpos[0], view * Lpos[1]};
+        program.set("Lpos"_hash, view_Lpos[0].data(), 2);
+        program.set("Lamb"_hash, Lamb, 2);
+        program.set("Ldiff"_hash, Ldiff, 2);
+        program.set("Lspec"_hash, Lspec, 2);
+        material.select(0, program.binding("Material"_hash));
+
+        // back-facing and off-screen clusters never reach the rasterizer
+        const GLsizei kept(mesh.cull(modelview, projection));
+        mesh.draw();
+        if (frame++ % 120 == 0) {
+            std::cout << kept << " triangles drawn in " << mesh.ranges()
+                      << " ranges" << std::endl;
+        }
+
+        window.SwapBuffers();
+    }
+}
@@ -0,0 +1,140 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "tiny_glfw_renderer.h"
+
+using namespace tiny_glfw_renderer;
+
+const std::string SHADER_DIR = "../example/shaders/";
+const std::string DEPTH_VERT = SHADER_DIR + "depth.vert";
+const std::string DEPTH_FRAG = SHADER_DIR + "point.frag";
+const std::string MVP_VERT = SHADER_DIR + "naive_mvp.vert";
+const std::string FRAG = SHADER_DIR + "normal_point.frag";
+
+int main() {
+    Initialize();
+    Window window(640, 480, "Test");
+
+    // P toggles the depth pre-pass, O toggles occlusion culling
+    bool prepass(true), culling(true);
+
+    Program depth(LoadProgram(DEPTH_VERT, DEPTH_FRAG));
+    Program program(LoadProgram(MVP_VERT, FRAG, true));
+
+    static constexpr Material color[] = {{{{0.6f, 0.6f, 0.2f}},
+                                          {{0.6f, 0.6f, 0.2f}},
+                                          {{0.3f, 0.3f, 0.3f}},
+                                          30.0f}};
+    const Uniform<Material> material(color, 1);
+    const GLuint material_binding(program.binding("Material"_hash));
+
+    // a wall in front of a dense grid of spheres
+    auto cube = SolidCube(1.0f);
+    auto sphere = SolidSphere(32);
+    static constexpr int grid(16);
+    std::vector<Matrix> models;
+    models.emplace_back(Matrix::Translate(0.0f, 0.0f, 2.0f) *
+                        Matrix::Scale(3.0f, 2.0f, 0.1f));
+    for (int z = 0; z < grid; z++) {
+        for (int x = 0; x < grid; x++) {
+            models.emplace_back(Matrix::Translate(x - 0.5f * grid, 0.0f, -z) *
+                                Matrix::Scale(0.4f, 0.4f, 0.4f));
+        }
+    }
+    const GLsizei count(static_cast<GLsizei>(models.size()));
+    auto draw = [&](GLsizei i) {
+        if (i == 0) {
+            cube->draw(GL_TRIANGLES);
+        } else {
+            sphere->draw(GL_TRIANGLES);
+        }
+    };
+    OcclusionCuller culler(count);
+
+    static constexpr Vector Lpos[] = {{{0.0f, 0.0f, 5.0f, 1.0f}},
+                                      {{8.0f, 0.0f, 0.0f, 1.0f}}};
+    static constexpr GLfloat Lamb[] = {0.2f, 0.1f, 0.1f, 0.1f, 0.1f, 0.1f};
+    static constexpr GLfloat Ldiff[] = {1.0f, 0.5f, 0.5f, 0.9f, 0.9f, 0.9f};
+    static constexpr GLfloat Lspec[] = {1.0f, 0.5f, 0.5f, 0.9f, 0.9f, 0.9f};
+
+    glClearColor(0.1f, 0.1f, 0.4f, 0.0f);
+    glFrontFace(GL_CCW);
+    glCullFace(GL_BACK);
+    glEnable(GL_CULL_FACE);
+    glClearDepth(1.0);
+    glEnable(GL_DEPTH_TEST);
+
+    glfwSetTime(0.0);
+    while (window.ShouldClose() == GL_FALSE) {
+        InputEvent e;
+        while (window.PollEvent(e)) {
+            if (e.type != InputEvent::KEY || e.action != GLFW_PRESS) continue;
+            if (e.code == GLFW_KEY_P) prepass = !prepass;
+            if (e.code == GLFW_KEY_O) culling = !culling;
+        }
+
+        glDepthMask(GL_TRUE);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        const GLfloat *const position(window.GetLocation());
+        const GLfloat eye[] = {position[0], position[1] + 1.0f, 6.0f};
+        const Matrix view(Matrix::LookAt(eye[0], eye[1], eye[2], eye[0],
+                                         0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+        const Matrix projection(
+            Matrix::Perspective(window.GetScale() * 0.01f, window.GetAspect(),
+                                1.0f, 30.0f));
+
+        // depth only, skipping what was hidden last frame
+        depth.use();
+        depth.set("view"_hash, view);
+        depth.set("projection"_hash, projection);
+        if (prepass) {
+            BeginDepthPrepass();
+            for (GLsizei i = 0; i < count; i++) {
+                if (culling) culler.beginConditional(i);
+                depth.set("model"_hash, models[i]);
+                draw(i);
+                culler.endConditional();
+            }
+        }
+
+        // bounding boxes against the depth so far, consumed next frame
+        if (culling) {
+            culler.beginQueries();
+            for (GLsizei i = 0; i < count; i++) {
+                const GLfloat* const m(models[i].Data());
+                const GLfloat min[] = {m[12] - m[0], m[13] - m[5],
+                                       m[14] - m[10]};
+                const GLfloat max[] = {m[12] + m[0], m[13] + m[5],
+                                       m[14] + m[10]};
+                culler.query(i, depth, min, max, eye);
+            }
+            culler.endQueries();
+        }
+
+        // shading
+        if (prepass) EndDepthPrepass();
+        program.use();
+        program.set("view"_hash, view);
+        program.set("projection"_hash, projection);
+        Vector view_Lpos[2] = {view * Lpos[0], view * Lpos[1]};
+        program.set("Lpos"_hash, view_Lpos[0].data(), 2);
+        program.set("Lamb"_hash, Lamb, 2);
+        program.set("Ldiff"_hash, Ldiff, 2);
+        program.set("Lspec"_hash, Lspec, 2);
+        material.select(0, material_binding);
+        GLfloat normal_mat[9];
+        for (GLsizei i = 0; i < count; i++) {
+            if (culling) culler.beginConditional(i);
+            program.set("model"_hash, models[i]);
+            (view * models[i]).GetNormalMatrix(normal_mat);
+            program.set("normal_mat"_hash, normal_mat);
+            draw(i);
+            culler.endConditional();
+        }
+        glDepthFunc(GL_LESS);
+        if (culling) culler.swap();
+
+        window.SwapBuffers();
+    }
+}
@@ -0,0 +1,106 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "tiny_glfw_renderer.h"
+
+using namespace tiny_glfw_renderer;
+
+const std::string SHADER_DIR = "../example/shaders/";
+const std::string MVP_VERT = SHADER_DIR + "naive_mvp.vert";
+const std::string FRAG = SHADER_DIR + "normal_point.frag";
+
+int main() {
+    Initialize();
+    Window window(640, 480, "Test");
+
+    Program program(LoadProgram(MVP_VERT, FRAG, true));
+    static constexpr Material colors[] = {{{{0.3f, 0.3f, 0.6f}},
+                                           {{0.3f, 0.3f, 0.6f}},
+                                           {{0.3f, 0.3f, 0.3f}},
+                                           30.0f},
+                                          {{{0.8f, 0.5f, 0.1f}},
+                                           {{0.8f, 0.5f, 0.1f}},
+                                           {{0.3f, 0.3f, 0.3f}},
+                                           30.0f}};
+    const Uniform<Material> material(colors, 2);
+    const GLuint material_binding(program.binding("Material"_hash));
+
+    // the sphere under the cursor is highlighted
+    auto sphere = SolidSphere(32);
+    static constexpr int grid(8);
+    std::vector<Matrix> models;
+    for (int y = 0; y < grid; y++) {
+        for (int x = 0; x < grid; x++) {
+            models.emplace_back(
+                Matrix::Translate(x - 0.5f * (grid - 1),
+                                  y - 0.5f * (grid - 1), 0.0f) *
+                Matrix::Scale(0.4f, 0.4f, 0.4f));
+        }
+    }
+
+    PickBuffer pick(static_cast<GLsizei>(window.GetWidth()),
+                    static_cast<GLsizei>(window.GetHeight()));
+    window.OnResize([&](int width, int height) { pick.resize(width, height); });
+    PickResult hover = {0, 0, 0, 0};
+
+    static constexpr Vector Lpos[] = {{{0.0f, 0.0f, 5.0f, 1.0f}},
+                                      {{8.0f, 0.0f, 0.0f, 1.0f}}};
+    static constexpr GLfloat Lamb[] = {0.2f, 0.1f, 0.1f, 0.1f, 0.1f, 0.1f};
+    static constexpr GLfloat Ldiff[] = {1.0f, 0.5f, 0.5f, 0.9f, 0.9f, 0.9f};
+    static constexpr GLfloat Lspec[] = {1.0f, 0.5f, 0.5f, 0.9f, 0.9f, 0.9f};
+
+    glClearColor(0.1f, 0.1f, 0.1f, 0.0f);
+    glFrontFace(GL_CCW);
+    glCullFace(GL_BACK);
+    glEnable(GL_CULL_FACE);
+    glEnable(GL_DEPTH_TEST);
+
+    while (window.ShouldClose() == GL_FALSE) {
+        static constexpr Matrix view(Matrix::LookAt(
+            0.0f, 0.0f, 10.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+        const Matrix projection(
+            Matrix::Perspective(window.GetScale() * 0.01f, window.GetAspect(),
+                                1.0f, 20.0f));
+        const Matrix spin(
+            Matrix::Rotate(0.3f * window.GetTime(), 0.0f, 1.0f, 0.0f));
+
+        // IDs first; the answer arrives a frame or two later
+        pick.begin();
+        for (std::size_t i = 0; i < models.size(); i++) {
+            pick.select(static_cast<GLuint>(i + 1), view * models[i] * spin,
+                        projection);
+            sphere->draw(GL_TRIANGLES);
+        }
+        const double* const cursor(window.GetCursor());
+        pick.end(cursor[0], cursor[1]);
+        PickResult r;
+        if (pick.poll(r) && r.object != hover.object) {
+            if (r.object != 0) {
+                std::cout << "sphere " << r.object << ", triangle "
+                          << r.primitive - 1 << std::endl;
+            }
+            hover = r;
+        }
+
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        program.use();
+        program.set("view"_hash, view);
+        program.set("projection"_hash, projection);
+        Vector view_Lpos[2] = {view * Lpos[0], view * Lpos[1]};
+        program.set("Lpos"_hash, view_Lpos[0].data(), 2);
+        program.set("Lamb"_hash, Lamb, 2);
+        program.set("Ldiff"_hash, Ldiff, 2);
+        program.set("Lspec"_hash, Lspec, 2);
+        GLfloat normal_mat[9];
+        for (std::size_t i = 0; i < models.size(); i++) {
+            const Matrix model(models[i] * spin);
+            material.select(hover.object == i + 1 ? 1 : 0, material_binding);
+            program.set("model"_hash, model);
+            (view * model).GetNormalMatrix(normal_mat);
+            program.set("normal_mat"_hash, normal_mat);
+            sphere->draw(GL_TRIANGLES);
+        }
+
+        window.SwapBuffers();
+    }
+}
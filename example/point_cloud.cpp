@@ -0,0 +1,76 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <random>
+
+#include "tiny_glfw_renderer.h"
+
+using namespace tiny_glfw_renderer;
+
+const std::string RAW = "terrain.raw";
+const std::string CLOUD = "terrain.tgrpc";
+
+// Scanned terrain stand-in, written point by point so the generator never
+// holds the whole cloud either.
+static bool Scan(const std::string name, std::uint64_t count) {
+    std::ofstream out(name, std::ios::binary);
+    if (out.fail()) return false;
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<GLfloat> u(-500.0f, 500.0f);
+    for (std::uint64_t i = 0; i < count; i++) {
+        const GLfloat x(u(rng)), z(u(rng));
+        const GLfloat h(20.0f * std::sin(0.013f * x) * std::cos(0.017f * z) +
+                        3.0f * std::sin(0.11f * x + 0.07f * z));
+        const GLubyte g(static_cast<GLubyte>(128.0f + 5.0f * h));
+        const CloudPoint p = {{x, h, z}, {80, g, 60, 255}};
+        out.write(reinterpret_cast<const char*>(&p), sizeof p);
+    }
+    return !out.fail();
+}
+
+int main(int argc, char** argv) {
+    Initialize();
+    Window window(640, 480, "Test");
+
+    std::ifstream cached(CLOUD);
+    if (!cached.good()) {
+        const std::uint64_t count(argc > 1 ? std::stoull(argv[1]) : 10000000);
+        std::cout << "Building " << CLOUD << " from " << count << " points"
+                  << std::endl;
+        if (!Scan(RAW, count) || !BuildPointCloud(RAW, CLOUD)) return 1;
+        std::remove(RAW.c_str());
+    }
+    PointCloud cloud(CLOUD, 128 << 20);
+    if (!cloud.valid()) return 1;
+    std::cout << cloud.size() << " points in " << cloud.nodes() << " nodes"
+              << std::endl;
+
+    glClearColor(0.05f, 0.05f, 0.1f, 0.0f);
+    glEnable(GL_DEPTH_TEST);
+
+    int frame(0);
+    while (window.ShouldClose() == GL_FALSE) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        // fly low over the terrain; dragging moves the target
+        const GLfloat t(0.05f * static_cast<GLfloat>(window.GetTime()));
+        const GLfloat *const position(window.GetLocation());
+        const Matrix view(Matrix::LookAt(
+            400.0f * std::cos(t), 60.0f, 400.0f * std::sin(t),
+            100.0f * position[0], 0.0f, -100.0f * position[1], 0.0f, 1.0f,
+            0.0f));
+        const Matrix projection(Matrix::Perspective(
+            window.GetScale() * 0.01f, window.GetAspect(), 1.0f, 2000.0f));
+
+        cloud.update(view, projection,
+                     static_cast<GLsizei>(window.GetHeight()));
+        cloud.draw();
+        if (frame++ % 120 == 0) {
+            std::cout << cloud.drawn() << " points drawn, "
+                      << (cloud.resident() >> 20) << " MiB resident"
+                      << std::endl;
+        }
+
+        window.SwapBuffers();
+    }
+}
@@ -40,8 +40,8 @@ int main() {
         glUniformMatrix4fv(model_location, 1, GL_FALSE, model.Data());
 
         // view matrix
-        const Matrix view(Matrix::LookAt(3.0f, 4.0f, 5.0f, 0.0f, 0.0f, 0.0f,
-                                         0.0f, 1.0f, 0.0f));
+        static constexpr Matrix view(Matrix::LookAt(
+            3.0f, 4.0f, 5.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
         glUniformMatrix4fv(view_location, 1, GL_FALSE, view.Data());
 
         // projection matrix
@@ -0,0 +1,97 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "tiny_glfw_renderer.h"
+
+using namespace tiny_glfw_renderer;
+
+const std::string SHADER_DIR = "../example/shaders/";
+const std::string MVP_VERT = SHADER_DIR + "naive_mvp.vert";
+const std::string FRAG = SHADER_DIR + "normal_point.frag";
+const std::string POST_VERT = SHADER_DIR + "fullscreen.vert";
+const std::string POST_FRAG = SHADER_DIR + "post.frag";
+
+int main() {
+    Initialize();
+    Window window(640, 480, "Test");
+
+    Program program(LoadProgram(MVP_VERT, FRAG, true));
+    Program post(LoadProgram(POST_VERT, POST_FRAG));
+
+    static constexpr Material color[] = {{{{0.6f, 0.6f, 0.2f}},
+                                          {{0.6f, 0.6f, 0.2f}},
+                                          {{0.3f, 0.3f, 0.3f}},
+                                          30.0f}};
+    const Uniform<Material> material(color, 1);
+    auto cube = SolidCube(1.0f);
+
+    static constexpr Vector Lpos[] = {{{0.0f, 0.0f, 5.0f, 1.0f}},
+                                      {{8.0f, 0.0f, 0.0f, 1.0f}}};
+    static constexpr GLfloat Lamb[] = {0.2f, 0.1f, 0.1f, 0.1f, 0.1f, 0.1f};
+    static constexpr GLfloat Ldiff[] = {1.0f, 0.5f, 0.5f, 0.9f, 0.9f, 0.9f};
+    static constexpr GLfloat Lspec[] = {1.0f, 0.5f, 0.5f, 0.9f, 0.9f, 0.9f};
+
+    // scene (4x MSAA) -> post -> window; the blur pass feeds nothing and
+    // is culled by compile()
+    RenderGraph graph(window.GetWidth(), window.GetHeight());
+    const int hdr(graph.createTarget({1.0f, {GL_RGBA16F}, GL_DEPTH_COMPONENT24,
+                                      4}));
+    const int blur(graph.createTarget({0.5f, {GL_RGBA16F}, GL_NONE, 0}));
+    window.OnResize([&](int width, int height) {
+        graph.resize(width, height);
+    });
+
+    graph.addPass("scene", {}, hdr, [&](const RenderGraph&) {
+        glClearColor(0.1f, 0.1f, 0.4f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_DEPTH_TEST);
+        glEnable(GL_CULL_FACE);
+
+        program.use();
+        const GLfloat *const position(window.GetLocation());
+        const Matrix model(Matrix::Translate(position[0], position[1], 0.0f) *
+                           Matrix::Rotate(window.GetTime(), 0.0f, 1.0f, 0.0f));
+        static constexpr Matrix view(Matrix::LookAt(
+            3.0f, 4.0f, 5.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+        GLfloat normal_mat[9];
+        (view * model).GetNormalMatrix(normal_mat);
+        program.set("model"_hash, model);
+        program.set("view"_hash, view);
+        program.set("normal_mat"_hash, normal_mat);
+        program.set("projection"_hash,
+                    Matrix::Perspective(window.GetScale() * 0.01f,
+                                        window.GetAspect(), 1.0f, 10.0f));
+        Vector view_Lpos[2] = {view * Lpos[0], view * Lpos[1]};
+        program.set("Lpos"_hash, view_Lpos[0].data(), 2);
+        program.set("Lamb"_hash, Lamb, 2);
+        program.set("Ldiff"_hash, Ldiff, 2);
+        program.set("Lspec"_hash, Lspec, 2);
+        material.select(0, program.binding("Material"_hash));
+        cube->draw(GL_TRIANGLES);
+    });
+
+    graph.addPass("blur", {hdr}, blur, [&](const RenderGraph&) {
+        glClear(GL_COLOR_BUFFER_BIT);  // never runs: nothing reads "blur"
+    });
+
+    graph.addPass("post", {hdr}, RenderGraph::BACKBUFFER,
+                  [&](const RenderGraph& g) {
+                      glDisable(GL_DEPTH_TEST);
+                      post.use();
+                      glActiveTexture(GL_TEXTURE0);
+                      glBindTexture(GL_TEXTURE_2D, g.target(hdr)->color());
+                      post.set("scene"_hash, 0);
+                      post.set("vignette"_hash, 1.5f);
+                      DrawFullscreenTriangle();
+                  });
+
+    graph.compile();
+    std::cout << "blur pass live: " << graph.live("blur")
+              << ", pooled targets: " << graph.pooled() << std::endl;
+
+    glfwSetTime(0.0);
+    while (window.ShouldClose() == GL_FALSE) {
+        graph.execute();
+        window.SwapBuffers();
+    }
+}
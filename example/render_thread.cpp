@@ -0,0 +1,105 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "tiny_glfw_renderer.h"
+
+using namespace tiny_glfw_renderer;
+
+const std::string SHADER_DIR = "../example/shaders/";
+const std::string MVP_VERT = SHADER_DIR + "naive_mvp.vert";
+const std::string FRAG = SHADER_DIR + "normal_point.frag";
+
+int main() {
+    Initialize();
+    Window window(640, 480, "Test");
+
+    // from here on GL only runs on the render thread
+    RenderThread render(window);
+    std::unique_ptr<Program> program;
+    std::unique_ptr<const Uniform<Material>> material;
+    std::unique_ptr<const GeometryIndex3D> cube;
+    GLuint material_binding(0);
+    render.invoke([&] {
+        program.reset(new Program(LoadProgram(MVP_VERT, FRAG, true)));
+        static constexpr Material color[] = {{{{0.6f, 0.6f, 0.2f}},
+                                              {{0.6f, 0.6f, 0.2f}},
+                                              {{0.3f, 0.3f, 0.3f}},
+                                              30.0f}};
+        material.reset(new Uniform<Material>(color, 1));
+        material_binding = program->binding("Material"_hash);
+        cube = SolidCube(0.5f);
+
+        glClearColor(0.1f, 0.1f, 0.4f, 0.0f);
+        glEnable(GL_CULL_FACE);
+        glEnable(GL_DEPTH_TEST);
+    });
+
+    static constexpr Vector Lpos = {{0.0f, 0.0f, 5.0f, 1.0f}};
+    static constexpr GLfloat Lamb[] = {0.2f, 0.1f, 0.1f};
+    static constexpr GLfloat Ldiff[] = {1.0f, 0.5f, 0.5f};
+    static constexpr GLfloat Lspec[] = {1.0f, 0.5f, 0.5f};
+    static constexpr int grid(24);
+    std::vector<Matrix> models(grid * grid);
+
+    double waited(0.0);
+    int frames(0);
+    glfwSetTime(0.0);
+    while (window.ShouldClose() == GL_FALSE) {
+        // simulation of frame N + 1 overlaps the submission of frame N
+        const GLfloat t(static_cast<GLfloat>(window.GetTime()));
+        for (int i = 0; i < grid * grid; i++) {
+            const GLfloat x(i % grid - 0.5f * (grid - 1));
+            const GLfloat y(i / grid - 0.5f * (grid - 1));
+            const GLfloat z(std::sin(t * 2.0f + 0.3f * (x + y)));
+            models[i] = Matrix::Translate(x, y, z) *
+                        Matrix::Rotate(t + 0.1f * i, 0.0f, 1.0f, 0.0f);
+        }
+        static constexpr Matrix view(Matrix::LookAt(
+            0.0f, -20.0f, 30.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+        const Matrix projection(Matrix::Perspective(
+            window.GetScale() * 0.01f, window.GetAspect(), 1.0f, 100.0f));
+
+        // commands capture by value; bulk data is copied into the list
+        CommandList& commands(render.commands());
+        const Matrix* const frame_models(
+            commands.copy(models.data(), models.size()));
+        if (frame_models == nullptr) {
+            std::cerr << "Error: Command list is full." << std::endl;
+            break;
+        }
+        const bool recorded(commands.push([&, frame_models, projection] {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            program->use();
+            program->set("view"_hash, view);
+            program->set("projection"_hash, projection);
+            const Vector view_Lpos(view * Lpos);
+            program->set("Lpos"_hash, view_Lpos.data(), 1);
+            program->set("Lamb"_hash, Lamb, 1);
+            program->set("Ldiff"_hash, Ldiff, 1);
+            program->set("Lspec"_hash, Lspec, 1);
+            material->select(0, material_binding);
+            GLfloat normal_mat[9];
+            for (int i = 0; i < grid * grid; i++) {
+                program->set("model"_hash, frame_models[i]);
+                (view * frame_models[i]).GetNormalMatrix(normal_mat);
+                program->set("normal_mat"_hash, normal_mat);
+                cube->draw(GL_TRIANGLES);
+            }
+        }));
+        if (!recorded) {
+            std::cerr << "Error: Command list is full." << std::endl;
+            break;
+        }
+        render.submit();
+        waited += render.waited();
+        frames++;
+    }
+    std::cout << "waited for the render thread "
+              << waited / std::max(frames, 1) << " ms per frame" << std::endl;
+
+    render.invoke([&] {
+        cube.reset();
+        material.reset();
+        program.reset();
+    });
+}
@@ -0,0 +1,69 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <iomanip>
+
+#include "tiny_glfw_renderer.h"
+
+using namespace tiny_glfw_renderer;
+
+// Plays a trace recorded from an example built with -DTGR_ENABLE_TRACE=ON
+// (TGR_TRACE=<trace> ./<example>.out) back into an offscreen target as fast
+// as possible:
+//   replay.out <trace> [sync]
+// Writes the frame times to <trace>.csv, readable by golden.out, and prints
+// the time spent per call. With `sync` every call waits for the GPU.
+int main(int argc, char** argv) {
+    if (argc != 2 && !(argc == 3 && std::string(argv[2]) == "sync")) {
+        std::cerr << "Usage: " << argv[0] << " trace [sync]" << std::endl;
+        return 2;
+    }
+    TraceHeader header;
+    if (!ReadTraceHeader(argv[1], header)) return 1;
+
+    Initialize();
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    Window window(header.width, header.height, "Replay");
+    window.SetSwapInterval(0);
+    // pixels of a hidden window fail the pixel ownership test, so the draws
+    // recorded into the window's framebuffer go to an offscreen one
+    RenderTarget target(header.width, header.height, {GL_RGBA8},
+                        GL_DEPTH24_STENCIL8);
+    DefaultFramebuffer() = target.framebuffer();
+
+    TraceStats stats;
+    if (!ReplayTrace(argv[1], stats, argc == 3)) return 1;
+
+    std::ofstream csv(std::string(argv[1]) + ".csv");
+    csv << "frame_ms\n";
+    for (const double t : stats.frame_ms) csv << t << "\n";
+    csv.close();
+    FrameStats frames;
+    if (ReadFrameStats(std::string(argv[1]) + ".csv", frames)) {
+        std::cout << frames.frames << " frames: mean " << frames.mean
+                  << " ms, median " << frames.median << " ms, p95 "
+                  << frames.p95 << " ms" << std::endl;
+    }
+
+    // slowest calls first
+    std::vector<int> ops;
+    for (int i = 0; i < static_cast<int>(TraceOp::COUNT); i++) {
+        if (stats.calls[i] > 0) ops.emplace_back(i);
+    }
+    std::sort(ops.begin(), ops.end(), [&](int a, int b) {
+        return stats.seconds[a] > stats.seconds[b];
+    });
+    std::cout << std::left << std::setw(32) << "call" << std::right
+              << std::setw(10) << "count" << std::setw(12) << "total ms"
+              << std::setw(12) << "us/call" << std::endl;
+    for (const int i : ops) {
+        std::cout << std::left << std::setw(32)
+                  << TraceOpName(static_cast<TraceOp>(i)) << std::right
+                  << std::setw(10) << stats.calls[i] << std::fixed
+                  << std::setprecision(3) << std::setw(12)
+                  << 1e3 * stats.seconds[i] << std::setw(12)
+                  << 1e6 * stats.seconds[i] / stats.calls[i]
+                  << std::defaultfloat << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,48 @@
+#version 150 core
+
+uniform samplerBuffer lights;        // position/radius, amb, diff, spec
+uniform usamplerBuffer clusters;     // (offset, count) per cluster
+uniform usamplerBuffer light_index;  // light indices of all clusters
+uniform ivec3 cluster_dim;
+uniform vec2 tile_size;
+uniform vec2 slice_params;  // slice = log(depth) * x + y
+layout(std140) uniform Material {
+    vec3 Kamb;
+    vec3 Kdiff;
+    vec3 Kspec;
+    float Kshi;
+};
+
+in vec4 P;
+in vec3 N;
+out vec4 fragment;
+
+void main() {
+    ivec2 tile = min(ivec2(gl_FragCoord.xy / tile_size), cluster_dim.xy - 1);
+    int slice = clamp(int(log(-P.z) * slice_params.x + slice_params.y), 0,
+                      cluster_dim.z - 1);
+    uvec2 cluster = texelFetch(clusters, (slice * cluster_dim.y + tile.y) *
+                                             cluster_dim.x + tile.x).xy;
+
+    vec3 V = -normalize(P.xyz);
+    vec3 Nn = normalize(N);
+    vec3 Idiff = vec3(0.0);
+    vec3 Ispec = vec3(0.0);
+    for (uint n = 0u; n < cluster.y; n++) {
+        int i = 4 * int(texelFetch(light_index, int(cluster.x + n)).x);
+        vec4 Lpos = texelFetch(lights, i);
+        vec3 D = Lpos.xyz - P.xyz;
+        float d2 = dot(D, D);
+        float falloff = clamp(1.0 - d2 / (Lpos.w * Lpos.w), 0.0, 1.0);
+        falloff *= falloff;
+
+        vec3 L = D * inversesqrt(d2);
+        vec3 H = normalize(L + V);
+        Idiff += falloff * (max(dot(Nn, L), 0.0) * Kdiff *
+                                texelFetch(lights, i + 2).rgb +
+                            Kamb * texelFetch(lights, i + 1).rgb);
+        Ispec += falloff * pow(max(dot(Nn, H), 0.0), Kshi) * Kspec *
+                 texelFetch(lights, i + 3).rgb;
+    }
+    fragment = vec4(Idiff + Ispec, 1.0);
+}
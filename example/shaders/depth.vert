@@ -0,0 +1,13 @@
+#version 150 core
+
+// Same transform as naive_mvp.vert so the depth pre-pass matches shading
+invariant gl_Position;
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+in vec4 position;
+
+void main() {
+    vec4 P = view * model * position;
+    gl_Position = projection * P;
+}
@@ -0,0 +1,9 @@
+#version 150 core
+
+out vec2 texcoord;
+
+// one triangle covering the viewport, no vertex attributes needed
+void main() {
+    texcoord = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(texcoord * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -1,5 +1,6 @@
 #version 150 core
 
+invariant gl_Position;
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
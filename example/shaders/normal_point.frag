@@ -1,6 +1,10 @@
 #version 150 core
 
-const int Lcount = 2;
+#ifndef LIGHT_COUNT
+#define LIGHT_COUNT 2
+#endif
+
+const int Lcount = LIGHT_COUNT;
 uniform vec4 Lpos[Lcount];
 uniform vec3 Lamb[Lcount];
 uniform vec3 Ldiff[Lcount];
@@ -25,8 +29,10 @@ void main() {
         vec3 L = normalize((Lpos[i] * P.w - P * Lpos[i].w).xyz);
         vec3 Iamb = Kamb * Lamb[i];
         Idiff += max(dot(N, L), 0.0) * Kdiff * Ldiff[i] + Iamb;
+#ifndef NO_SPECULAR
         vec3 H = normalize(L + V);
         Ispec += pow(max(dot(normalize(N), H), 0.0), Kshi) * Kspec * Lspec[i];
+#endif
     }
     fragment = vec4(Idiff + Ispec, 1.0);
 }
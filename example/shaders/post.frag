@@ -0,0 +1,13 @@
+#version 150 core
+
+uniform sampler2D scene;
+uniform float vignette;
+in vec2 texcoord;
+out vec4 fragment;
+
+void main() {
+    vec3 color = texture(scene, texcoord).rgb;
+    vec2 d = texcoord - 0.5;
+    color *= 1.0 - vignette * dot(d, d);
+    fragment = vec4(pow(color, vec3(1.0 / 2.2)), 1.0);
+}
@@ -0,0 +1,34 @@
+#version 150 core
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform mat3 normal_mat;
+uniform samplerBuffer palette;  // 3 texels (matrix rows) per joint
+uniform int palette_offset;
+in vec4 position;
+in vec3 normal;
+in uvec4 joints;
+in vec4 weights;
+out vec4 P;
+out vec3 N;
+
+void main() {
+    // linear blend skinning of the affine rows
+    vec4 r0 = vec4(0.0);
+    vec4 r1 = vec4(0.0);
+    vec4 r2 = vec4(0.0);
+    for (int i = 0; i < 4; i++) {
+        int j = 3 * (palette_offset + int(joints[i]));
+        r0 += weights[i] * texelFetch(palette, j);
+        r1 += weights[i] * texelFetch(palette, j + 1);
+        r2 += weights[i] * texelFetch(palette, j + 2);
+    }
+    vec4 p = vec4(dot(r0, position), dot(r1, position), dot(r2, position), 1.0);
+    vec3 n =
+        vec3(dot(r0.xyz, normal), dot(r1.xyz, normal), dot(r2.xyz, normal));
+
+    P = view * model * p;
+    N = normalize(normal_mat * n);
+    gl_Position = projection * P;
+}
@@ -0,0 +1,11 @@
+#version 150 core
+
+uniform sampler2D image;
+in vec3 N;
+in vec2 uv;
+out vec4 fragment;
+
+void main() {
+    float diffuse = max(dot(normalize(N), vec3(0.0, 0.0, 1.0)), 0.2);
+    fragment = vec4(texture(image, uv).rgb * diffuse, 1.0);
+}
@@ -0,0 +1,18 @@
+#version 150 core
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform mat3 normal_mat;
+uniform vec4 uv_rect;  // atlas region: u0, v0, u1, v1
+in vec4 position;
+in vec3 normal;
+in vec2 texcoord;
+out vec3 N;
+out vec2 uv;
+
+void main() {
+    N = normalize(normal_mat * normal);
+    uv = mix(uv_rect.xy, uv_rect.zw, texcoord);
+    gl_Position = projection * view * model * position;
+}
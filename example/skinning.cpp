@@ -0,0 +1,147 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "tiny_glfw_renderer.h"
+
+using namespace tiny_glfw_renderer;
+
+const std::string SHADER_DIR = "../example/shaders/";
+const std::string SKIN_VERT = SHADER_DIR + "skinned.vert";
+const std::string FRAG = SHADER_DIR + "normal_point.frag";
+
+// Tube along +y bound to a chain of `bones` joints
+std::unique_ptr<const SkinnedGeometry> Tube(int bones, GLfloat length,
+                                            GLfloat radius) {
+    const float PI = 3.141592653;
+    const int rings(8 * bones), slices(12);
+    const GLfloat bone(length / bones);
+
+    std::vector<SkinnedVertex> vtx;
+    for (int j = 0; j <= rings; j++) {
+        const GLfloat y(length * j / rings);
+        const GLfloat b(std::min(y / bone - 0.5f, bones - 1.0f));
+        const int j0(std::max(static_cast<int>(std::floor(b)), 0));
+        const int j1(std::min(j0 + 1, bones - 1));
+        const GLfloat w(std::min(std::max(b - j0, 0.0f), 1.0f));
+        for (int i = 0; i <= slices; i++) {
+            const GLfloat a(2 * PI * i / slices);
+            const GLfloat x(std::sin(a)), z(std::cos(a));
+            const SkinnedVertex v = {{radius * x, y, radius * z},
+                                     {x, 0.0f, z},
+                                     {static_cast<GLubyte>(j0),
+                                      static_cast<GLubyte>(j1), 0, 0},
+                                     {1.0f - w, w, 0.0f, 0.0f}};
+            vtx.emplace_back(v);
+        }
+    }
+
+    std::vector<GLuint> idx;
+    for (int j = 0; j < rings; j++) {
+        for (int i = 0; i < slices; i++) {
+            const GLuint k0((slices + 1) * j + i), k1(k0 + 1);
+            const GLuint k2(k0 + slices + 1), k3(k2 + 1);
+            idx.insert(idx.end(), {k0, k1, k3, k0, k3, k2});
+        }
+    }
+
+    std::unique_ptr<const SkinnedGeometry> shape(new SkinnedGeometry(
+        static_cast<GLsizei>(vtx.size()), vtx.data(),
+        static_cast<GLsizei>(idx.size()), idx.data()));
+    return shape;
+}
+
+int main() {
+    Initialize();
+    Window window(640, 480, "Test");
+
+    Program program(LoadProgram(SKIN_VERT, FRAG, true));
+    program.use();
+    program.set("palette"_hash, 1);
+
+    // material
+    static constexpr Material color = {{{0.6f, 0.4f, 0.2f}},  // Kamb
+                                       {{0.6f, 0.4f, 0.2f}},  // Kdiff
+                                       {{0.3f, 0.3f, 0.3f}},  // Kspec
+                                       30.0f};                // Kshi
+    const Uniform<Material> material(&color);
+
+    // skeleton: a chain of bones along +y
+    static constexpr int bones(4);
+    static constexpr GLfloat length(2.0f), bone(length / bones);
+    Skeleton skeleton;
+    for (int j = 0; j < bones; j++) {
+        skeleton.add(j - 1, Matrix::Translate(0.0f, -bone * j, 0.0f));
+    }
+
+    // one second of swaying, sampled at 30 fps
+    AnimationClip clip(bones, 31, 30.0f);
+    for (int f = 0; f <= 30; f++) {
+        const GLfloat a(0.4f * std::sin(6.2831853f * f / 30.0f));
+        for (int j = 0; j < bones; j++) {
+            const Vector t = {{0.0f, j == 0 ? 0.0f : bone, 0.0f, 0.0f}};
+            clip.setKey(f, j, t, Quaternion::AxisAngle(a, 0.0f, 0.0f, 1.0f));
+        }
+    }
+
+    // a crowd of instances with different phases
+    std::vector<SkinInstance> crowd;
+    for (int i = 0; i < 64; i++) {
+        crowd.push_back({&skeleton, &clip, 0.0f, 0});
+    }
+    SkinningPalette palette;
+    auto tube = Tube(bones, length, 0.15f);
+
+    static constexpr Vector Lpos[] = {{{0.0f, 0.0f, 5.0f, 1.0f}},
+                                      {{8.0f, 0.0f, 0.0f, 1.0f}}};
+    static constexpr GLfloat Lamb[] = {0.2f, 0.1f, 0.1f, 0.1f, 0.1f, 0.1f};
+    static constexpr GLfloat Ldiff[] = {1.0f, 0.5f, 0.5f, 0.9f, 0.9f, 0.9f};
+    static constexpr GLfloat Lspec[] = {1.0f, 0.5f, 0.5f, 0.9f, 0.9f, 0.9f};
+    Vector view_Lpos[2];
+    GLfloat normal_mat[9];
+
+    glClearColor(0.1f, 0.1f, 0.4f, 0.0f);
+    glClearDepth(1.0);
+    glDepthFunc(GL_LESS);
+    glEnable(GL_DEPTH_TEST);
+
+    glfwSetTime(0.0);
+    while (window.ShouldClose() == GL_FALSE) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        program.use();
+
+        // evaluate all poses in parallel and upload one palette buffer
+        const GLfloat t(static_cast<GLfloat>(window.GetTime()));
+        for (std::size_t i = 0; i < crowd.size(); i++) {
+            crowd[i].time = t + 0.1f * i;
+        }
+        palette.update(crowd);
+        palette.bind(1);
+
+        static constexpr Matrix view(Matrix::LookAt(
+            0.0f, 6.0f, 12.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+        program.set("view"_hash, view);
+        const GLfloat fovy(window.GetScale() * 0.01f);
+        const Matrix projection(
+            Matrix::Perspective(fovy, window.GetAspect(), 1.0f, 30.0f));
+        program.set("projection"_hash, projection);
+
+        for (int i = 0; i < 2; i++) view_Lpos[i] = view * Lpos[i];
+        program.set("Lpos"_hash, view_Lpos[0].data(), 2);
+        program.set("Lamb"_hash, Lamb, 2);
+        program.set("Ldiff"_hash, Ldiff, 2);
+        program.set("Lspec"_hash, Lspec, 2);
+        material.select(0, program.binding("Material"_hash));
+
+        for (std::size_t i = 0; i < crowd.size(); i++) {
+            const Matrix model(Matrix::Translate(
+                1.2f * (i % 8) - 4.2f, 0.0f, 1.2f * (i / 8) - 4.2f));
+            program.set("model"_hash, model);
+            (view * model).GetNormalMatrix(normal_mat);
+            program.set("normal_mat"_hash, normal_mat);
+            program.set("palette_offset"_hash, crowd[i].palette_offset);
+            tube->draw(GL_TRIANGLES);
+        }
+
+        window.SwapBuffers();
+    }
+}
@@ -0,0 +1,97 @@
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include "tiny_glfw_renderer.h"
+
+using namespace tiny_glfw_renderer;
+
+const std::string SHADER_DIR = "../example/shaders/";
+const std::string TEXTURE_DIR = "../example/textures/";
+const std::string VERT = SHADER_DIR + "textured.vert";
+const std::string FRAG = SHADER_DIR + "textured.frag";
+
+int main() {
+    Initialize();
+    Window window(640, 480, "Test");
+
+    Program program(LoadProgram(VERT, FRAG, true));
+    auto cube = TexturedCube(1.0f);
+
+    // a decoded image with a Kaiser-filtered mip chain, transcoded to BC1
+    // once and mapped from the cache file afterwards
+    auto checker = LoadCompressedTexture(TEXTURE_DIR + "checker.ppm",
+                                         TEXTURE_DIR + "checker.ppm.tgrtex",
+                                         BlockFormat::BC1, MipFilter::KAISER);
+    if (!checker) return 1;
+
+    // generated tiles packed into one atlas, drawn without rebinding
+    TextureAtlas atlas(256, 256);
+    std::vector<std::array<GLfloat, 4>> tiles;
+    for (int i = 0; i < 8; i++) {
+        const GLsizei size(16 + 8 * i);
+        Image tile(size, size, 3);
+        for (GLsizei y = 0; y < size; y++) {
+            for (GLsizei x = 0; x < size; x++) {
+                GLubyte* const p(tile.row(y) + x * 3);
+                p[0] = static_cast<GLubyte>(255 * x / size);
+                p[1] = static_cast<GLubyte>(255 * y / size);
+                p[2] = static_cast<GLubyte>(32 * i);
+            }
+        }
+        std::array<GLfloat, 4> uv;
+        if (atlas.add(tile, uv)) tiles.emplace_back(uv);
+    }
+    atlas.upload();
+    std::cout << tiles.size() << " tiles, atlas occupancy "
+              << atlas.occupancy() << std::endl;
+
+    glClearColor(0.1f, 0.1f, 0.4f, 0.0f);
+    glFrontFace(GL_CCW);
+    glCullFace(GL_BACK);
+    glEnable(GL_CULL_FACE);
+    glClearDepth(1.0);
+    glDepthFunc(GL_LESS);
+    glEnable(GL_DEPTH_TEST);
+
+    glfwSetTime(0.0);
+    while (window.ShouldClose() == GL_FALSE) {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        program.use();
+        static constexpr Matrix view(Matrix::LookAt(
+            0.0f, 3.0f, 9.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f));
+        program.set("view"_hash, view);
+        program.set("projection"_hash,
+                    Matrix::Perspective(window.GetScale() * 0.01f,
+                                        window.GetAspect(), 1.0f, 20.0f));
+        program.set("image"_hash, 0);
+
+        const GLfloat *const position(window.GetLocation());
+        const Matrix r(Matrix::Translate(position[0], position[1], 0.0f) *
+                       Matrix::Rotate(window.GetTime(), 0.0f, 1.0f, 0.0f));
+        GLfloat normal_mat[9];
+        auto place = [&](const Matrix& model) {
+            program.set("model"_hash, model);
+            (view * model).GetNormalMatrix(normal_mat);
+            program.set("normal_mat"_hash, normal_mat);
+        };
+
+        checker->bind(0);
+        static constexpr GLfloat whole[] = {0.0f, 0.0f, 1.0f, 1.0f};
+        program.set("uv_rect"_hash, whole);
+        place(r);
+        cube->draw();
+
+        atlas.bind(0);
+        for (std::size_t i = 0; i < tiles.size(); i++) {
+            const GLfloat angle(6.2831853f * i / tiles.size());
+            program.set("uv_rect"_hash, tiles[i].data());
+            place(Matrix::Translate(4.0f * std::sin(angle), 0.0f,
+                                    4.0f * std::cos(angle)) *
+                  r * Matrix::Scale(0.4f, 0.4f, 0.4f));
+            cube->draw();
+        }
+
+        window.SwapBuffers();
+    }
+}
@@ -0,0 +1,4 @@
+// Compiled part of tiny_glfw_renderer: non-inline definitions and the
+// explicit instantiations of Object, Geometry and GeometryIndex.
+#define TGR_IMPLEMENTATION
+#include "tiny_glfw_renderer.h"
@@ -2,250 +2,8510 @@
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#endif
+
 #include <algorithm>
 #include <array>
+#include <atomic>
 #include <cassert>
+#include <chrono>
+#include <climits>
 #include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <deque>
 #include <fstream>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <new>
+#include <queue>
+#include <sstream>
 #include <string>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
 #include <vector>
 
+#include <sys/stat.h>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
 namespace tiny_glfw_renderer {
 
-// ============================== GUI ===================================
-class Window {
-public:
-    Window(int width, int height, const char* title,
-           GLFWmonitor* monitor = NULL, GLFWwindow* share = NULL);
-    virtual ~Window();
-    int ShouldClose() const;
-    void SwapBuffers();
+// ================================ Trace ==================================
 
-    GLfloat GetWidth() const;
-    GLfloat GetHeight() const;
-    GLfloat GetAspect() const;
-    GLfloat GetScale() const;
-    const GLfloat* GetLocation() const;
+// GL calls recorded by TraceRecorder and played back by ReplayTrace().
+enum class TraceOp : std::uint8_t {
+    FRAME,  // end of a frame
+    END,
+    ENABLE,
+    DISABLE,
+    DEPTH_FUNC,
+    DEPTH_MASK,
+    COLOR_MASK,
+    CULL_FACE,
+    FRONT_FACE,
+    BLEND_FUNC,
+    VIEWPORT,
+    CLEAR_COLOR,
+    CLEAR_DEPTH,
+    CLEAR,
+    PIXEL_STORE,
+    FINISH,
+    GEN_BUFFERS,
+    DELETE_BUFFERS,
+    BIND_BUFFER,
+    BIND_BUFFER_RANGE,
+    BUFFER_DATA,
+    BUFFER_SUB_DATA,
+    BUFFER_UPDATE,  // contents written through glMapBufferRange()
+    GEN_VERTEX_ARRAYS,
+    DELETE_VERTEX_ARRAYS,
+    BIND_VERTEX_ARRAY,
+    VERTEX_ATTRIB_POINTER,
+    VERTEX_ATTRIB_I_POINTER,
+    ENABLE_VERTEX_ATTRIB_ARRAY,
+    GEN_TEXTURES,
+    DELETE_TEXTURES,
+    BIND_TEXTURE,
+    ACTIVE_TEXTURE,
+    TEX_PARAMETER,
+    TEX_IMAGE_2D,
+    TEX_IMAGE_3D,
+    TEX_SUB_IMAGE_3D,
+    COMPRESSED_TEX_IMAGE_2D,
+    TEX_BUFFER,
+    GEN_FRAMEBUFFERS,
+    DELETE_FRAMEBUFFERS,
+    BIND_FRAMEBUFFER,
+    FRAMEBUFFER_TEXTURE_2D,
+    GEN_RENDERBUFFERS,
+    DELETE_RENDERBUFFERS,
+    BIND_RENDERBUFFER,
+    RENDERBUFFER_STORAGE_MULTISAMPLE,
+    FRAMEBUFFER_RENDERBUFFER,
+    DRAW_BUFFERS,
+    DRAW_BUFFER,
+    READ_BUFFER,
+    BLIT_FRAMEBUFFER,
+    CLEAR_BUFFER,
+    READ_PIXELS,
+    CREATE_SHADER,
+    SHADER_SOURCE,
+    COMPILE_SHADER,
+    DELETE_SHADER,
+    CREATE_PROGRAM,
+    ATTACH_SHADER,
+    BIND_ATTRIB_LOCATION,
+    BIND_FRAG_DATA_LOCATION,
+    LINK_PROGRAM,
+    DELETE_PROGRAM,
+    USE_PROGRAM,
+    UNIFORM_LOCATION,
+    UNIFORM_BLOCK_INDEX,
+    UNIFORM_BLOCK_BINDING,
+    UNIFORM_FLOAT,  // glUniform{1,2,3,4}f[v]
+    UNIFORM_INT,    // glUniform{1,2,3,4}i[v]
+    UNIFORM_MATRIX,
+    GEN_QUERIES,
+    DELETE_QUERIES,
+    BEGIN_QUERY,
+    END_QUERY,
+    BEGIN_CONDITIONAL_RENDER,
+    END_CONDITIONAL_RENDER,
+    DRAW_ARRAYS,
+    DRAW_ELEMENTS,
+    DRAW_ELEMENTS_BASE_VERTEX,
+    MULTI_DRAW_ELEMENTS,
+    COUNT
+};
 
-private:
-    GLFWwindow* const m_window;
-    GLfloat m_width;
-    GLfloat m_height;
-    GLfloat m_scale;
-    GLfloat m_location[2];
-    static void Resize(GLFWwindow* const window, int width, int height);
-    static void Wheel(GLFWwindow* const window, double x, double y);
+inline const char* TraceOpName(TraceOp op) {
+    static const char* const names[] = {
+        "Frame",
+        "End",
+        "Enable",
+        "Disable",
+        "DepthFunc",
+        "DepthMask",
+        "ColorMask",
+        "CullFace",
+        "FrontFace",
+        "BlendFunc",
+        "Viewport",
+        "ClearColor",
+        "ClearDepth",
+        "Clear",
+        "PixelStorei",
+        "Finish",
+        "GenBuffers",
+        "DeleteBuffers",
+        "BindBuffer",
+        "BindBufferRange",
+        "BufferData",
+        "BufferSubData",
+        "MapBufferRange",
+        "GenVertexArrays",
+        "DeleteVertexArrays",
+        "BindVertexArray",
+        "VertexAttribPointer",
+        "VertexAttribIPointer",
+        "EnableVertexAttribArray",
+        "GenTextures",
+        "DeleteTextures",
+        "BindTexture",
+        "ActiveTexture",
+        "TexParameteri",
+        "TexImage2D",
+        "TexImage3D",
+        "TexSubImage3D",
+        "CompressedTexImage2D",
+        "TexBuffer",
+        "GenFramebuffers",
+        "DeleteFramebuffers",
+        "BindFramebuffer",
+        "FramebufferTexture2D",
+        "GenRenderbuffers",
+        "DeleteRenderbuffers",
+        "BindRenderbuffer",
+        "RenderbufferStorageMultisample",
+        "FramebufferRenderbuffer",
+        "DrawBuffers",
+        "DrawBuffer",
+        "ReadBuffer",
+        "BlitFramebuffer",
+        "ClearBufferuiv",
+        "ReadPixels",
+        "CreateShader",
+        "ShaderSource",
+        "CompileShader",
+        "DeleteShader",
+        "CreateProgram",
+        "AttachShader",
+        "BindAttribLocation",
+        "BindFragDataLocation",
+        "LinkProgram",
+        "DeleteProgram",
+        "UseProgram",
+        "GetUniformLocation",
+        "GetUniformBlockIndex",
+        "UniformBlockBinding",
+        "Uniform*f",
+        "Uniform*i",
+        "UniformMatrix*fv",
+        "GenQueries",
+        "DeleteQueries",
+        "BeginQuery",
+        "EndQuery",
+        "BeginConditionalRender",
+        "EndConditionalRender",
+        "DrawArrays",
+        "DrawElements",
+        "DrawElementsBaseVertex",
+        "MultiDrawElements"};
+    static_assert(sizeof names / sizeof names[0] ==
+                      static_cast<std::size_t>(TraceOp::COUNT),
+                  "every TraceOp needs a name");
+    return op < TraceOp::COUNT ? names[static_cast<int>(op)] : "?";
+}
+
+// Calls that produce pixels rather than state; only recorded inside the
+// frame range.
+inline bool IsTraceDraw(TraceOp op) {
+    switch (op) {
+        case TraceOp::CLEAR:
+        case TraceOp::BLIT_FRAMEBUFFER:
+        case TraceOp::CLEAR_BUFFER:
+        case TraceOp::READ_PIXELS:
+        case TraceOp::BEGIN_QUERY:
+        case TraceOp::END_QUERY:
+        case TraceOp::BEGIN_CONDITIONAL_RENDER:
+        case TraceOp::END_CONDITIONAL_RENDER:
+        case TraceOp::DRAW_ARRAYS:
+        case TraceOp::DRAW_ELEMENTS:
+        case TraceOp::DRAW_ELEMENTS_BASE_VERTEX:
+        case TraceOp::MULTI_DRAW_ELEMENTS:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Bytes of a pixel rectangle passed to glTexImage*() or glReadPixels()
+// with rows padded to `alignment`.
+inline std::size_t PixelBytes(GLenum format, GLenum type, GLsizei width,
+                              GLsizei height, GLsizei depth,
+                              GLint alignment) {
+    std::size_t components(4);
+    switch (format) {
+        case GL_RED:
+        case GL_RED_INTEGER:
+        case GL_DEPTH_COMPONENT:
+        case GL_DEPTH_STENCIL:
+            components = 1;
+            break;
+        case GL_RG:
+        case GL_RG_INTEGER:
+            components = 2;
+            break;
+        case GL_RGB:
+        case GL_BGR:
+        case GL_RGB_INTEGER:
+            components = 3;
+            break;
+    }
+    std::size_t size(4);
+    switch (type) {
+        case GL_UNSIGNED_BYTE:
+        case GL_BYTE:
+            size = 1;
+            break;
+        case GL_UNSIGNED_SHORT:
+        case GL_SHORT:
+        case GL_HALF_FLOAT:
+            size = 2;
+            break;
+        case GL_FLOAT_32_UNSIGNED_INT_24_8_REV:
+            size = 8;
+            break;
+    }
+    const std::size_t a(std::max(alignment, 1));
+    const std::size_t row((width * components * size + a - 1) / a * a);
+    return row * height * depth;
+}
+
+// Payload of a recorded call.
+struct TraceBlob {
+    const void* data;
+    std::uint64_t size;
 };
 
-// ============================= Matrix =================================
-class Matrix {
+// Trace file: this header, then records of a TraceOp byte followed by the
+// call's arguments (payloads as a 64-bit size and the bytes), ending with
+// TraceOp::END.
+struct TraceHeader {
+    char magic[8];  // "TGRTRC1"
+    std::uint32_t width;  // window size
+    std::uint32_t height;
+    std::uint32_t first;   // first recorded frame
+    std::uint32_t frames;  // recorded frames
+};
+
+// Writes the GL calls made through the trace wrappers (compiled in with
+// TGR_ENABLE_TRACE) to a file. Calls creating or changing objects and
+// state are recorded from the start so a replay can rebuild everything the
+// recorded frames use; draws only within frames [first, first + frames).
+class TraceRecorder {
 public:
-    Matrix() {}
-    Matrix(const GLfloat* a);
-    const GLfloat* Data() const;
-    Matrix operator*(const Matrix& m) const;
-    void GetNormalMatrix(GLfloat* m) const;
+    TraceRecorder(const std::string name, GLsizei width, GLsizei height,
+                  int first, int frames)
+        : m_file(name, std::ios::binary),
+          m_first(first),
+          m_frames(frames),
+          m_frame(0),
+          m_unpack_alignment(4),
+          m_pack_alignment(4) {
+        if (m_file.fail()) {
+            std::cerr << "Error: Can't open " << name << std::endl;
+            return;
+        }
+        const TraceHeader header = {
+            {'T', 'G', 'R', 'T', 'R', 'C', '1', '\0'},
+            static_cast<std::uint32_t>(width),
+            static_cast<std::uint32_t>(height),
+            static_cast<std::uint32_t>(first),
+            static_cast<std::uint32_t>(frames)};
+        Put(TraceBlob{&header, sizeof header}, false);
+    }
 
-    static Matrix Identity();
-    static Matrix Translate(GLfloat x, GLfloat y, GLfloat z);
-    static Matrix Scale(GLfloat x, GLfloat y, GLfloat z);
-    static Matrix Rotate(GLfloat theta, GLfloat x, GLfloat y, GLfloat z);
-    static Matrix LookAt(GLfloat ex, GLfloat ey, GLfloat ez,  // eye position
-                         GLfloat gx, GLfloat gy, GLfloat gz,  // target position
-                         GLfloat ux, GLfloat uy, GLfloat uz   // upper vector
-    );
-    static Matrix Orthogonal(GLfloat left, GLfloat right, GLfloat bottom,
-                             GLfloat top, GLfloat z_near, GLfloat z_far);
-    static Matrix Frustum(GLfloat left, GLfloat right, GLfloat bottom,
-                          GLfloat top, GLfloat z_near, GLfloat z_far);
-    static Matrix Perspective(GLfloat fovy, GLfloat aspect, GLfloat z_near,
-                              GLfloat z_far);
+    virtual ~TraceRecorder() {
+        Put(TraceOp::END);
+        Flush();
+    }
+
+    // Recorder receiving the wrapped calls, nullptr when not tracing.
+    static TraceRecorder*& Active() {
+        static TraceRecorder* recorder(nullptr);
+        return recorder;
+    }
+
+    // Starts recording to TGR_TRACE if set, skipping TGR_TRACE_FIRST
+    // frames (0 by default) and recording TGR_TRACE_FRAMES (60).
+    static void Start(GLsizei width, GLsizei height) {
+        const char* const name(std::getenv("TGR_TRACE"));
+        if (name == nullptr || Active() != nullptr) return;
+        const char* const first(std::getenv("TGR_TRACE_FIRST"));
+        const char* const frames(std::getenv("TGR_TRACE_FRAMES"));
+        Active() = new TraceRecorder(
+            name, width, height,
+            first != nullptr ? std::max(std::atoi(first), 0) : 0,
+            frames != nullptr ? std::max(std::atoi(frames), 1) : 60);
+    }
+
+    // Ends a frame; recording stops after the last one.
+    static void Frame() {
+        TraceRecorder* const t(Active());
+        if (t == nullptr) return;
+        if (t->m_frame >= t->m_first) t->record(TraceOp::FRAME);
+        if (++t->m_frame >= t->m_first + t->m_frames) Stop();
+    }
+
+    static void Stop() {
+        delete Active();
+        Active() = nullptr;
+    }
+
+    template <typename... Args>
+    void record(TraceOp op, const Args&... args) {
+        if (IsTraceDraw(op) && m_frame < m_first) return;
+        Put(op);
+        const int expand[] = {0, (Put(args), 0)...};
+        static_cast<void>(expand);
+    }
+
+    // Tracked state needed to size and attribute payloads
+    void bind(GLenum target, GLuint buffer) { m_bindings[target] = buffer; }
+    GLuint bound(GLenum target) const {
+        const auto it(m_bindings.find(target));
+        return it == m_bindings.end() ? 0 : it->second;
+    }
+    void unbind(GLsizei n, const GLuint* buffers) {
+        for (auto& b : m_bindings) {
+            if (std::find(buffers, buffers + n, b.second) != buffers + n) {
+                b.second = 0;
+            }
+        }
+    }
+    void pixelStore(GLenum pname, GLint param) {
+        if (pname == GL_UNPACK_ALIGNMENT) m_unpack_alignment = param;
+        if (pname == GL_PACK_ALIGNMENT) m_pack_alignment = param;
+    }
+    GLint unpackAlignment() const { return m_unpack_alignment; }
+    GLint packAlignment() const { return m_pack_alignment; }
+
+    // Mapped ranges are recorded when unmapped, once written. The buffer
+    // is queried since the element array binding is per vertex array.
+    void map(GLenum target, GLintptr offset, GLsizeiptr length,
+             GLbitfield access, void* pointer) {
+        if (pointer == nullptr || !(access & GL_MAP_WRITE_BIT)) return;
+        GLint buffer(0);
+        glGetIntegerv(Binding(target), &buffer);
+        m_maps[target] = {static_cast<GLuint>(buffer), offset, length,
+                          pointer};
+    }
+    void unmap(GLenum target) {
+        const auto it(m_maps.find(target));
+        if (it == m_maps.end()) return;
+        record(TraceOp::BUFFER_UPDATE, it->second.buffer,
+               static_cast<std::uint64_t>(it->second.offset),
+               TraceBlob{it->second.pointer,
+                         static_cast<std::uint64_t>(it->second.length)});
+        m_maps.erase(it);
+    }
 
 private:
-    GLfloat m_matrix[16];
-    /*
-     | 0  4  8 12 |
-     | 1  5  9 13 |
-     | 2  6 10 14 |
-     | 3  7 11 15 |
-    */
+    TraceRecorder(const TraceRecorder& o);
+    TraceRecorder& operator=(const TraceRecorder& o);
+
+    struct Map {
+        GLuint buffer;
+        GLintptr offset;
+        GLsizeiptr length;
+        const void* pointer;
+    };
+
+    static GLenum Binding(GLenum target) {
+        switch (target) {
+            case GL_ARRAY_BUFFER:
+                return GL_ARRAY_BUFFER_BINDING;
+            case GL_ELEMENT_ARRAY_BUFFER:
+                return GL_ELEMENT_ARRAY_BUFFER_BINDING;
+            case GL_PIXEL_PACK_BUFFER:
+                return GL_PIXEL_PACK_BUFFER_BINDING;
+            case GL_PIXEL_UNPACK_BUFFER:
+                return GL_PIXEL_UNPACK_BUFFER_BINDING;
+            case GL_TRANSFORM_FEEDBACK_BUFFER:
+                return GL_TRANSFORM_FEEDBACK_BUFFER_BINDING;
+            case GL_UNIFORM_BUFFER:
+                return GL_UNIFORM_BUFFER_BINDING;
+            default:  // copy and texture buffers are queried by target
+                return target;
+        }
+    }
+
+    template <typename T>
+    void Put(const T& v) {
+        static_assert(std::is_arithmetic<T>::value || std::is_enum<T>::value,
+                      "only scalars and TraceBlob are recorded");
+        const char* const p(reinterpret_cast<const char*>(&v));
+        m_buffer.insert(m_buffer.end(), p, p + sizeof v);
+        if (m_buffer.size() >= (1 << 20)) Flush();
+    }
+
+    void Put(const TraceBlob& blob, bool sized = true) {
+        if (sized) Put(blob.size);
+        if (blob.size == 0) return;
+        Flush();
+        m_file.write(static_cast<const char*>(blob.data),
+                     static_cast<std::streamsize>(blob.size));
+    }
+
+    void Flush() {
+        m_file.write(m_buffer.data(),
+                     static_cast<std::streamsize>(m_buffer.size()));
+        m_buffer.clear();
+    }
+
+    std::ofstream m_file;
+    std::vector<char> m_buffer;
+    const int m_first;
+    const int m_frames;
+    int m_frame;
+    GLint m_unpack_alignment;
+    GLint m_pack_alignment;
+    std::unordered_map<GLenum, GLuint> m_bindings;
+    std::unordered_map<GLenum, Map> m_maps;
 };
 
-// ============================= Vector =================================
+#ifdef TGR_ENABLE_TRACE
+// Wrappers replacing the gl* names below for the rest of every translation
+// unit including this header, library and user code alike. TGR_ENABLE_TRACE
+// must be defined for all of them (CMake option TGR_ENABLE_TRACE).
 
-typedef std::array<GLfloat, 4> Vector;
+inline TraceBlob TraceNames(GLsizei n, const GLuint* names) {
+    return {names, static_cast<std::uint64_t>(n) * sizeof(GLuint)};
+}
 
-Vector operator*(const Matrix& m, const Vector& v) {
-    Vector t;
-    for (int i = 0; i < 4; i++) {
-        t[i] = m.Data()[0 + i] * v[0] + m.Data()[4 + i] * v[1] +
-               m.Data()[8 + i] * v[2] + m.Data()[12 + i] * v[3];
+inline TraceBlob TraceString(const GLchar* s) {
+    return {s, std::strlen(s)};
+}
+
+inline std::uint64_t TraceOffset(const void* p) {
+    return static_cast<std::uint64_t>(reinterpret_cast<std::uintptr_t>(p));
+}
+
+inline void TraceEnable(GLenum cap) {
+    glEnable(cap);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::ENABLE, cap);
+}
+
+inline void TraceDisable(GLenum cap) {
+    glDisable(cap);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::DISABLE, cap);
+}
+
+inline void TraceDepthFunc(GLenum func) {
+    glDepthFunc(func);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::DEPTH_FUNC, func);
+}
+
+inline void TraceDepthMask(GLboolean flag) {
+    glDepthMask(flag);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::DEPTH_MASK, flag);
+}
+
+inline void TraceColorMask(GLboolean r, GLboolean g, GLboolean b,
+                           GLboolean a) {
+    glColorMask(r, g, b, a);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::COLOR_MASK, r, g, b, a);
+}
+
+inline void TraceCullFace(GLenum mode) {
+    glCullFace(mode);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::CULL_FACE, mode);
+}
+
+inline void TraceFrontFace(GLenum mode) {
+    glFrontFace(mode);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::FRONT_FACE, mode);
+}
+
+inline void TraceBlendFunc(GLenum sfactor, GLenum dfactor) {
+    glBlendFunc(sfactor, dfactor);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::BLEND_FUNC, sfactor, dfactor);
+}
+
+inline void TraceViewport(GLint x, GLint y, GLsizei width, GLsizei height) {
+    glViewport(x, y, width, height);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::VIEWPORT, x, y, width, height);
+}
+
+inline void TraceClearColor(GLfloat r, GLfloat g, GLfloat b, GLfloat a) {
+    glClearColor(r, g, b, a);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::CLEAR_COLOR, r, g, b, a);
+}
+
+inline void TraceClearDepth(GLdouble depth) {
+    glClearDepth(depth);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::CLEAR_DEPTH, depth);
+}
+
+inline void TraceClear(GLbitfield mask) {
+    glClear(mask);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::CLEAR, mask);
+}
+
+inline void TracePixelStorei(GLenum pname, GLint param) {
+    glPixelStorei(pname, param);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->pixelStore(pname, param);
+    t->record(TraceOp::PIXEL_STORE, pname, param);
+}
+
+inline void TraceFinish() {
+    glFinish();
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::FINISH);
+}
+
+inline void TraceGenBuffers(GLsizei n, GLuint* buffers) {
+    glGenBuffers(n, buffers);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::GEN_BUFFERS, TraceNames(n, buffers));
+}
+
+inline void TraceDeleteBuffers(GLsizei n, const GLuint* buffers) {
+    glDeleteBuffers(n, buffers);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->unbind(n, buffers);
+    t->record(TraceOp::DELETE_BUFFERS, TraceNames(n, buffers));
+}
+
+inline void TraceBindBuffer(GLenum target, GLuint buffer) {
+    glBindBuffer(target, buffer);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->bind(target, buffer);
+    t->record(TraceOp::BIND_BUFFER, target, buffer);
+}
+
+inline void TraceBindBufferRange(GLenum target, GLuint index, GLuint buffer,
+                                 GLintptr offset, GLsizeiptr size) {
+    glBindBufferRange(target, index, buffer, offset, size);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->bind(target, buffer);
+    t->record(TraceOp::BIND_BUFFER_RANGE, target, index, buffer,
+              static_cast<std::int64_t>(offset),
+              static_cast<std::int64_t>(size));
+}
+
+inline void TraceBufferData(GLenum target, GLsizeiptr size, const void* data,
+                            GLenum usage) {
+    glBufferData(target, size, data, usage);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->record(TraceOp::BUFFER_DATA, target, static_cast<std::int64_t>(size),
+              TraceBlob{data, data != nullptr
+                                  ? static_cast<std::uint64_t>(size)
+                                  : 0},
+              usage);
+}
+
+inline void TraceBufferSubData(GLenum target, GLintptr offset,
+                               GLsizeiptr size, const void* data) {
+    glBufferSubData(target, offset, size, data);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->record(TraceOp::BUFFER_SUB_DATA, target,
+              static_cast<std::int64_t>(offset),
+              TraceBlob{data, static_cast<std::uint64_t>(size)});
+}
+
+inline void* TraceMapBufferRange(GLenum target, GLintptr offset,
+                                 GLsizeiptr length, GLbitfield access) {
+    void* const p(glMapBufferRange(target, offset, length, access));
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->map(target, offset, length, access, p);
+    return p;
+}
+
+inline GLboolean TraceUnmapBuffer(GLenum target) {
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->unmap(target);  // while the pointer is valid
+    return glUnmapBuffer(target);
+}
+
+inline void TraceGenVertexArrays(GLsizei n, GLuint* arrays) {
+    glGenVertexArrays(n, arrays);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) {
+        t->record(TraceOp::GEN_VERTEX_ARRAYS, TraceNames(n, arrays));
     }
-    return t;
 }
 
-// ============================ Geometry ================================
+inline void TraceDeleteVertexArrays(GLsizei n, const GLuint* arrays) {
+    glDeleteVertexArrays(n, arrays);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) {
+        t->record(TraceOp::DELETE_VERTEX_ARRAYS, TraceNames(n, arrays));
+    }
+}
 
-template <int N>
-struct Vertex {
-    GLfloat position[N];
-    GLfloat normal[N];
-};
+inline void TraceBindVertexArray(GLuint array) {
+    glBindVertexArray(array);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::BIND_VERTEX_ARRAY, array);
+}
 
-using Vertex2D = Vertex<2>;
-using Vertex3D = Vertex<3>;
+inline void TraceVertexAttribPointer(GLuint index, GLint size, GLenum type,
+                                     GLboolean normalized, GLsizei stride,
+                                     const void* pointer) {
+    glVertexAttribPointer(index, size, type, normalized, stride, pointer);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->record(TraceOp::VERTEX_ATTRIB_POINTER, index, size, type, normalized,
+              stride, TraceOffset(pointer));
+}
 
-template <int N>
-class Object {
-public:
-    Object(GLint size, GLsizei vtx_cnt, const Vertex<N>* vtx,
-           GLsizei idx_cnt = 0, const GLuint* idx = nullptr) {
-        // vertex array object
-        glGenVertexArrays(1, &m_vao);
-        glBindVertexArray(m_vao);
+inline void TraceVertexAttribIPointer(GLuint index, GLint size, GLenum type,
+                                      GLsizei stride, const void* pointer) {
+    glVertexAttribIPointer(index, size, type, stride, pointer);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->record(TraceOp::VERTEX_ATTRIB_I_POINTER, index, size, type, stride,
+              TraceOffset(pointer));
+}
 
-        // vertex buffer object
-        glGenBuffers(1, &m_vbo);
-        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
-        glBufferData(GL_ARRAY_BUFFER, vtx_cnt * sizeof(Vertex<N>), vtx,
-                     GL_STATIC_DRAW);
+inline void TraceEnableVertexAttribArray(GLuint index) {
+    glEnableVertexAttribArray(index);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::ENABLE_VERTEX_ATTRIB_ARRAY, index);
+}
 
-        glVertexAttribPointer(0, size, GL_FLOAT, GL_FALSE, sizeof(Vertex<N>),
-                              0);
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex<N>),
-                              static_cast<char*>(0) + sizeof vtx->position);
-        glEnableVertexAttribArray(1);
+inline void TraceGenTextures(GLsizei n, GLuint* textures) {
+    glGenTextures(n, textures);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) {
+        t->record(TraceOp::GEN_TEXTURES, TraceNames(n, textures));
+    }
+}
 
-        // index buffer object
-        glGenBuffers(1, &m_ibo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx_cnt * sizeof(GLuint), idx,
-                     GL_STATIC_DRAW);
+inline void TraceDeleteTextures(GLsizei n, const GLuint* textures) {
+    glDeleteTextures(n, textures);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) {
+        t->record(TraceOp::DELETE_TEXTURES, TraceNames(n, textures));
+    }
+}
+
+inline void TraceBindTexture(GLenum target, GLuint texture) {
+    glBindTexture(target, texture);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::BIND_TEXTURE, target, texture);
+}
+
+inline void TraceActiveTexture(GLenum texture) {
+    glActiveTexture(texture);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::ACTIVE_TEXTURE, texture);
+}
+
+inline void TraceTexParameteri(GLenum target, GLenum pname, GLint param) {
+    glTexParameteri(target, pname, param);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::TEX_PARAMETER, target, pname, param);
+}
+
+inline void TraceTexImage2D(GLenum target, GLint level, GLint internalformat,
+                            GLsizei width, GLsizei height, GLint border,
+                            GLenum format, GLenum type, const void* pixels) {
+    glTexImage2D(target, level, internalformat, width, height, border, format,
+                 type, pixels);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    const std::size_t bytes(
+        pixels != nullptr ? PixelBytes(format, type, width, height, 1,
+                                       t->unpackAlignment())
+                          : 0);
+    t->record(TraceOp::TEX_IMAGE_2D, target, level, internalformat, width,
+              height, format, type, TraceBlob{pixels, bytes});
+}
+
+inline void TraceTexImage3D(GLenum target, GLint level, GLint internalformat,
+                            GLsizei width, GLsizei height, GLsizei depth,
+                            GLint border, GLenum format, GLenum type,
+                            const void* pixels) {
+    glTexImage3D(target, level, internalformat, width, height, depth, border,
+                 format, type, pixels);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    const std::size_t bytes(
+        pixels != nullptr ? PixelBytes(format, type, width, height, depth,
+                                       t->unpackAlignment())
+                          : 0);
+    t->record(TraceOp::TEX_IMAGE_3D, target, level, internalformat, width,
+              height, depth, format, type, TraceBlob{pixels, bytes});
+}
+
+inline void TraceTexSubImage3D(GLenum target, GLint level, GLint xoffset,
+                               GLint yoffset, GLint zoffset, GLsizei width,
+                               GLsizei height, GLsizei depth, GLenum format,
+                               GLenum type, const void* pixels) {
+    glTexSubImage3D(target, level, xoffset, yoffset, zoffset, width, height,
+                    depth, format, type, pixels);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->record(TraceOp::TEX_SUB_IMAGE_3D, target, level, xoffset, yoffset,
+              zoffset, width, height, depth, format, type,
+              TraceBlob{pixels, PixelBytes(format, type, width, height, depth,
+                                           t->unpackAlignment())});
+}
+
+inline void TraceCompressedTexImage2D(GLenum target, GLint level,
+                                      GLenum internalformat, GLsizei width,
+                                      GLsizei height, GLint border,
+                                      GLsizei size, const void* data) {
+    glCompressedTexImage2D(target, level, internalformat, width, height,
+                           border, size, data);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->record(TraceOp::COMPRESSED_TEX_IMAGE_2D, target, level, internalformat,
+              width, height, TraceBlob{data, static_cast<std::uint64_t>(size)});
+}
+
+inline void TraceTexBuffer(GLenum target, GLenum internalformat,
+                           GLuint buffer) {
+    glTexBuffer(target, internalformat, buffer);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->record(TraceOp::TEX_BUFFER, target, internalformat, buffer);
+}
+
+inline void TraceGenFramebuffers(GLsizei n, GLuint* framebuffers) {
+    glGenFramebuffers(n, framebuffers);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) {
+        t->record(TraceOp::GEN_FRAMEBUFFERS, TraceNames(n, framebuffers));
+    }
+}
+
+inline void TraceDeleteFramebuffers(GLsizei n, const GLuint* framebuffers) {
+    glDeleteFramebuffers(n, framebuffers);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) {
+        t->record(TraceOp::DELETE_FRAMEBUFFERS, TraceNames(n, framebuffers));
+    }
+}
+
+inline void TraceBindFramebuffer(GLenum target, GLuint framebuffer) {
+    glBindFramebuffer(target, framebuffer);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) {
+        t->record(TraceOp::BIND_FRAMEBUFFER, target, framebuffer);
+    }
+}
+
+inline void TraceFramebufferTexture2D(GLenum target, GLenum attachment,
+                                      GLenum textarget, GLuint texture,
+                                      GLint level) {
+    glFramebufferTexture2D(target, attachment, textarget, texture, level);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->record(TraceOp::FRAMEBUFFER_TEXTURE_2D, target, attachment, textarget,
+              texture, level);
+}
+
+inline void TraceGenRenderbuffers(GLsizei n, GLuint* renderbuffers) {
+    glGenRenderbuffers(n, renderbuffers);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) {
+        t->record(TraceOp::GEN_RENDERBUFFERS, TraceNames(n, renderbuffers));
+    }
+}
+
+inline void TraceDeleteRenderbuffers(GLsizei n, const GLuint* renderbuffers) {
+    glDeleteRenderbuffers(n, renderbuffers);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) {
+        t->record(TraceOp::DELETE_RENDERBUFFERS,
+                  TraceNames(n, renderbuffers));
+    }
+}
+
+inline void TraceBindRenderbuffer(GLenum target, GLuint renderbuffer) {
+    glBindRenderbuffer(target, renderbuffer);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) {
+        t->record(TraceOp::BIND_RENDERBUFFER, target, renderbuffer);
+    }
+}
+
+inline void TraceRenderbufferStorageMultisample(GLenum target,
+                                                GLsizei samples,
+                                                GLenum internalformat,
+                                                GLsizei width,
+                                                GLsizei height) {
+    glRenderbufferStorageMultisample(target, samples, internalformat, width,
+                                     height);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->record(TraceOp::RENDERBUFFER_STORAGE_MULTISAMPLE, target, samples,
+              internalformat, width, height);
+}
+
+inline void TraceFramebufferRenderbuffer(GLenum target, GLenum attachment,
+                                         GLenum renderbuffertarget,
+                                         GLuint renderbuffer) {
+    glFramebufferRenderbuffer(target, attachment, renderbuffertarget,
+                              renderbuffer);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->record(TraceOp::FRAMEBUFFER_RENDERBUFFER, target, attachment,
+              renderbuffertarget, renderbuffer);
+}
+
+inline void TraceDrawBuffers(GLsizei n, const GLenum* bufs) {
+    glDrawBuffers(n, bufs);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::DRAW_BUFFERS, TraceNames(n, bufs));
+}
+
+inline void TraceDrawBuffer(GLenum buf) {
+    glDrawBuffer(buf);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::DRAW_BUFFER, buf);
+}
+
+inline void TraceReadBuffer(GLenum src) {
+    glReadBuffer(src);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::READ_BUFFER, src);
+}
+
+inline void TraceBlitFramebuffer(GLint sx0, GLint sy0, GLint sx1, GLint sy1,
+                                 GLint dx0, GLint dy0, GLint dx1, GLint dy1,
+                                 GLbitfield mask, GLenum filter) {
+    glBlitFramebuffer(sx0, sy0, sx1, sy1, dx0, dy0, dx1, dy1, mask, filter);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->record(TraceOp::BLIT_FRAMEBUFFER, sx0, sy0, sx1, sy1, dx0, dy0, dx1,
+              dy1, mask, filter);
+}
+
+inline void TraceClearBufferuiv(GLenum buffer, GLint drawbuffer,
+                                const GLuint* value) {
+    glClearBufferuiv(buffer, drawbuffer, value);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->record(TraceOp::CLEAR_BUFFER, buffer, drawbuffer,
+              TraceBlob{value, (buffer == GL_COLOR ? 4 : 1) * sizeof(GLuint)});
+}
+
+inline void TraceReadPixels(GLint x, GLint y, GLsizei width, GLsizei height,
+                            GLenum format, GLenum type, void* pixels) {
+    glReadPixels(x, y, width, height, format, type, pixels);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    // into a pixel buffer the pointer is an offset
+    const bool pbo(t->bound(GL_PIXEL_PACK_BUFFER) != 0);
+    t->record(TraceOp::READ_PIXELS, x, y, width, height, format, type,
+              static_cast<GLint>(pbo), pbo ? TraceOffset(pixels) : 0,
+              static_cast<std::uint64_t>(PixelBytes(
+                  format, type, width, height, 1, t->packAlignment())));
+}
+
+inline GLuint TraceCreateShader(GLenum type) {
+    const GLuint shader(glCreateShader(type));
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::CREATE_SHADER, type, shader);
+    return shader;
+}
+
+inline void TraceShaderSource(GLuint shader, GLsizei count,
+                              const GLchar* const* string,
+                              const GLint* length) {
+    glShaderSource(shader, count, string, length);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    std::string source;
+    for (GLsizei i = 0; i < count; i++) {
+        if (length != nullptr && length[i] >= 0) {
+            source.append(string[i], length[i]);
+        } else {
+            source.append(string[i]);
+        }
+    }
+    t->record(TraceOp::SHADER_SOURCE, shader,
+              TraceBlob{source.data(), source.size()});
+}
+
+inline void TraceCompileShader(GLuint shader) {
+    glCompileShader(shader);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::COMPILE_SHADER, shader);
+}
+
+inline void TraceDeleteShader(GLuint shader) {
+    glDeleteShader(shader);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::DELETE_SHADER, shader);
+}
+
+inline GLuint TraceCreateProgram() {
+    const GLuint program(glCreateProgram());
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::CREATE_PROGRAM, program);
+    return program;
+}
+
+inline void TraceAttachShader(GLuint program, GLuint shader) {
+    glAttachShader(program, shader);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::ATTACH_SHADER, program, shader);
+}
+
+inline void TraceBindAttribLocation(GLuint program, GLuint index,
+                                    const GLchar* name) {
+    glBindAttribLocation(program, index, name);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->record(TraceOp::BIND_ATTRIB_LOCATION, program, index,
+              TraceString(name));
+}
+
+inline void TraceBindFragDataLocation(GLuint program, GLuint color,
+                                      const GLchar* name) {
+    glBindFragDataLocation(program, color, name);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->record(TraceOp::BIND_FRAG_DATA_LOCATION, program, color,
+              TraceString(name));
+}
+
+inline void TraceLinkProgram(GLuint program) {
+    glLinkProgram(program);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::LINK_PROGRAM, program);
+}
+
+inline void TraceDeleteProgram(GLuint program) {
+    glDeleteProgram(program);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::DELETE_PROGRAM, program);
+}
+
+inline void TraceUseProgram(GLuint program) {
+    glUseProgram(program);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::USE_PROGRAM, program);
+}
+
+// Locations and block indices are looked up again when replaying.
+inline GLint TraceGetUniformLocation(GLuint program, const GLchar* name) {
+    const GLint location(glGetUniformLocation(program, name));
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return location;
+    t->record(TraceOp::UNIFORM_LOCATION, program, location,
+              TraceString(name));
+    return location;
+}
+
+inline GLuint TraceGetUniformBlockIndex(GLuint program, const GLchar* name) {
+    const GLuint index(glGetUniformBlockIndex(program, name));
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return index;
+    t->record(TraceOp::UNIFORM_BLOCK_INDEX, program, index,
+              TraceString(name));
+    return index;
+}
+
+inline void TraceGetActiveUniformBlockName(GLuint program, GLuint index,
+                                           GLsizei size, GLsizei* length,
+                                           GLchar* name) {
+    glGetActiveUniformBlockName(program, index, size, length, name);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr || size <= 0) return;
+    t->record(TraceOp::UNIFORM_BLOCK_INDEX, program, index,
+              TraceString(name));
+}
+
+inline void TraceUniformBlockBinding(GLuint program, GLuint index,
+                                     GLuint binding) {
+    glUniformBlockBinding(program, index, binding);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->record(TraceOp::UNIFORM_BLOCK_BINDING, program, index, binding);
+}
+
+inline void TraceUniform(GLint location, GLint components, GLsizei count,
+                         const GLfloat* v) {
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->record(TraceOp::UNIFORM_FLOAT, location, components,
+              TraceBlob{v, sizeof(GLfloat) * components * count});
+}
+
+inline void TraceUniform(GLint location, GLint components, GLsizei count,
+                         const GLint* v) {
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->record(TraceOp::UNIFORM_INT, location, components,
+              TraceBlob{v, sizeof(GLint) * components * count});
+}
+
+inline void TraceUniform1f(GLint location, GLfloat v0) {
+    glUniform1f(location, v0);
+    TraceUniform(location, 1, 1, &v0);
+}
+
+inline void TraceUniform1i(GLint location, GLint v0) {
+    glUniform1i(location, v0);
+    TraceUniform(location, 1, 1, &v0);
+}
+
+inline void TraceUniform1fv(GLint location, GLsizei count, const GLfloat* v) {
+    glUniform1fv(location, count, v);
+    TraceUniform(location, 1, count, v);
+}
+
+inline void TraceUniform2fv(GLint location, GLsizei count, const GLfloat* v) {
+    glUniform2fv(location, count, v);
+    TraceUniform(location, 2, count, v);
+}
+
+inline void TraceUniform3fv(GLint location, GLsizei count, const GLfloat* v) {
+    glUniform3fv(location, count, v);
+    TraceUniform(location, 3, count, v);
+}
+
+inline void TraceUniform4fv(GLint location, GLsizei count, const GLfloat* v) {
+    glUniform4fv(location, count, v);
+    TraceUniform(location, 4, count, v);
+}
+
+inline void TraceUniform1iv(GLint location, GLsizei count, const GLint* v) {
+    glUniform1iv(location, count, v);
+    TraceUniform(location, 1, count, v);
+}
+
+inline void TraceUniform2iv(GLint location, GLsizei count, const GLint* v) {
+    glUniform2iv(location, count, v);
+    TraceUniform(location, 2, count, v);
+}
+
+inline void TraceUniform3iv(GLint location, GLsizei count, const GLint* v) {
+    glUniform3iv(location, count, v);
+    TraceUniform(location, 3, count, v);
+}
+
+inline void TraceUniform4iv(GLint location, GLsizei count, const GLint* v) {
+    glUniform4iv(location, count, v);
+    TraceUniform(location, 4, count, v);
+}
+
+inline void TraceUniformMatrix2fv(GLint location, GLsizei count,
+                                  GLboolean transpose, const GLfloat* v) {
+    glUniformMatrix2fv(location, count, transpose, v);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->record(TraceOp::UNIFORM_MATRIX, location, 2, transpose,
+              TraceBlob{v, sizeof(GLfloat) * 4 * count});
+}
+
+inline void TraceUniformMatrix3fv(GLint location, GLsizei count,
+                                  GLboolean transpose, const GLfloat* v) {
+    glUniformMatrix3fv(location, count, transpose, v);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->record(TraceOp::UNIFORM_MATRIX, location, 3, transpose,
+              TraceBlob{v, sizeof(GLfloat) * 9 * count});
+}
+
+inline void TraceUniformMatrix4fv(GLint location, GLsizei count,
+                                  GLboolean transpose, const GLfloat* v) {
+    glUniformMatrix4fv(location, count, transpose, v);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->record(TraceOp::UNIFORM_MATRIX, location, 4, transpose,
+              TraceBlob{v, sizeof(GLfloat) * 16 * count});
+}
+
+inline void TraceGenQueries(GLsizei n, GLuint* ids) {
+    glGenQueries(n, ids);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::GEN_QUERIES, TraceNames(n, ids));
+}
+
+inline void TraceDeleteQueries(GLsizei n, const GLuint* ids) {
+    glDeleteQueries(n, ids);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::DELETE_QUERIES, TraceNames(n, ids));
+}
+
+inline void TraceBeginQuery(GLenum target, GLuint id) {
+    glBeginQuery(target, id);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::BEGIN_QUERY, target, id);
+}
+
+inline void TraceEndQuery(GLenum target) {
+    glEndQuery(target);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::END_QUERY, target);
+}
+
+inline void TraceBeginConditionalRender(GLuint id, GLenum mode) {
+    glBeginConditionalRender(id, mode);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::BEGIN_CONDITIONAL_RENDER, id, mode);
+}
+
+inline void TraceEndConditionalRender() {
+    glEndConditionalRender();
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::END_CONDITIONAL_RENDER);
+}
+
+inline void TraceDrawArrays(GLenum mode, GLint first, GLsizei count) {
+    glDrawArrays(mode, first, count);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t != nullptr) t->record(TraceOp::DRAW_ARRAYS, mode, first, count);
+}
+
+inline void TraceDrawElements(GLenum mode, GLsizei count, GLenum type,
+                              const void* indices) {
+    glDrawElements(mode, count, type, indices);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->record(TraceOp::DRAW_ELEMENTS, mode, count, type,
+              TraceOffset(indices));
+}
+
+inline void TraceDrawElementsBaseVertex(GLenum mode, GLsizei count,
+                                        GLenum type, const void* indices,
+                                        GLint basevertex) {
+    glDrawElementsBaseVertex(mode, count, type, indices, basevertex);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    t->record(TraceOp::DRAW_ELEMENTS_BASE_VERTEX, mode, count, type,
+              TraceOffset(indices), basevertex);
+}
+
+inline void TraceMultiDrawElements(GLenum mode, const GLsizei* count,
+                                   GLenum type, const void* const* indices,
+                                   GLsizei drawcount) {
+    glMultiDrawElements(mode, count, type, indices, drawcount);
+    TraceRecorder* const t(TraceRecorder::Active());
+    if (t == nullptr) return;
+    std::vector<std::uint64_t> offsets(drawcount);
+    for (GLsizei i = 0; i < drawcount; i++) {
+        offsets[i] = TraceOffset(indices[i]);
+    }
+    t->record(TraceOp::MULTI_DRAW_ELEMENTS, mode, type,
+              TraceBlob{count, sizeof(GLsizei) * drawcount},
+              TraceBlob{offsets.data(), sizeof(std::uint64_t) * drawcount});
+}
+
+// GLEW defines most of these as macros of its function pointers
+#undef glEnable
+#define glEnable ::tiny_glfw_renderer::TraceEnable
+#undef glDisable
+#define glDisable ::tiny_glfw_renderer::TraceDisable
+#undef glDepthFunc
+#define glDepthFunc ::tiny_glfw_renderer::TraceDepthFunc
+#undef glDepthMask
+#define glDepthMask ::tiny_glfw_renderer::TraceDepthMask
+#undef glColorMask
+#define glColorMask ::tiny_glfw_renderer::TraceColorMask
+#undef glCullFace
+#define glCullFace ::tiny_glfw_renderer::TraceCullFace
+#undef glFrontFace
+#define glFrontFace ::tiny_glfw_renderer::TraceFrontFace
+#undef glBlendFunc
+#define glBlendFunc ::tiny_glfw_renderer::TraceBlendFunc
+#undef glViewport
+#define glViewport ::tiny_glfw_renderer::TraceViewport
+#undef glClearColor
+#define glClearColor ::tiny_glfw_renderer::TraceClearColor
+#undef glClearDepth
+#define glClearDepth ::tiny_glfw_renderer::TraceClearDepth
+#undef glClear
+#define glClear ::tiny_glfw_renderer::TraceClear
+#undef glPixelStorei
+#define glPixelStorei ::tiny_glfw_renderer::TracePixelStorei
+#undef glFinish
+#define glFinish ::tiny_glfw_renderer::TraceFinish
+#undef glGenBuffers
+#define glGenBuffers ::tiny_glfw_renderer::TraceGenBuffers
+#undef glDeleteBuffers
+#define glDeleteBuffers ::tiny_glfw_renderer::TraceDeleteBuffers
+#undef glBindBuffer
+#define glBindBuffer ::tiny_glfw_renderer::TraceBindBuffer
+#undef glBindBufferRange
+#define glBindBufferRange ::tiny_glfw_renderer::TraceBindBufferRange
+#undef glBufferData
+#define glBufferData ::tiny_glfw_renderer::TraceBufferData
+#undef glBufferSubData
+#define glBufferSubData ::tiny_glfw_renderer::TraceBufferSubData
+#undef glMapBufferRange
+#define glMapBufferRange ::tiny_glfw_renderer::TraceMapBufferRange
+#undef glUnmapBuffer
+#define glUnmapBuffer ::tiny_glfw_renderer::TraceUnmapBuffer
+#undef glGenVertexArrays
+#define glGenVertexArrays ::tiny_glfw_renderer::TraceGenVertexArrays
+#undef glDeleteVertexArrays
+#define glDeleteVertexArrays ::tiny_glfw_renderer::TraceDeleteVertexArrays
+#undef glBindVertexArray
+#define glBindVertexArray ::tiny_glfw_renderer::TraceBindVertexArray
+#undef glVertexAttribPointer
+#define glVertexAttribPointer ::tiny_glfw_renderer::TraceVertexAttribPointer
+#undef glVertexAttribIPointer
+#define glVertexAttribIPointer ::tiny_glfw_renderer::TraceVertexAttribIPointer
+#undef glEnableVertexAttribArray
+#define glEnableVertexAttribArray \
+    ::tiny_glfw_renderer::TraceEnableVertexAttribArray
+#undef glGenTextures
+#define glGenTextures ::tiny_glfw_renderer::TraceGenTextures
+#undef glDeleteTextures
+#define glDeleteTextures ::tiny_glfw_renderer::TraceDeleteTextures
+#undef glBindTexture
+#define glBindTexture ::tiny_glfw_renderer::TraceBindTexture
+#undef glActiveTexture
+#define glActiveTexture ::tiny_glfw_renderer::TraceActiveTexture
+#undef glTexParameteri
+#define glTexParameteri ::tiny_glfw_renderer::TraceTexParameteri
+#undef glTexImage2D
+#define glTexImage2D ::tiny_glfw_renderer::TraceTexImage2D
+#undef glTexImage3D
+#define glTexImage3D ::tiny_glfw_renderer::TraceTexImage3D
+#undef glTexSubImage3D
+#define glTexSubImage3D ::tiny_glfw_renderer::TraceTexSubImage3D
+#undef glCompressedTexImage2D
+#define glCompressedTexImage2D ::tiny_glfw_renderer::TraceCompressedTexImage2D
+#undef glTexBuffer
+#define glTexBuffer ::tiny_glfw_renderer::TraceTexBuffer
+#undef glGenFramebuffers
+#define glGenFramebuffers ::tiny_glfw_renderer::TraceGenFramebuffers
+#undef glDeleteFramebuffers
+#define glDeleteFramebuffers ::tiny_glfw_renderer::TraceDeleteFramebuffers
+#undef glBindFramebuffer
+#define glBindFramebuffer ::tiny_glfw_renderer::TraceBindFramebuffer
+#undef glFramebufferTexture2D
+#define glFramebufferTexture2D ::tiny_glfw_renderer::TraceFramebufferTexture2D
+#undef glGenRenderbuffers
+#define glGenRenderbuffers ::tiny_glfw_renderer::TraceGenRenderbuffers
+#undef glDeleteRenderbuffers
+#define glDeleteRenderbuffers ::tiny_glfw_renderer::TraceDeleteRenderbuffers
+#undef glBindRenderbuffer
+#define glBindRenderbuffer ::tiny_glfw_renderer::TraceBindRenderbuffer
+#undef glRenderbufferStorageMultisample
+#define glRenderbufferStorageMultisample \
+    ::tiny_glfw_renderer::TraceRenderbufferStorageMultisample
+#undef glFramebufferRenderbuffer
+#define glFramebufferRenderbuffer \
+    ::tiny_glfw_renderer::TraceFramebufferRenderbuffer
+#undef glDrawBuffers
+#define glDrawBuffers ::tiny_glfw_renderer::TraceDrawBuffers
+#undef glDrawBuffer
+#define glDrawBuffer ::tiny_glfw_renderer::TraceDrawBuffer
+#undef glReadBuffer
+#define glReadBuffer ::tiny_glfw_renderer::TraceReadBuffer
+#undef glBlitFramebuffer
+#define glBlitFramebuffer ::tiny_glfw_renderer::TraceBlitFramebuffer
+#undef glClearBufferuiv
+#define glClearBufferuiv ::tiny_glfw_renderer::TraceClearBufferuiv
+#undef glReadPixels
+#define glReadPixels ::tiny_glfw_renderer::TraceReadPixels
+#undef glCreateShader
+#define glCreateShader ::tiny_glfw_renderer::TraceCreateShader
+#undef glShaderSource
+#define glShaderSource ::tiny_glfw_renderer::TraceShaderSource
+#undef glCompileShader
+#define glCompileShader ::tiny_glfw_renderer::TraceCompileShader
+#undef glDeleteShader
+#define glDeleteShader ::tiny_glfw_renderer::TraceDeleteShader
+#undef glCreateProgram
+#define glCreateProgram ::tiny_glfw_renderer::TraceCreateProgram
+#undef glAttachShader
+#define glAttachShader ::tiny_glfw_renderer::TraceAttachShader
+#undef glBindAttribLocation
+#define glBindAttribLocation ::tiny_glfw_renderer::TraceBindAttribLocation
+#undef glBindFragDataLocation
+#define glBindFragDataLocation ::tiny_glfw_renderer::TraceBindFragDataLocation
+#undef glLinkProgram
+#define glLinkProgram ::tiny_glfw_renderer::TraceLinkProgram
+#undef glDeleteProgram
+#define glDeleteProgram ::tiny_glfw_renderer::TraceDeleteProgram
+#undef glUseProgram
+#define glUseProgram ::tiny_glfw_renderer::TraceUseProgram
+#undef glGetUniformLocation
+#define glGetUniformLocation ::tiny_glfw_renderer::TraceGetUniformLocation
+#undef glGetUniformBlockIndex
+#define glGetUniformBlockIndex ::tiny_glfw_renderer::TraceGetUniformBlockIndex
+#undef glGetActiveUniformBlockName
+#define glGetActiveUniformBlockName \
+    ::tiny_glfw_renderer::TraceGetActiveUniformBlockName
+#undef glUniformBlockBinding
+#define glUniformBlockBinding ::tiny_glfw_renderer::TraceUniformBlockBinding
+#undef glUniform1f
+#define glUniform1f ::tiny_glfw_renderer::TraceUniform1f
+#undef glUniform1i
+#define glUniform1i ::tiny_glfw_renderer::TraceUniform1i
+#undef glUniform1fv
+#define glUniform1fv ::tiny_glfw_renderer::TraceUniform1fv
+#undef glUniform2fv
+#define glUniform2fv ::tiny_glfw_renderer::TraceUniform2fv
+#undef glUniform3fv
+#define glUniform3fv ::tiny_glfw_renderer::TraceUniform3fv
+#undef glUniform4fv
+#define glUniform4fv ::tiny_glfw_renderer::TraceUniform4fv
+#undef glUniform1iv
+#define glUniform1iv ::tiny_glfw_renderer::TraceUniform1iv
+#undef glUniform2iv
+#define glUniform2iv ::tiny_glfw_renderer::TraceUniform2iv
+#undef glUniform3iv
+#define glUniform3iv ::tiny_glfw_renderer::TraceUniform3iv
+#undef glUniform4iv
+#define glUniform4iv ::tiny_glfw_renderer::TraceUniform4iv
+#undef glUniformMatrix2fv
+#define glUniformMatrix2fv ::tiny_glfw_renderer::TraceUniformMatrix2fv
+#undef glUniformMatrix3fv
+#define glUniformMatrix3fv ::tiny_glfw_renderer::TraceUniformMatrix3fv
+#undef glUniformMatrix4fv
+#define glUniformMatrix4fv ::tiny_glfw_renderer::TraceUniformMatrix4fv
+#undef glGenQueries
+#define glGenQueries ::tiny_glfw_renderer::TraceGenQueries
+#undef glDeleteQueries
+#define glDeleteQueries ::tiny_glfw_renderer::TraceDeleteQueries
+#undef glBeginQuery
+#define glBeginQuery ::tiny_glfw_renderer::TraceBeginQuery
+#undef glEndQuery
+#define glEndQuery ::tiny_glfw_renderer::TraceEndQuery
+#undef glBeginConditionalRender
+#define glBeginConditionalRender \
+    ::tiny_glfw_renderer::TraceBeginConditionalRender
+#undef glEndConditionalRender
+#define glEndConditionalRender ::tiny_glfw_renderer::TraceEndConditionalRender
+#undef glDrawArrays
+#define glDrawArrays ::tiny_glfw_renderer::TraceDrawArrays
+#undef glDrawElements
+#define glDrawElements ::tiny_glfw_renderer::TraceDrawElements
+#undef glDrawElementsBaseVertex
+#define glDrawElementsBaseVertex \
+    ::tiny_glfw_renderer::TraceDrawElementsBaseVertex
+#undef glMultiDrawElements
+#define glMultiDrawElements ::tiny_glfw_renderer::TraceMultiDrawElements
+#endif  // TGR_ENABLE_TRACE
+
+// ============================== GUI ===================================
+
+// Input recorded by the GLFW callbacks, consumed with Window::PollEvent()
+struct InputEvent {
+    enum Type { KEY, MOUSE_BUTTON, CURSOR, SCROLL } type;
+    int code;    // key or mouse button
+    int action;  // GLFW_PRESS, GLFW_RELEASE or GLFW_REPEAT
+    int mods;
+    double x, y;  // cursor position or scroll offset
+    double time;  // glfwGetTime() when received
+};
+
+// Framebuffer that stands in for the window's: 0, or the offscreen target
+// of a captured run (see Window). Bind it instead of 0.
+inline GLuint& DefaultFramebuffer() {
+    static GLuint framebuffer(0);
+    return framebuffer;
+}
+
+class Window {
+public:
+    Window(int width, int height, const char* title,
+           GLFWmonitor* monitor = NULL, GLFWwindow* share = NULL);
+    virtual ~Window();
+    int ShouldClose() const;
+    // Present() followed by ProcessEvents()
+    void SwapBuffers();
+    // Captures and swaps, on the thread owning the context. Off the main
+    // thread pass the size recorded on the main thread, which owns it.
+    void Present();
+    void Present(int width, int height);
+    // Polls input and moves the location, on the main thread
+    void ProcessEvents();
+    // Binds the context to the calling thread, or detaches it
+    void MakeContextCurrent();
+    void ReleaseContext();
+
+    // 0: uncapped, 1: vsync, -1: adaptive vsync (tearing late frames),
+    // which falls back to 1 when unsupported
+    void SetSwapInterval(int interval);
+    bool PollEvent(InputEvent& e);
+    bool IsKeyDown(int key) const;
+    // Called with the new size whenever the window is resized
+    void OnResize(const std::function<void(int, int)>& listener);
+    // glfwGetTime(), or frames / 60 while capturing
+    double GetTime() const;
+
+    GLfloat GetWidth() const;
+    GLfloat GetHeight() const;
+    GLfloat GetAspect() const;
+    GLfloat GetScale() const;
+    const GLfloat* GetLocation() const;
+    // Cursor position in window coordinates from the top left
+    const double* GetCursor() const;
+
+private:
+    GLFWwindow* const m_window;
+    GLfloat m_width;
+    GLfloat m_height;
+    GLfloat m_scale;
+    GLfloat m_location[2];
+    std::deque<InputEvent> m_events;
+    std::vector<std::function<void(int, int)>> m_resize_listeners;
+    std::vector<bool> m_keys;
+    bool m_dragging;
+    double m_cursor[2];
+    double m_last_time;
+    // capture mode, see README
+    std::string m_capture;
+    GLuint m_capture_fbo;  // rendered into instead of the hidden window
+    GLuint m_capture_rbo[2];  // color, depth/stencil
+    int m_capture_size[2];
+    int m_frames;
+    int m_frame;      // frames processed by the main thread
+    int m_presented;  // frames captured on the thread owning the context
+    double m_frame_start;
+    std::vector<double> m_frame_times;
+    void Push(const InputEvent& e);
+    void Capture();
+    void CaptureTarget(int width, int height);
+    static void Resize(GLFWwindow* const window, int width, int height);
+    static void Wheel(GLFWwindow* const window, double x, double y);
+    static void Key(GLFWwindow* const window, int key, int scancode,
+                    int action, int mods);
+    static void MouseButton(GLFWwindow* const window, int button, int action,
+                            int mods);
+    static void Cursor(GLFWwindow* const window, double x, double y);
+};
+
+// Fixed-timestep simulation clock. advance() returns how many steps of
+// step() seconds to simulate to catch up with `now`; alpha() is the
+// leftover fraction of a step for interpolating between the last two
+// simulated states when rendering.
+class FixedTimestep {
+public:
+    explicit FixedTimestep(double step = 1.0 / 60.0, int max_steps = 8)
+        : m_step(step), m_max_steps(max_steps), m_last(-1.0), m_acc(0.0) {}
+
+    int advance(double now) {
+        if (m_last < 0.0) m_last = now;
+        m_acc += now - m_last;
+        m_last = now;
+        int steps(static_cast<int>(m_acc / m_step));
+        if (steps > m_max_steps) {
+            // drop time instead of spiralling after a long stall
+            steps = m_max_steps;
+            m_acc = m_step * steps;
+        }
+        m_acc -= m_step * steps;
+        return steps;
+    }
+
+    double step() const { return m_step; }
+    GLfloat alpha() const { return static_cast<GLfloat>(m_acc / m_step); }
+
+private:
+    const double m_step;
+    const int m_max_steps;
+    double m_last;
+    double m_acc;
+};
+
+// Caps the frame rate when vsync is off (e.g. headless runs). fps <= 0
+// disables the limiter.
+class FrameLimiter {
+public:
+    explicit FrameLimiter(double fps = 0.0)
+        : m_period(fps > 0.0 ? 1.0 / fps : 0.0),
+          m_next(std::chrono::steady_clock::now()) {}
+
+    // Sleeps until the next frame slot.
+    void wait() {
+        if (m_period <= 0.0) return;
+        using Duration = std::chrono::steady_clock::duration;
+        m_next += std::chrono::duration_cast<Duration>(
+            std::chrono::duration<double>(m_period));
+        const auto now(std::chrono::steady_clock::now());
+        if (m_next < now) {
+            m_next = now;  // late: don't try to catch up
+        } else {
+            std::this_thread::sleep_until(m_next);
+        }
+    }
+
+private:
+    const double m_period;
+    std::chrono::steady_clock::time_point m_next;
+};
+
+// ============================== Math ===================================
+
+// Math functions usable in constant expressions. At run time they forward to
+// <cmath> when the compiler can tell the two contexts apart.
+#if defined(__has_builtin)
+#if __has_builtin(__builtin_is_constant_evaluated)
+#define TGR_CONSTANT_EVALUATED() __builtin_is_constant_evaluated()
+#endif
+#endif
+#ifndef TGR_CONSTANT_EVALUATED
+#define TGR_CONSTANT_EVALUATED() true
+#endif
+
+constexpr GLfloat Sqrt(GLfloat x) {
+    if (!TGR_CONSTANT_EVALUATED()) return std::sqrt(x);
+    if (!(x > 0.0f)) return 0.0f;
+
+    // Newton's method converges monotonically from above
+    double r(x > 1.0f ? x : 1.0);
+    for (int i = 0; i < 128; i++) {
+        const double n(0.5 * (r + x / r));
+        if (n >= r) break;
+        r = n;
+    }
+    return static_cast<GLfloat>(r);
+}
+
+constexpr GLfloat Sin(GLfloat x) {
+    if (!TGR_CONSTANT_EVALUATED()) return std::sin(x);
+
+    // reduce to [-pi, pi] and sum the Taylor series
+    const double pi(3.14159265358979323846), t(x / (2.0 * pi));
+    const double k(static_cast<double>(static_cast<long long>(
+        t < 0.0 ? t - 0.5 : t + 0.5)));
+    const double r(x - 2.0 * pi * k);
+    double term(r), sum(r);
+    for (int i = 1; i < 12; i++) {
+        term *= -r * r / ((2 * i) * (2 * i + 1));
+        sum += term;
+    }
+    return static_cast<GLfloat>(sum);
+}
+
+constexpr GLfloat Cos(GLfloat x) {
+    if (!TGR_CONSTANT_EVALUATED()) return std::cos(x);
+    return Sin(x + 1.57079632679489661923f);
+}
+
+constexpr GLfloat Tan(GLfloat x) {
+    if (!TGR_CONSTANT_EVALUATED()) return std::tan(x);
+    return Sin(x) / Cos(x);
+}
+
+// ============================= Matrix =================================
+class Matrix {
+public:
+    constexpr Matrix() : m_matrix{} {}
+    constexpr Matrix(const GLfloat* a);
+    constexpr const GLfloat* Data() const { return m_matrix; }
+    constexpr Matrix operator*(const Matrix& m) const;
+    void GetNormalMatrix(GLfloat* m) const;
+
+    static constexpr Matrix Identity();
+    static constexpr Matrix Translate(GLfloat x, GLfloat y, GLfloat z);
+    static constexpr Matrix Scale(GLfloat x, GLfloat y, GLfloat z);
+    static Matrix Rotate(GLfloat theta, GLfloat x, GLfloat y, GLfloat z);
+    static constexpr Matrix LookAt(
+        GLfloat ex, GLfloat ey, GLfloat ez,  // eye position
+        GLfloat gx, GLfloat gy, GLfloat gz,  // target position
+        GLfloat ux, GLfloat uy, GLfloat uz   // upper vector
+    );
+    static constexpr Matrix Orthogonal(GLfloat left, GLfloat right,
+                                       GLfloat bottom, GLfloat top,
+                                       GLfloat z_near, GLfloat z_far);
+    static constexpr Matrix Frustum(GLfloat left, GLfloat right,
+                                    GLfloat bottom, GLfloat top,
+                                    GLfloat z_near, GLfloat z_far);
+    static constexpr Matrix Perspective(GLfloat fovy, GLfloat aspect,
+                                        GLfloat z_near, GLfloat z_far);
+
+    // Translate(t) * r * Scale(s) in one pass, without the two
+    // intermediate products. Only the upper 3x3 block of `r` is used.
+    static constexpr Matrix TRS(GLfloat tx, GLfloat ty, GLfloat tz,
+                                const Matrix& r, GLfloat sx, GLfloat sy,
+                                GLfloat sz);
+
+private:
+    GLfloat m_matrix[16];
+    /*
+     | 0  4  8 12 |
+     | 1  5  9 13 |
+     | 2  6 10 14 |
+     | 3  7 11 15 |
+    */
+};
+
+constexpr Matrix::Matrix(const GLfloat* a) : m_matrix{} {
+    for (int i = 0; i < 16; i++) m_matrix[i] = a[i];
+}
+
+constexpr Matrix Matrix::operator*(const Matrix& m) const {
+    Matrix t;
+    for (int i = 0; i < 16; i++) {
+        const int j(i & 3), k(i & ~3);
+        t.m_matrix[i] = m_matrix[0 + j] * m.m_matrix[k + 0] +
+                        m_matrix[4 + j] * m.m_matrix[k + 1] +
+                        m_matrix[8 + j] * m.m_matrix[k + 2] +
+                        m_matrix[12 + j] * m.m_matrix[k + 3];
+    }
+    return t;
+}
+
+constexpr Matrix Matrix::Identity() {
+    Matrix t;
+    t.m_matrix[0] = t.m_matrix[5] = t.m_matrix[10] = t.m_matrix[15] = 1.0f;
+    return t;
+}
+
+constexpr Matrix Matrix::Translate(GLfloat x, GLfloat y, GLfloat z) {
+    Matrix t(Identity());
+    t.m_matrix[12] = x;
+    t.m_matrix[13] = y;
+    t.m_matrix[14] = z;
+    return t;
+}
+
+constexpr Matrix Matrix::Scale(GLfloat x, GLfloat y, GLfloat z) {
+    Matrix t(Identity());
+    t.m_matrix[0] = x;
+    t.m_matrix[5] = y;
+    t.m_matrix[10] = z;
+    return t;
+}
+
+constexpr Matrix Matrix::LookAt(GLfloat ex, GLfloat ey, GLfloat ez,
+                                GLfloat gx, GLfloat gy, GLfloat gz,
+                                GLfloat ux, GLfloat uy, GLfloat uz) {
+    // translation
+    const Matrix tv(Translate(-ex, -ey, -ez));
+
+    // t = e - g
+    const GLfloat tx(ex - gx);
+    const GLfloat ty(ey - gy);
+    const GLfloat tz(ez - gz);
+
+    // r = u x t
+    const GLfloat rx(uy * tz - uz * ty);
+    const GLfloat ry(uz * tx - ux * tz);
+    const GLfloat rz(ux * ty - uy * tx);
+
+    // s = t x r
+    const GLfloat sx(ty * rz - tz * ry);
+    const GLfloat sy(tz * rx - tx * rz);
+    const GLfloat sz(tx * ry - ty * rx);
+
+    const GLfloat s2(sx * sx + sy * sy + sz * sz);
+    if (s2 == 0.0f) return tv;
+
+    Matrix rv(Identity());  // rotation
+
+    const GLfloat r(Sqrt(rx * rx + ry * ry + rz * rz));
+    rv.m_matrix[0] = rx / r;
+    rv.m_matrix[4] = ry / r;
+    rv.m_matrix[8] = rz / r;
+
+    const GLfloat s(Sqrt(s2));
+    rv.m_matrix[1] = sx / s;
+    rv.m_matrix[5] = sy / s;
+    rv.m_matrix[9] = sz / s;
+
+    const GLfloat t(Sqrt(tx * tx + ty * ty + tz * tz));
+    rv.m_matrix[2] = tx / t;
+    rv.m_matrix[6] = ty / t;
+    rv.m_matrix[10] = tz / t;
+
+    return rv * tv;
+}
+
+constexpr Matrix Matrix::Orthogonal(GLfloat left, GLfloat right,
+                                    GLfloat bottom, GLfloat top,
+                                    GLfloat z_near, GLfloat z_far) {
+    Matrix t(Identity());
+    const GLfloat dx(right - left);
+    const GLfloat dy(top - bottom);
+    const GLfloat dz(z_far - z_near);
+
+    if (dx != 0.0f && dy != 0.0f && dz != 0.0f) {
+        t.m_matrix[0] = 2.0f / dx;
+        t.m_matrix[5] = 2.0f / dy;
+        t.m_matrix[10] = -2.0f / dz;
+        t.m_matrix[12] = -(right + left) / dx;
+        t.m_matrix[13] = -(top + bottom) / dy;
+        t.m_matrix[14] = -(z_far + z_near) / dz;
+    }
+
+    return t;
+}
+
+constexpr Matrix Matrix::Frustum(GLfloat left, GLfloat right, GLfloat bottom,
+                                 GLfloat top, GLfloat z_near, GLfloat z_far) {
+    Matrix t(Identity());
+    const GLfloat dx(right - left);
+    const GLfloat dy(top - bottom);
+    const GLfloat dz(z_far - z_near);
+
+    if (dx != 0.0f && dy != 0.0f && dz != 0.0f) {
+        t.m_matrix[0] = 2.0f + z_near / dx;
+        t.m_matrix[5] = 2.0f + z_near / dy;
+        t.m_matrix[8] = (right + left) / dx;
+        t.m_matrix[9] = (top + bottom) / dy;
+        t.m_matrix[10] = -(z_far + z_near) / dz;
+        t.m_matrix[11] = -1.0f;
+        t.m_matrix[14] = -2.0f * z_far * z_near / dz;
+        t.m_matrix[15] = 0.0f;
+    }
+
+    return t;
+}
+
+constexpr Matrix Matrix::Perspective(GLfloat fovy, GLfloat aspect,
+                                     GLfloat z_near, GLfloat z_far) {
+    Matrix t(Identity());
+    const GLfloat dz(z_far - z_near);
+
+    if (dz != 0.0f) {
+        const GLfloat f(1.0f / Tan(fovy * 0.5f));
+        t.m_matrix[0] = f / aspect;
+        t.m_matrix[5] = f;
+        t.m_matrix[10] = -(z_far + z_near) / dz;
+        t.m_matrix[11] = -1.0f;
+        t.m_matrix[14] = -2.0f * z_far * z_near / dz;
+        t.m_matrix[15] = 0.0f;
+    }
+
+    return t;
+}
+
+constexpr Matrix Matrix::TRS(GLfloat tx, GLfloat ty, GLfloat tz,
+                             const Matrix& r, GLfloat sx, GLfloat sy,
+                             GLfloat sz) {
+    Matrix t;
+    const GLfloat s[] = {sx, sy, sz};
+    for (int c = 0; c < 3; c++) {
+        for (int i = 0; i < 3; i++) {
+            t.m_matrix[4 * c + i] = r.m_matrix[4 * c + i] * s[c];
+        }
+    }
+    t.m_matrix[12] = tx;
+    t.m_matrix[13] = ty;
+    t.m_matrix[14] = tz;
+    t.m_matrix[15] = 1.0f;
+    return t;
+}
+
+// ============================= Vector =================================
+
+typedef std::array<GLfloat, 4> Vector;
+
+constexpr Vector operator*(const Matrix& m, const Vector& v) {
+    const GLfloat* const a(m.Data());
+    return {{a[0] * v[0] + a[4] * v[1] + a[8] * v[2] + a[12] * v[3],
+             a[1] * v[0] + a[5] * v[1] + a[9] * v[2] + a[13] * v[3],
+             a[2] * v[0] + a[6] * v[1] + a[10] * v[2] + a[14] * v[3],
+             a[3] * v[0] + a[7] * v[1] + a[11] * v[2] + a[15] * v[3]}};
+}
+
+// ============================ Quaternion ===============================
+
+struct Quaternion {
+    GLfloat x, y, z, w;
+
+    static constexpr Quaternion Identity() { return {0.0f, 0.0f, 0.0f, 1.0f}; }
+
+    // Rotation of theta radians around (ax, ay, az)
+    static constexpr Quaternion AxisAngle(GLfloat theta, GLfloat ax,
+                                          GLfloat ay, GLfloat az) {
+        const GLfloat d(Sqrt(ax * ax + ay * ay + az * az));
+        if (d <= 0.0f) return Identity();
+        const GLfloat s(Sin(theta * 0.5f) / d);
+        return {ax * s, ay * s, az * s, Cos(theta * 0.5f)};
+    }
+
+    // Hamilton product: applies q first, then *this
+    constexpr Quaternion operator*(const Quaternion& q) const {
+        return {w * q.x + x * q.w + y * q.z - z * q.y,
+                w * q.y - x * q.z + y * q.w + z * q.x,
+                w * q.z + x * q.y - y * q.x + z * q.w,
+                w * q.w - x * q.x - y * q.y - z * q.z};
+    }
+
+    constexpr Quaternion operator+(const Quaternion& q) const {
+        return {x + q.x, y + q.y, z + q.z, w + q.w};
+    }
+
+    constexpr Quaternion operator*(GLfloat s) const {
+        return {x * s, y * s, z * s, w * s};
+    }
+
+    constexpr Quaternion Conjugate() const { return {-x, -y, -z, w}; }
+
+    constexpr GLfloat Dot(const Quaternion& q) const {
+        return x * q.x + y * q.y + z * q.z + w * q.w;
+    }
+
+    constexpr Quaternion Normalize() const {
+        const GLfloat d(Sqrt(Dot(*this)));
+        return d > 0.0f ? *this * (1.0f / d) : Identity();
+    }
+
+    // Rotates the xyz part of v (unit quaternion)
+    constexpr Vector Rotate(const Vector& v) const {
+        // t = 2 q x v, v' = v + w t + q x t
+        const GLfloat tx(2.0f * (y * v[2] - z * v[1]));
+        const GLfloat ty(2.0f * (z * v[0] - x * v[2]));
+        const GLfloat tz(2.0f * (x * v[1] - y * v[0]));
+        return {{v[0] + w * tx + y * tz - z * ty,
+                 v[1] + w * ty + z * tx - x * tz,
+                 v[2] + w * tz + x * ty - y * tx, v[3]}};
+    }
+
+    // Rotation matrix of a unit quaternion
+    constexpr Matrix ToMatrix() const {
+        const GLfloat xx(x * x), yy(y * y), zz(z * z);
+        const GLfloat xy(x * y), xz(x * z), yz(y * z);
+        const GLfloat wx(w * x), wy(w * y), wz(w * z);
+        const GLfloat m[] = {
+            1.0f - 2.0f * (yy + zz), 2.0f * (xy + wz), 2.0f * (xz - wy), 0.0f,
+            2.0f * (xy - wz), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + wx), 0.0f,
+            2.0f * (xz + wy), 2.0f * (yz - wx), 1.0f - 2.0f * (xx + yy), 0.0f,
+            0.0f, 0.0f, 0.0f, 1.0f};
+        return Matrix(m);
+    }
+};
+
+// Normalized linear interpolation along the shorter arc
+constexpr Quaternion Nlerp(const Quaternion& a, const Quaternion& b,
+                           GLfloat t) {
+    const GLfloat s(a.Dot(b) < 0.0f ? -t : t);
+    return (a * (1.0f - t) + b * s).Normalize();
+}
+
+// Spherical linear interpolation along the shorter arc
+inline Quaternion Slerp(const Quaternion& a, const Quaternion& b, GLfloat t) {
+    GLfloat d(a.Dot(b));
+    const GLfloat sign(d < 0.0f ? -1.0f : 1.0f);
+    d *= sign;
+    if (d > 0.9995f) return Nlerp(a, b, t);  // nearly parallel
+    const GLfloat theta(std::acos(d));
+    const GLfloat r(1.0f / std::sin(theta));
+    return a * (std::sin((1.0f - t) * theta) * r) +
+           b * (sign * std::sin(t * theta) * r);
+}
+
+#if defined(__SSE2__) || defined(_M_X64)
+// Four lanes of acos(d) for d in [0, 1] (Abramowitz & Stegun 4.4.46,
+// |error| <= 2e-8) and sin(x) for x in [0, pi/2] (Taylor to x^11).
+inline __m128 AcosUnit4(__m128 d) {
+    static const float c[] = {-0.0012624911f, 0.0066700901f, -0.0170881256f,
+                              0.0308918810f,  -0.0501743046f, 0.0889789874f,
+                              -0.2145988016f, 1.5707963050f};
+    __m128 p(_mm_set1_ps(c[0]));
+    for (int i = 1; i < 8; i++) {
+        p = _mm_add_ps(_mm_mul_ps(p, d), _mm_set1_ps(c[i]));
+    }
+    return _mm_mul_ps(p, _mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.0f), d)));
+}
+
+inline __m128 SinHalfPi4(__m128 x) {
+    const __m128 x2(_mm_mul_ps(x, x));
+    __m128 p(_mm_set1_ps(-1.0f / 39916800.0f));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(1.0f / 362880.0f));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.0f / 5040.0f));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(1.0f / 120.0f));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-1.0f / 6.0f));
+    p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(1.0f));
+    return _mm_mul_ps(p, x);
+}
+#endif
+
+// out[i] = Slerp(a[i], b[i], t[i]) (or Nlerp when `normalized_lerp` is set)
+// for n rotations, four at a time with SSE2.
+inline void InterpolateBatch(const Quaternion* a, const Quaternion* b,
+                             const GLfloat* t, Quaternion* out, std::size_t n,
+                             bool normalized_lerp = false) {
+    std::size_t i(0);
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128 one(_mm_set1_ps(1.0f)), zero(_mm_setzero_ps());
+    const __m128 sign_bit(_mm_set1_ps(-0.0f));
+    for (; i + 4 <= n; i += 4) {
+        // AoS -> SoA
+        __m128 ax(_mm_loadu_ps(&a[i].x)), ay(_mm_loadu_ps(&a[i + 1].x));
+        __m128 az(_mm_loadu_ps(&a[i + 2].x)), aw(_mm_loadu_ps(&a[i + 3].x));
+        _MM_TRANSPOSE4_PS(ax, ay, az, aw);
+        __m128 bx(_mm_loadu_ps(&b[i].x)), by(_mm_loadu_ps(&b[i + 1].x));
+        __m128 bz(_mm_loadu_ps(&b[i + 2].x)), bw(_mm_loadu_ps(&b[i + 3].x));
+        _MM_TRANSPOSE4_PS(bx, by, bz, bw);
+        const __m128 tt(_mm_loadu_ps(t + i));
+
+        // shorter arc: flip b where dot < 0
+        __m128 d(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)),
+                       _mm_add_ps(_mm_mul_ps(az, bz), _mm_mul_ps(aw, bw))));
+        const __m128 flip(_mm_and_ps(d, sign_bit));
+        d = _mm_xor_ps(d, flip);
+
+        __m128 wa(_mm_sub_ps(one, tt)), wb(tt);
+        if (!normalized_lerp) {
+            const __m128 theta(AcosUnit4(_mm_min_ps(d, one)));
+            const __m128 s(SinHalfPi4(theta));
+            const __m128 r(_mm_div_ps(one, _mm_max_ps(s, _mm_set1_ps(1e-6f))));
+            const __m128 sa(_mm_mul_ps(SinHalfPi4(_mm_mul_ps(wa, theta)), r));
+            const __m128 sb(_mm_mul_ps(SinHalfPi4(_mm_mul_ps(wb, theta)), r));
+            // fall back to lerp weights where the arc is nearly flat
+            const __m128 flat(_mm_cmpgt_ps(d, _mm_set1_ps(0.9995f)));
+            wa = _mm_or_ps(_mm_and_ps(flat, wa), _mm_andnot_ps(flat, sa));
+            wb = _mm_or_ps(_mm_and_ps(flat, wb), _mm_andnot_ps(flat, sb));
+        }
+        wb = _mm_xor_ps(wb, flip);
+
+        __m128 x(_mm_add_ps(_mm_mul_ps(ax, wa), _mm_mul_ps(bx, wb)));
+        __m128 y(_mm_add_ps(_mm_mul_ps(ay, wa), _mm_mul_ps(by, wb)));
+        __m128 z(_mm_add_ps(_mm_mul_ps(az, wa), _mm_mul_ps(bz, wb)));
+        __m128 w(_mm_add_ps(_mm_mul_ps(aw, wa), _mm_mul_ps(bw, wb)));
+
+        // renormalize (exact for nlerp, removes drift for slerp)
+        const __m128 len2(
+            _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)),
+                       _mm_add_ps(_mm_mul_ps(z, z), _mm_mul_ps(w, w))));
+        const __m128 inv(_mm_div_ps(one, _mm_sqrt_ps(_mm_max_ps(len2, zero))));
+        x = _mm_mul_ps(x, inv);
+        y = _mm_mul_ps(y, inv);
+        z = _mm_mul_ps(z, inv);
+        w = _mm_mul_ps(w, inv);
+
+        _MM_TRANSPOSE4_PS(x, y, z, w);
+        _mm_storeu_ps(&out[i].x, x);
+        _mm_storeu_ps(&out[i + 1].x, y);
+        _mm_storeu_ps(&out[i + 2].x, z);
+        _mm_storeu_ps(&out[i + 3].x, w);
+    }
+#endif
+    for (; i < n; i++) {
+        out[i] = normalized_lerp ? Nlerp(a[i], b[i], t[i])
+                                 : Slerp(a[i], b[i], t[i]);
+    }
+}
+
+// Rigid transform (rotation followed by translation) as a dual quaternion
+// real + e dual. Composition costs two quaternion products per part
+// instead of a 4x4 matrix product and blends without shearing.
+struct DualQuaternion {
+    Quaternion real;
+    Quaternion dual;
+
+    static constexpr DualQuaternion Identity() {
+        return {Quaternion::Identity(), {0.0f, 0.0f, 0.0f, 0.0f}};
+    }
+
+    static constexpr DualQuaternion RotationTranslation(const Quaternion& r,
+                                                        GLfloat tx,
+                                                        GLfloat ty,
+                                                        GLfloat tz) {
+        return {r, Quaternion{tx, ty, tz, 0.0f} * r * 0.5f};
+    }
+
+    // Applies d first, then *this
+    constexpr DualQuaternion operator*(const DualQuaternion& d) const {
+        return {real * d.real, real * d.dual + dual * d.real};
+    }
+
+    constexpr DualQuaternion Normalize() const {
+        const GLfloat n(Sqrt(real.Dot(real)));
+        if (n <= 0.0f) return Identity();
+        const Quaternion r(real * (1.0f / n)), u(dual * (1.0f / n));
+        return {r, u + r * -r.Dot(u)};
+    }
+
+    constexpr Quaternion Rotation() const { return real; }
+
+    constexpr Vector Translation() const {
+        const Quaternion t(dual * real.Conjugate() * 2.0f);
+        return {{t.x, t.y, t.z, 0.0f}};
+    }
+
+    constexpr Vector TransformPoint(const Vector& v) const {
+        const Vector r(real.Rotate(v)), t(Translation());
+        return {{r[0] + t[0], r[1] + t[1], r[2] + t[2], v[3]}};
+    }
+
+    constexpr Matrix ToMatrix() const {
+        const Vector t(Translation());
+        return Matrix::TRS(t[0], t[1], t[2], real.ToMatrix(), 1.0f, 1.0f,
+                           1.0f);
+    }
+};
+
+// Dual quaternion linear blending of n transforms (normalized)
+inline DualQuaternion Blend(const DualQuaternion* d, const GLfloat* w,
+                            std::size_t n) {
+    DualQuaternion b = {{0.0f, 0.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 0.0f, 0.0f}};
+    for (std::size_t i = 0; i < n; i++) {
+        const GLfloat s(d[0].real.Dot(d[i].real) < 0.0f ? -w[i] : w[i]);
+        b.real = b.real + d[i].real * s;
+        b.dual = b.dual + d[i].dual * s;
+    }
+    return b.Normalize();
+}
+
+// ============================== Memory ===================================
+
+// Subsystems memory is accounted to.
+enum class MemoryTag : std::uint8_t {
+    GEOMETRY,   // static vertex and index buffers
+    STREAMING,  // dynamic geometry, batches and point cloud caches
+    UNIFORM,    // uniform and texture buffers
+    TEXTURE,
+    TARGET,  // render targets and readback
+    MESH,    // CPU mesh data
+    OTHER,
+    COUNT
+};
+
+enum class MemoryKind : std::uint8_t { CPU, GPU, COUNT };
+
+inline const char* MemoryTagName(MemoryTag tag) {
+    static const char* const names[] = {"geometry", "streaming", "uniform",
+                                        "texture",  "target",    "mesh",
+                                        "other"};
+    return tag < MemoryTag::COUNT ? names[static_cast<int>(tag)] : "?";
+}
+
+// Counters of one tag and kind.
+struct MemoryUsage {
+    std::uint64_t live;   // bytes
+    std::uint64_t peak;   // since the tracker was created
+    std::uint64_t count;  // live allocations
+    std::uint64_t frame_allocations;  // since the last frame()
+    std::uint64_t frame_bytes;
+};
+
+// Called with the bytes over budget; should free at least that much.
+using MemoryEvict =
+    std::function<void(MemoryTag tag, MemoryKind kind, std::uint64_t over)>;
+
+// Live and peak bytes per subsystem, fed by MemoryRecord and
+// TrackingAllocator from any thread. An allocation taking a tag over its
+// budget calls the eviction callback on the allocating thread, which is the
+// GL thread for GPU memory.
+class MemoryTracker {
+public:
+    MemoryTracker() {
+        for (auto& k : m_counters) {
+            for (Counters& c : k) {
+                c.live = c.peak = c.count = 0;
+                c.frame_allocations = c.frame_bytes = 0;
+                c.budget = 0;
+            }
+        }
+    }
+
+    virtual ~MemoryTracker() {}
+
+    void allocate(MemoryTag tag, MemoryKind kind, std::uint64_t bytes) {
+        Counters& c(at(tag, kind));
+        const std::uint64_t live(c.live += bytes);
+        for (std::uint64_t peak(c.peak);
+             live > peak && !c.peak.compare_exchange_weak(peak, live);) {
+        }
+        c.count++;
+        c.frame_allocations++;
+        c.frame_bytes += bytes;
+        const std::uint64_t budget(c.budget);
+        if (budget == 0 || live <= budget) return;
+        MemoryEvict evict;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            evict = m_evict[static_cast<int>(kind)][static_cast<int>(tag)];
+        }
+        if (evict) evict(tag, kind, live - budget);
+    }
+
+    void release(MemoryTag tag, MemoryKind kind, std::uint64_t bytes,
+                 std::uint64_t count = 1) {
+        Counters& c(at(tag, kind));
+        c.live -= bytes;
+        c.count -= count;
+    }
+
+    // 0 removes the budget
+    void setBudget(MemoryTag tag, MemoryKind kind, std::uint64_t bytes,
+                   const MemoryEvict& evict = nullptr) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_evict[static_cast<int>(kind)][static_cast<int>(tag)] = evict;
+        at(tag, kind).budget = bytes;
+    }
+
+    std::uint64_t budget(MemoryTag tag, MemoryKind kind) const {
+        return at(tag, kind).budget;
+    }
+
+    bool overBudget(MemoryTag tag, MemoryKind kind) const {
+        const Counters& c(at(tag, kind));
+        const std::uint64_t budget(c.budget);
+        return budget != 0 && c.live > budget;
+    }
+
+    MemoryUsage usage(MemoryTag tag, MemoryKind kind) const {
+        const Counters& c(at(tag, kind));
+        return {c.live, c.peak, c.count, c.frame_allocations, c.frame_bytes};
+    }
+
+    // Sum over the tags; the peak is the sum of the peaks
+    MemoryUsage total(MemoryKind kind) const {
+        MemoryUsage sum = {0, 0, 0, 0, 0};
+        for (int t = 0; t < static_cast<int>(MemoryTag::COUNT); t++) {
+            const MemoryUsage u(usage(static_cast<MemoryTag>(t), kind));
+            sum.live += u.live;
+            sum.peak += u.peak;
+            sum.count += u.count;
+            sum.frame_allocations += u.frame_allocations;
+            sum.frame_bytes += u.frame_bytes;
+        }
+        return sum;
+    }
+
+    // Starts counting the allocations of a new frame.
+    void frame() {
+        for (auto& k : m_counters) {
+            for (Counters& c : k) {
+                c.frame_allocations = 0;
+                c.frame_bytes = 0;
+            }
+        }
+    }
+
+    // One line per tag and kind in use, sizes in KiB
+    void report(std::ostream& out) const {
+        for (int k = 0; k < static_cast<int>(MemoryKind::COUNT); k++) {
+            for (int t = 0; t < static_cast<int>(MemoryTag::COUNT); t++) {
+                const MemoryTag tag(static_cast<MemoryTag>(t));
+                const MemoryKind kind(static_cast<MemoryKind>(k));
+                const MemoryUsage u(usage(tag, kind));
+                if (u.peak == 0) continue;
+                out << (kind == MemoryKind::CPU ? "cpu " : "gpu ")
+                    << MemoryTagName(tag) << ": " << (u.live >> 10)
+                    << " KiB live, " << (u.peak >> 10) << " KiB peak, "
+                    << u.count << " allocations, " << u.frame_allocations
+                    << " this frame";
+                if (budget(tag, kind) != 0) {
+                    out << ", budget " << (budget(tag, kind) >> 10) << " KiB";
+                }
+                out << "\n";
+            }
+        }
+    }
+
+private:
+    MemoryTracker(const MemoryTracker& o);
+    MemoryTracker& operator=(const MemoryTracker& o);
+
+    struct Counters {
+        std::atomic<std::uint64_t> live;
+        std::atomic<std::uint64_t> peak;
+        std::atomic<std::uint64_t> count;
+        std::atomic<std::uint64_t> frame_allocations;
+        std::atomic<std::uint64_t> frame_bytes;
+        std::atomic<std::uint64_t> budget;
+    };
+
+    Counters& at(MemoryTag tag, MemoryKind kind) {
+        return m_counters[static_cast<int>(kind)][static_cast<int>(tag)];
+    }
+    const Counters& at(MemoryTag tag, MemoryKind kind) const {
+        return m_counters[static_cast<int>(kind)][static_cast<int>(tag)];
+    }
+
+    Counters m_counters[static_cast<int>(MemoryKind::COUNT)]
+                       [static_cast<int>(MemoryTag::COUNT)];
+    MemoryEvict m_evict[static_cast<int>(MemoryKind::COUNT)]
+                       [static_cast<int>(MemoryTag::COUNT)];
+    std::mutex m_mutex;  // guards m_evict
+};
+
+// Tracker the library's allocations are accounted to.
+inline MemoryTracker& DefaultMemoryTracker() {
+    static MemoryTracker tracker;
+    return tracker;
+}
+
+// Bytes held by one object, accounted while it lives. Each add() counts as
+// an allocation.
+class MemoryRecord {
+public:
+    explicit MemoryRecord(MemoryTag tag, MemoryKind kind = MemoryKind::GPU)
+        : m_tag(tag), m_kind(kind), m_bytes(0), m_count(0) {}
+
+    virtual ~MemoryRecord() { clear(); }
+
+    void add(std::uint64_t bytes) {
+        m_bytes += bytes;
+        m_count++;
+        DefaultMemoryTracker().allocate(m_tag, m_kind, bytes);
+    }
+
+    void clear() {
+        if (m_count == 0) return;
+        DefaultMemoryTracker().release(m_tag, m_kind, m_bytes, m_count);
+        m_bytes = m_count = 0;
+    }
+
+    // clear() and add(), for storage that is respecified
+    void set(std::uint64_t bytes) {
+        clear();
+        if (bytes > 0) add(bytes);
+    }
+
+    std::uint64_t bytes() const { return m_bytes; }
+
+private:
+    MemoryRecord(const MemoryRecord& o);
+    MemoryRecord& operator=(const MemoryRecord& o);
+
+    const MemoryTag m_tag;
+    const MemoryKind m_kind;
+    std::uint64_t m_bytes;
+    std::uint64_t m_count;
+};
+
+// Source of the CPU memory handed out by TrackingAllocator. Like operator
+// new, allocate() must not return nullptr.
+class Allocator {
+public:
+    virtual ~Allocator() {}
+    virtual void* allocate(std::size_t size, std::size_t alignment) = 0;
+    virtual void deallocate(void* p, std::size_t size,
+                            std::size_t alignment) = 0;
+};
+
+class HeapAllocator : public Allocator {
+public:
+    void* allocate(std::size_t size, std::size_t) override {
+        return ::operator new(size);
+    }
+    void deallocate(void* p, std::size_t, std::size_t) override {
+        ::operator delete(p);
+    }
+};
+
+inline Allocator& DefaultAllocator() {
+    static HeapAllocator heap;
+    return heap;
+}
+
+// Allocator used by TrackingAllocators created from now on; containers keep
+// freeing through the one they were created with.
+inline Allocator*& CurrentAllocator() {
+    static Allocator* allocator(&DefaultAllocator());
+    return allocator;
+}
+
+// nullptr restores DefaultAllocator()
+inline void SetAllocator(Allocator* allocator) {
+    CurrentAllocator() = allocator != nullptr ? allocator : &DefaultAllocator();
+}
+
+// Standard allocator accounting to a tag on DefaultMemoryTracker().
+template <typename T>
+class TrackingAllocator {
+public:
+    using value_type = T;
+
+    explicit TrackingAllocator(MemoryTag tag = MemoryTag::OTHER)
+        : m_tag(tag), m_source(CurrentAllocator()) {}
+
+    template <typename U>
+    TrackingAllocator(const TrackingAllocator<U>& o)
+        : m_tag(o.tag()), m_source(o.source()) {}
+
+    T* allocate(std::size_t n) {
+        void* const p(m_source->allocate(sizeof(T) * n, alignof(T)));
+        DefaultMemoryTracker().allocate(m_tag, MemoryKind::CPU, sizeof(T) * n);
+        return static_cast<T*>(p);
+    }
+
+    void deallocate(T* p, std::size_t n) {
+        m_source->deallocate(p, sizeof(T) * n, alignof(T));
+        DefaultMemoryTracker().release(m_tag, MemoryKind::CPU, sizeof(T) * n);
+    }
+
+    MemoryTag tag() const { return m_tag; }
+    Allocator* source() const { return m_source; }
+
+private:
+    MemoryTag m_tag;
+    Allocator* m_source;
+};
+
+template <typename T, typename U>
+bool operator==(const TrackingAllocator<T>& a, const TrackingAllocator<U>& b) {
+    return a.tag() == b.tag() && a.source() == b.source();
+}
+
+template <typename T, typename U>
+bool operator!=(const TrackingAllocator<T>& a, const TrackingAllocator<U>& b) {
+    return !(a == b);
+}
+
+template <typename T>
+using TrackedVector = std::vector<T, TrackingAllocator<T>>;
+
+// ============================ Geometry ================================
+
+template <int N>
+struct Vertex {
+    GLfloat position[N];
+    GLfloat normal[N];
+};
+
+using Vertex2D = Vertex<2>;
+using Vertex3D = Vertex<3>;
+
+template <int N>
+class Object {
+public:
+    Object(GLint size, GLsizei vtx_cnt, const Vertex<N>* vtx,
+           GLsizei idx_cnt = 0, const GLuint* idx = nullptr)
+        : m_memory(MemoryTag::GEOMETRY) {
+        // vertex array object
+        glGenVertexArrays(1, &m_vao);
+        glBindVertexArray(m_vao);
+
+        // vertex buffer object
+        glGenBuffers(1, &m_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        glBufferData(GL_ARRAY_BUFFER, vtx_cnt * sizeof(Vertex<N>), vtx,
+                     GL_STATIC_DRAW);
+
+        glVertexAttribPointer(0, size, GL_FLOAT, GL_FALSE, sizeof(Vertex<N>),
+                              0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex<N>),
+                              static_cast<char*>(0) + sizeof vtx->position);
+        glEnableVertexAttribArray(1);
+
+        // index buffer object
+        glGenBuffers(1, &m_ibo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx_cnt * sizeof(GLuint), idx,
+                     GL_STATIC_DRAW);
+        m_memory.add(vtx_cnt * sizeof(Vertex<N>));
+        m_memory.add(idx_cnt * sizeof(GLuint));
+    }
+
+    virtual ~Object() {
+        glDeleteVertexArrays(1, &m_vao);
+        glDeleteBuffers(1, &m_vbo);
+        glDeleteBuffers(1, &m_ibo);
+    }
+
+    void bind() const { glBindVertexArray(m_vao); }
+
+    // Overwrites part of the vertex (GL_ARRAY_BUFFER) or index
+    // (GL_ELEMENT_ARRAY_BUFFER) storage allocated by the constructor.
+    void upload(GLenum target, GLintptr offset, GLsizeiptr size,
+                const void* data) const {
+        glBindBuffer(GL_COPY_WRITE_BUFFER,
+                     target == GL_ELEMENT_ARRAY_BUFFER ? m_ibo : m_vbo);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, offset, size, data);
+    }
+
+private:
+    Object(const Object& o);
+    Object& operator=(const Object& o);
+
+    GLuint m_vao;
+    GLuint m_vbo;
+    GLuint m_ibo;
+    MemoryRecord m_memory;
+};
+
+using Object2D = Object<2>;
+using Object3D = Object<3>;
+
+template <int N>
+class Geometry {
+public:
+    Geometry(GLint size, GLsizei vtx_cnt, const Vertex<N>* vtx,
+             GLsizei idx_cnt = 0, const GLuint* idx = nullptr)
+        : m_obj(new Object<N>(size, vtx_cnt, vtx, idx_cnt, idx)),
+          m_vtx_cnt(vtx_cnt) {}
+
+    void draw(GLenum mode = GL_LINE_LOOP) const {
+        m_obj->bind();
+        execute(mode);
+    }
+
+    virtual void execute(GLenum mode = GL_LINE_LOOP) const {
+        glDrawArrays(mode, 0, m_vtx_cnt);
+    }
+
+    const Object<N>& object() const { return *m_obj; }
+
+private:
+    std::shared_ptr<const Object<N>> m_obj;
+    const GLsizei m_vtx_cnt;
+};
+
+using Geometry2D = Geometry<2>;
+using Geometry3D = Geometry<3>;
+
+template <int N>
+class GeometryIndex : public Geometry<N> {
+public:
+    GeometryIndex(GLint size, GLsizei vtx_cnt, const Vertex<N>* vtx,
+                  GLsizei idx_cnt = 0, const GLuint* idx = nullptr)
+        : Geometry<N>(size, vtx_cnt, vtx, idx_cnt, idx), m_idx_cnt(idx_cnt) {}
+
+    virtual void execute(GLenum mode = GL_LINES) const {
+        glDrawElements(mode, m_idx_cnt, GL_UNSIGNED_INT, 0);
+    }
+
+protected:
+    const GLsizei m_idx_cnt;
+};
+
+using GeometryIndex2D = GeometryIndex<2>;
+using GeometryIndex3D = GeometryIndex<3>;
+
+extern template class Object<2>;
+extern template class Object<3>;
+extern template class Geometry<2>;
+extern template class Geometry<3>;
+extern template class GeometryIndex<2>;
+extern template class GeometryIndex<3>;
+
+// ======================== Dynamic Geometry ============================
+
+// Streams per-frame vertex/index data through a ring of `frames` regions
+// sharing one VBO/IBO. Each region is guarded by a fence, so the region being
+// written was last drawn `frames - 1` frames ago and the wait almost never
+// blocks. When the data outgrows the ring, the buffers are orphaned and
+// reallocated instead of synchronizing with the GPU.
+template <int N>
+class DynamicGeometry {
+public:
+    DynamicGeometry(GLint size, GLsizei max_vtx, GLsizei max_idx = 0,
+                    int frames = 3)
+        : m_size(size),
+          m_frames(std::max(frames, 1)),
+          m_region(0),
+          m_max_vtx(std::max(max_vtx, 1)),
+          m_max_idx(max_idx),
+          m_vtx_cnt(0),
+          m_idx_cnt(0),
+          m_fences(m_frames, nullptr),
+          m_memory(MemoryTag::STREAMING) {
+        glGenVertexArrays(1, &m_vao);
+        glGenBuffers(1, &m_vbo);
+        glGenBuffers(1, &m_ibo);
+        allocate();
+    }
+
+    virtual ~DynamicGeometry() {
+        for (GLsync& f : m_fences) {
+            if (f != nullptr) glDeleteSync(f);
+        }
+        glDeleteVertexArrays(1, &m_vao);
+        glDeleteBuffers(1, &m_vbo);
+        glDeleteBuffers(1, &m_ibo);
+    }
+
+    // Moves to the next region, waits until the GPU has released it and
+    // makes room for `vtx_cnt` vertices and `idx_cnt` indices. Must be called
+    // once per frame before writing.
+    void begin(GLsizei vtx_cnt, GLsizei idx_cnt = 0) {
+        m_region = (m_region + 1) % m_frames;
+        GLsync& f(m_fences[m_region]);
+        if (f != nullptr) {
+            GLenum r(glClientWaitSync(f, 0, 0));
+            while (r == GL_TIMEOUT_EXPIRED) {
+                r = glClientWaitSync(f, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            }
+            glDeleteSync(f);
+            f = nullptr;
+        }
+        reserve(vtx_cnt, idx_cnt);
+        m_vtx_cnt = vtx_cnt;
+        m_idx_cnt = idx_cnt;
+    }
+
+    // Maps the current region for writing. Returns nullptr on failure.
+    // Indices go through GL_COPY_WRITE_BUFFER so that the element array
+    // binding of whatever VAO is bound stays untouched.
+    Vertex<N>* mapVertices() const {
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        return static_cast<Vertex<N>*>(glMapBufferRange(
+            GL_ARRAY_BUFFER, m_region * m_max_vtx * sizeof(Vertex<N>),
+            m_vtx_cnt * sizeof(Vertex<N>), MapFlags()));
+    }
+
+    GLuint* mapIndices() const {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_ibo);
+        return static_cast<GLuint*>(glMapBufferRange(
+            GL_COPY_WRITE_BUFFER, m_region * m_max_idx * sizeof(GLuint),
+            m_idx_cnt * sizeof(GLuint), MapFlags()));
+    }
+
+    void unmapVertices() const {
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        glUnmapBuffer(GL_ARRAY_BUFFER);
+    }
+
+    void unmapIndices() const {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, m_ibo);
+        glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+    }
+
+    // begin() + copy of the given arrays into the current region
+    void update(GLsizei vtx_cnt, const Vertex<N>* vtx, GLsizei idx_cnt = 0,
+                const GLuint* idx = nullptr) {
+        begin(vtx_cnt, idx_cnt);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        glBufferSubData(GL_ARRAY_BUFFER,
+                        m_region * m_max_vtx * sizeof(Vertex<N>),
+                        vtx_cnt * sizeof(Vertex<N>), vtx);
+        if (idx_cnt > 0) {
+            glBindBuffer(GL_COPY_WRITE_BUFFER, m_ibo);
+            glBufferSubData(GL_COPY_WRITE_BUFFER,
+                            m_region * m_max_idx * sizeof(GLuint),
+                            idx_cnt * sizeof(GLuint), idx);
+        }
+    }
+
+    // Draws the current region and fences it. Indexed draws are used when
+    // indices were written this frame.
+    void draw(GLenum mode = GL_TRIANGLES) {
+        glBindVertexArray(m_vao);
+        const GLint base(m_region * m_max_vtx);
+        if (m_idx_cnt > 0) {
+            glDrawElementsBaseVertex(
+                mode, m_idx_cnt, GL_UNSIGNED_INT,
+                static_cast<char*>(0) + m_region * m_max_idx * sizeof(GLuint),
+                base);
+        } else {
+            glDrawArrays(mode, base, m_vtx_cnt);
+        }
+        GLsync& f(m_fences[m_region]);
+        if (f != nullptr) glDeleteSync(f);
+        f = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+
+    GLsizei vertexCount() const { return m_vtx_cnt; }
+    GLsizei indexCount() const { return m_idx_cnt; }
+
+private:
+    DynamicGeometry(const DynamicGeometry& o);
+    DynamicGeometry& operator=(const DynamicGeometry& o);
+
+    static GLbitfield MapFlags() {
+        return GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT |
+               GL_MAP_UNSYNCHRONIZED_BIT;
+    }
+
+    // Orphans both buffers and grows the ring when a region is too small.
+    void reserve(GLsizei vtx_cnt, GLsizei idx_cnt) {
+        if (vtx_cnt <= m_max_vtx && idx_cnt <= m_max_idx) return;
+        m_max_vtx = std::max(m_max_vtx, vtx_cnt + vtx_cnt / 2);
+        m_max_idx = std::max(m_max_idx, idx_cnt + idx_cnt / 2);
+        for (GLsync& f : m_fences) {
+            if (f != nullptr) glDeleteSync(f);
+            f = nullptr;
+        }
+        allocate();
+    }
+
+    void allocate() {
+        glBindVertexArray(m_vao);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        glBufferData(GL_ARRAY_BUFFER,
+                     m_frames * m_max_vtx * sizeof(Vertex<N>), NULL,
+                     GL_STREAM_DRAW);
+        glVertexAttribPointer(0, m_size, GL_FLOAT, GL_FALSE, sizeof(Vertex<N>),
+                              0);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex<N>),
+                              static_cast<char*>(0) + sizeof(GLfloat) * N);
+        glEnableVertexAttribArray(1);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+                     m_frames * m_max_idx * sizeof(GLuint), NULL,
+                     GL_STREAM_DRAW);
+        m_memory.clear();
+        m_memory.add(m_frames * m_max_vtx * sizeof(Vertex<N>));
+        m_memory.add(m_frames * m_max_idx * sizeof(GLuint));
+    }
+
+    GLuint m_vao;
+    GLuint m_vbo;
+    GLuint m_ibo;
+    const GLint m_size;
+    const int m_frames;
+    int m_region;
+    GLsizei m_max_vtx;
+    GLsizei m_max_idx;
+    GLsizei m_vtx_cnt;
+    GLsizei m_idx_cnt;
+    std::vector<GLsync> m_fences;
+    MemoryRecord m_memory;
+};
+
+using DynamicGeometry2D = DynamicGeometry<2>;
+using DynamicGeometry3D = DynamicGeometry<3>;
+
+extern template class DynamicGeometry<2>;
+extern template class DynamicGeometry<3>;
+
+// =============================== Thread ==================================
+
+// Fixed set of worker threads executing data-parallel loops. The calling
+// thread takes part in every loop, so a pool of `threads` uses `threads - 1`
+// workers. parallelFor() is not reentrant.
+class ThreadPool {
+public:
+    explicit ThreadPool(
+        unsigned int threads = std::thread::hardware_concurrency())
+        : m_task(nullptr),
+          m_count(0),
+          m_next(0),
+          m_generation(0),
+          m_finished(0),
+          m_quit(false) {
+        for (unsigned int i = 1; i < threads; i++) {
+            m_workers.emplace_back(&ThreadPool::Work, this);
+        }
+    }
+
+    virtual ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_start.notify_all();
+        for (std::thread& t : m_workers) t.join();
+    }
+
+    // Calls fn(i) for every i in [0, count) and returns when all are done.
+    void parallelFor(int count, const std::function<void(int)>& fn) {
+        if (count <= 0) return;
+        if (m_workers.empty() || count == 1) {
+            for (int i = 0; i < count; i++) fn(i);
+            return;
+        }
+
+        std::lock_guard<std::mutex> call(m_call);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_task = &fn;
+        m_count = count;
+        m_next = 0;
+        m_finished = 0;
+        m_generation++;
+        lock.unlock();
+        m_start.notify_all();
+
+        Run();
+
+        lock.lock();
+        m_done.wait(lock, [this] { return m_finished == m_workers.size(); });
+        m_task = nullptr;
+    }
+
+    unsigned int size() const {
+        return static_cast<unsigned int>(m_workers.size()) + 1;
+    }
+
+private:
+    ThreadPool(const ThreadPool& o);
+    ThreadPool& operator=(const ThreadPool& o);
+
+    void Run() {
+        for (int i = m_next++; i < m_count; i = m_next++) (*m_task)(i);
+    }
+
+    void Work() {
+        std::uint64_t seen(0);
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_start.wait(lock, [&] {
+                    return m_quit || m_generation != seen;
+                });
+                if (m_quit) return;
+                seen = m_generation;
+            }
+            Run();
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_finished++;
+            }
+            m_done.notify_one();
+        }
+    }
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_call;  // serializes parallelFor() callers
+    std::mutex m_mutex;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    const std::function<void(int)>* m_task;
+    int m_count;
+    std::atomic<int> m_next;
+    std::uint64_t m_generation;
+    std::size_t m_finished;
+    bool m_quit;
+};
+
+// Pool shared by the subsystems that parallelize work by default.
+inline ThreadPool& DefaultThreadPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+// ============================ Render Thread ==============================
+
+// Bump allocator for the payloads of one frame. Memory is reserved once;
+// reset() makes all of it available again without freeing.
+class FrameArena {
+public:
+    explicit FrameArena(std::size_t capacity)
+        : m_memory(new std::max_align_t[(capacity + sizeof(std::max_align_t) -
+                                         1) /
+                                        sizeof(std::max_align_t)]),
+          m_capacity(capacity),
+          m_used(0),
+          m_peak(0) {}
+
+    virtual ~FrameArena() {}
+
+    // nullptr when the arena is full
+    void* allocate(std::size_t size,
+                   std::size_t alignment = alignof(std::max_align_t)) {
+        const std::uintptr_t base(
+            reinterpret_cast<std::uintptr_t>(m_memory.get()));
+        const std::size_t offset(
+            ((base + m_used + alignment - 1) & ~(alignment - 1)) - base);
+        if (offset + size > m_capacity) return nullptr;
+        m_used = offset + size;
+        m_peak = std::max(m_peak, m_used);
+        return reinterpret_cast<unsigned char*>(m_memory.get()) + offset;
+    }
+
+    template <typename T>
+    T* copy(const T* data, std::size_t count) {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "only trivially copyable data is copied");
+        T* const p(static_cast<T*>(allocate(sizeof(T) * count, alignof(T))));
+        if (p != nullptr) std::memcpy(p, data, sizeof(T) * count);
+        return p;
+    }
+
+    void reset() { m_used = 0; }
+    std::size_t used() const { return m_used; }
+    std::size_t peak() const { return m_peak; }
+    std::size_t capacity() const { return m_capacity; }
+
+private:
+    FrameArena(const FrameArena& o);
+    FrameArena& operator=(const FrameArena& o);
+
+    std::unique_ptr<std::max_align_t[]> m_memory;
+    const std::size_t m_capacity;
+    std::size_t m_used;
+    std::size_t m_peak;
+};
+
+// Commands recorded on one thread and executed in order on another. The
+// commands and everything they capture live in a FrameArena, so recording
+// a frame does not allocate.
+class CommandList {
+public:
+    explicit CommandList(std::size_t capacity = 4 << 20)
+        : m_arena(capacity), m_first(nullptr), m_last(nullptr), m_size(0) {}
+
+    virtual ~CommandList() { clear(); }
+
+    // Records fn() to run when the list is executed; false when the arena
+    // is full. Capture by value: the recording thread moves on to the next
+    // frame while this one runs.
+    template <typename F>
+    bool push(F&& fn) {
+        using Fn = typename std::decay<F>::type;
+        Command* const c(
+            static_cast<Command*>(m_arena.allocate(sizeof(Command))));
+        void* const payload(m_arena.allocate(sizeof(Fn), alignof(Fn)));
+        if (c == nullptr || payload == nullptr) return false;
+        new (payload) Fn(std::forward<F>(fn));
+        c->run = [](void* p) { (*static_cast<Fn*>(p))(); };
+        c->destroy = [](void* p) { static_cast<Fn*>(p)->~Fn(); };
+        c->payload = payload;
+        c->next = nullptr;
+        (m_last != nullptr ? m_last->next : m_first) = c;
+        m_last = c;
+        m_size++;
+        return true;
+    }
+
+    // Copies per-frame data such as uniform arrays into the list; nullptr
+    // when the arena is full.
+    template <typename T>
+    const T* copy(const T* data, std::size_t count) {
+        return m_arena.copy(data, count);
+    }
+
+    void execute() {
+        for (Command* c = m_first; c != nullptr; c = c->next) {
+            c->run(c->payload);
+        }
+    }
+
+    void clear() {
+        for (Command* c = m_first; c != nullptr; c = c->next) {
+            c->destroy(c->payload);
+        }
+        m_first = m_last = nullptr;
+        m_size = 0;
+        m_arena.reset();
+    }
+
+    std::size_t size() const { return m_size; }
+    const FrameArena& arena() const { return m_arena; }
+
+private:
+    CommandList(const CommandList& o);
+    CommandList& operator=(const CommandList& o);
+
+    struct Command {
+        void (*run)(void*);
+        void (*destroy)(void*);
+        void* payload;
+        Command* next;
+    };
+
+    FrameArena m_arena;
+    Command* m_first;
+    Command* m_last;
+    std::size_t m_size;
+};
+
+// Moves the window's GL context to a dedicated thread. Each frame the main
+// thread records a CommandList and submit()s it; the render thread executes
+// and presents it while the main thread simulates and records the next
+// one into the other list. Everything touching GL, including creating and
+// destroying objects, has to go through commands() or invoke() meanwhile,
+// and resize listeners run without a context. Destroy before the Window.
+class RenderThread {
+public:
+    explicit RenderThread(Window& window, std::size_t capacity = 4 << 20)
+        : m_window(window),
+          m_record(0),
+          m_submitted(-1),
+          m_busy(false),
+          m_call(nullptr),
+          m_quit(false),
+          m_size(),
+          m_waited(0.0) {
+        for (auto& list : m_lists) list.reset(new CommandList(capacity));
+        m_window.ReleaseContext();
+        m_thread = std::thread(&RenderThread::Run, this);
+    }
+
+    // Executes the pending frame and hands the context back to the
+    // destroying thread.
+    virtual ~RenderThread() {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_idle.wait(lock, [this] { return Idle(); });
+            m_quit = true;
+        }
+        m_wake.notify_one();
+        m_thread.join();
+        m_window.MakeContextCurrent();
+    }
+
+    // List recording the next frame
+    CommandList& commands() { return *m_lists[m_record]; }
+
+    // Hands the recorded frame over once the previous one has been
+    // presented, then processes input like Window::SwapBuffers().
+    void submit() {
+        const auto start(std::chrono::steady_clock::now());
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_idle.wait(lock, [this] { return Idle(); });
+            m_size[m_record] = {{static_cast<GLsizei>(m_window.GetWidth()),
+                                 static_cast<GLsizei>(m_window.GetHeight())}};
+            m_submitted = m_record;
+            m_record ^= 1;
+        }
+        m_waited = std::chrono::duration<double, std::milli>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+        m_wake.notify_one();
+        m_window.ProcessEvents();
+    }
+
+    // Runs fn() on the render thread between frames and waits for it, for
+    // setup and teardown.
+    void invoke(const std::function<void()>& fn) {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle.wait(lock, [this] { return Idle(); });
+        m_call = &fn;
+        m_wake.notify_one();
+        m_idle.wait(lock, [this] { return m_call == nullptr; });
+    }
+
+    // Milliseconds the last submit() waited for the render thread
+    double waited() const { return m_waited; }
+
+private:
+    RenderThread(const RenderThread& o);
+    RenderThread& operator=(const RenderThread& o);
+
+    bool Idle() const { return m_submitted < 0 && !m_busy; }
+
+    void Run() {
+        m_window.MakeContextCurrent();
+        std::array<GLsizei, 2> viewport = {{0, 0}};
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            m_wake.wait(lock, [this] {
+                return m_quit || m_submitted >= 0 || m_call != nullptr;
+            });
+            if (m_call != nullptr) {
+                (*m_call)();
+                m_call = nullptr;
+                m_idle.notify_all();
+                continue;
+            }
+            if (m_submitted < 0) break;  // quit
+            CommandList& list(*m_lists[m_submitted]);
+            const std::array<GLsizei, 2> size(m_size[m_submitted]);
+            m_submitted = -1;
+            m_busy = true;
+            lock.unlock();
+
+            if (size != viewport) {
+                glViewport(0, 0, size[0], size[1]);
+                viewport = size;
+            }
+            list.execute();
+            list.clear();
+            m_window.Present(size[0], size[1]);
+
+            lock.lock();
+            m_busy = false;
+            m_idle.notify_all();
+        }
+        lock.unlock();
+        glFinish();
+        m_window.ReleaseContext();
+    }
+
+    Window& m_window;
+    std::unique_ptr<CommandList> m_lists[2];
+    int m_record;     // list the main thread records into
+    int m_submitted;  // list waiting for the render thread, or -1
+    bool m_busy;      // executing a list
+    const std::function<void()>* m_call;
+    bool m_quit;
+    std::array<std::array<GLsizei, 2>, 2> m_size;  // framebuffer per list
+    double m_waited;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_idle;
+    std::thread m_thread;
+};
+
+// ============================== Material =================================
+
+struct Material {
+    alignas(16) std::array<GLfloat, 3> ambient;
+    alignas(16) std::array<GLfloat, 3> diffuse;
+    alignas(16) std::array<GLfloat, 3> specular;
+    alignas(4) GLfloat shininess;
+};
+
+// Materials without a specular term can use shader variants compiled with
+// NO_SPECULAR (see ShaderPermutations).
+inline bool HasSpecular(const Material& m) {
+    return m.specular[0] > 0.0f || m.specular[1] > 0.0f || m.specular[2] > 0.0f;
+}
+
+template <typename T>
+class Uniform {
+public:
+    Uniform(const T* data = NULL, unsigned int count = 1)
+        : m_buffer(new UniformBuffer(data, count)) {}
+    virtual ~Uniform() {}
+    void set(const T* data, unsigned int i = 0, unsigned int count = 1) const {
+        glBindBuffer(GL_UNIFORM_BUFFER, m_buffer->ubo);
+        for (unsigned int i = 0; i < count; i++) {
+            glBufferSubData(GL_UNIFORM_BUFFER, i * m_buffer->block_size,
+                            sizeof(T), data + i);
+        }
+    }
+    void select(unsigned int i = 0, GLuint binding_point = 0) const {
+        glBindBufferRange(GL_UNIFORM_BUFFER, binding_point, m_buffer->ubo,
+                          i * m_buffer->block_size, sizeof(T));
+    }
+
+private:
+    struct UniformBuffer {
+        GLuint ubo;  // uniform buffer object
+        GLsizeiptr block_size;
+        MemoryRecord memory;
+        UniformBuffer(const T* data, unsigned int count)
+            : memory(MemoryTag::UNIFORM) {
+            // Get uniform block size
+            GLint alignment;
+            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+            block_size = (((sizeof(T) - 1) / alignment) + 1) * alignment;
+
+            // Create ubo
+            glGenBuffers(1, &ubo);
+            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+            glBufferData(GL_UNIFORM_BUFFER, count * block_size, NULL,
+                         GL_STATIC_DRAW);
+            memory.add(count * block_size);
+            for (unsigned int i = 0; i < count; i++) {
+                glBufferSubData(GL_UNIFORM_BUFFER, i * block_size, sizeof(T),
+                                data + i);
+            }
+        }
+
+        ~UniformBuffer() { glDeleteBuffers(1, &ubo); }
+    };
+
+    const std::shared_ptr<const UniformBuffer> m_buffer;
+};
+
+extern template class Uniform<Material>;
+
+// =============================== Light ===================================
+
+struct PointLight {
+    Vector position;  // world space
+    std::array<GLfloat, 3> ambient;
+    std::array<GLfloat, 3> diffuse;
+    std::array<GLfloat, 3> specular;
+    GLfloat radius;  // no contribution beyond this distance
+};
+
+// Clustered forward lighting. update() bins the lights into a view-space
+// grid of tiles_x * tiles_y screen tiles and `slices` exponential depth
+// slices, so a fragment shader (clustered.frag) only evaluates the lights
+// overlapping its own cluster. Lights, per-cluster (offset, count) pairs and
+// the flat light index list are stored in texture buffers.
+class LightManager {
+public:
+    LightManager(int tiles_x = 16, int tiles_y = 9, int slices = 24,
+                 ThreadPool& pool = DefaultThreadPool())
+        : m_dim{{tiles_x, tiles_y, slices}},
+          m_pool(pool),
+          m_grid(2 * tiles_x * tiles_y * slices),
+          m_slice_idx(slices),
+          m_tile_size{{1.0f, 1.0f}},
+          m_slice_params{{0.0f, 0.0f}},
+          m_sizes{0, 0, 0},
+          m_memory(MemoryTag::UNIFORM),
+          m_unit(1) {
+        for (int i = 0; i < 3; i++) {
+            glGenBuffers(1, &m_buffer[i]);
+            glGenTextures(1, &m_texture[i]);
+        }
+        m_location.fill(-1);
+    }
+
+    virtual ~LightManager() {
+        glDeleteTextures(3, m_texture);
+        glDeleteBuffers(3, m_buffer);
+    }
+
+    std::size_t add(const PointLight& light) {
+        m_lights.emplace_back(light);
+        return m_lights.size() - 1;
+    }
+    PointLight& light(std::size_t i) { return m_lights[i]; }
+    std::size_t size() const { return m_lights.size(); }
+    void clear() { m_lights.clear(); }
+
+    // Rebuilds the clusters for a Matrix::Perspective projection and
+    // uploads them. width/height are the framebuffer size in pixels.
+    void update(const Matrix& view, GLfloat fovy, GLfloat aspect,
+                GLfloat z_near, GLfloat z_far, GLfloat width,
+                GLfloat height) {
+        // view-space lights, SoA and padded to a multiple of 4 with lights
+        // far behind the camera
+        const std::size_t count(m_lights.size());
+        const std::size_t padded((count + 3) & ~static_cast<std::size_t>(3));
+        m_x.assign(padded, 0.0f);
+        m_y.assign(padded, 0.0f);
+        m_z.assign(padded, 1e10f);
+        m_r2.assign(padded, 0.0f);
+        m_texels.resize(16 * count);
+        for (std::size_t i = 0; i < count; i++) {
+            const PointLight& l(m_lights[i]);
+            const Vector p(view * l.position);
+            m_x[i] = p[0];
+            m_y[i] = p[1];
+            m_z[i] = p[2];
+            m_r2[i] = l.radius * l.radius;
+
+            GLfloat* const t(&m_texels[16 * i]);
+            t[0] = p[0], t[1] = p[1], t[2] = p[2], t[3] = l.radius;
+            std::copy(l.ambient.begin(), l.ambient.end(), t + 4);
+            std::copy(l.diffuse.begin(), l.diffuse.end(), t + 8);
+            std::copy(l.specular.begin(), l.specular.end(), t + 12);
+            t[7] = t[11] = t[15] = 0.0f;
+        }
+
+        const GLfloat ty(std::tan(fovy * 0.5f)), tx(ty * aspect);
+        const GLfloat log_ratio(std::log(z_far / z_near));
+        m_tile_size = {{width / m_dim[0], height / m_dim[1]}};
+        m_slice_params = {{m_dim[2] / log_ratio,
+                           -m_dim[2] * std::log(z_near) / log_ratio}};
+
+        m_pool.parallelFor(m_dim[2], [&](int k) {
+            const GLfloat z0(z_near * std::exp(log_ratio * k / m_dim[2]));
+            const GLfloat z1(z_near * std::exp(log_ratio * (k + 1) / m_dim[2]));
+            BuildSlice(k, z0, z1, tx, ty);
+        });
+
+        // concatenate the per-slice index lists
+        m_index.clear();
+        const int per_slice(m_dim[0] * m_dim[1]);
+        for (int k = 0; k < m_dim[2]; k++) {
+            const GLuint base(static_cast<GLuint>(m_index.size()));
+            for (int c = k * per_slice; c < (k + 1) * per_slice; c++) {
+                m_grid[2 * c] += base;
+            }
+            m_index.insert(m_index.end(), m_slice_idx[k].begin(),
+                           m_slice_idx[k].end());
+        }
+        if (m_index.empty()) m_index.emplace_back(0);
+        if (m_texels.empty()) m_texels.resize(16, 0.0f);
+
+        Upload(0, GL_RGBA32F, m_texels.size() * sizeof(GLfloat),
+               m_texels.data());
+        Upload(1, GL_RG32UI, m_grid.size() * sizeof(GLuint), m_grid.data());
+        Upload(2, GL_R32UI, m_index.size() * sizeof(GLuint), m_index.data());
+    }
+
+    // Assigns texture units [unit, unit + 3) to the samplers of `program`
+    // and remembers its uniform locations. Leaves `program` in use.
+    void attach(GLuint program, GLint unit = 1) {
+        m_unit = unit;
+        glUseProgram(program);
+        glUniform1i(glGetUniformLocation(program, "lights"), unit);
+        glUniform1i(glGetUniformLocation(program, "clusters"), unit + 1);
+        glUniform1i(glGetUniformLocation(program, "light_index"), unit + 2);
+        m_location[0] = glGetUniformLocation(program, "cluster_dim");
+        m_location[1] = glGetUniformLocation(program, "tile_size");
+        m_location[2] = glGetUniformLocation(program, "slice_params");
+    }
+
+    // Binds the buffers for the attached program, which must be in use.
+    void bind() const {
+        for (int i = 0; i < 3; i++) {
+            glActiveTexture(GL_TEXTURE0 + m_unit + i);
+            glBindTexture(GL_TEXTURE_BUFFER, m_texture[i]);
+        }
+        glActiveTexture(GL_TEXTURE0);
+        glUniform3iv(m_location[0], 1, m_dim.data());
+        glUniform2fv(m_location[1], 1, m_tile_size.data());
+        glUniform2fv(m_location[2], 1, m_slice_params.data());
+    }
+
+private:
+    LightManager(const LightManager& o);
+    LightManager& operator=(const LightManager& o);
+
+    // Tests every light sphere against the view-space AABBs of slice k
+    // (view depth z0..z1) and records per-cluster light lists.
+    void BuildSlice(int k, GLfloat z0, GLfloat z1, GLfloat tx, GLfloat ty) {
+        std::vector<GLuint>& list(m_slice_idx[k]);
+        list.clear();
+        for (int j = 0; j < m_dim[1]; j++) {
+            const GLfloat ny0(2.0f * j / m_dim[1] - 1.0f);
+            const GLfloat ny1(2.0f * (j + 1) / m_dim[1] - 1.0f);
+            for (int i = 0; i < m_dim[0]; i++) {
+                const GLfloat nx0(2.0f * i / m_dim[0] - 1.0f);
+                const GLfloat nx1(2.0f * (i + 1) / m_dim[0] - 1.0f);
+
+                // bounds of the tile frustum between both depths
+                const GLfloat lo[] = {
+                    std::min(nx0 * z0, nx0 * z1) * tx,
+                    std::min(ny0 * z0, ny0 * z1) * ty, -z1};
+                const GLfloat hi[] = {
+                    std::max(nx1 * z0, nx1 * z1) * tx,
+                    std::max(ny1 * z0, ny1 * z1) * ty, -z0};
+
+                const int c((k * m_dim[1] + j) * m_dim[0] + i);
+                const std::size_t first(list.size());
+                Intersect(lo, hi, list);
+                m_grid[2 * c] = static_cast<GLuint>(first);
+                m_grid[2 * c + 1] = static_cast<GLuint>(list.size() - first);
+            }
+        }
+    }
+
+    void Intersect(const GLfloat* lo, const GLfloat* hi,
+                   std::vector<GLuint>& list) const {
+        const std::size_t n(m_x.size());
+#if defined(__SSE2__) || defined(_M_X64)
+        const __m128 zero(_mm_setzero_ps());
+        const __m128 lx(_mm_set1_ps(lo[0])), hx(_mm_set1_ps(hi[0]));
+        const __m128 ly(_mm_set1_ps(lo[1])), hy(_mm_set1_ps(hi[1]));
+        const __m128 lz(_mm_set1_ps(lo[2])), hz(_mm_set1_ps(hi[2]));
+        for (std::size_t l = 0; l < n; l += 4) {
+            const __m128 x(_mm_loadu_ps(&m_x[l]));
+            const __m128 y(_mm_loadu_ps(&m_y[l]));
+            const __m128 z(_mm_loadu_ps(&m_z[l]));
+            const __m128 dx(_mm_add_ps(_mm_max_ps(_mm_sub_ps(lx, x), zero),
+                                       _mm_max_ps(_mm_sub_ps(x, hx), zero)));
+            const __m128 dy(_mm_add_ps(_mm_max_ps(_mm_sub_ps(ly, y), zero),
+                                       _mm_max_ps(_mm_sub_ps(y, hy), zero)));
+            const __m128 dz(_mm_add_ps(_mm_max_ps(_mm_sub_ps(lz, z), zero),
+                                       _mm_max_ps(_mm_sub_ps(z, hz), zero)));
+            const __m128 d2(_mm_add_ps(
+                _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                _mm_mul_ps(dz, dz)));
+            const int mask(
+                _mm_movemask_ps(_mm_cmple_ps(d2, _mm_loadu_ps(&m_r2[l]))));
+            for (int b = 0; b < 4; b++) {
+                if (mask & (1 << b)) list.emplace_back(l + b);
+            }
+        }
+#else
+        for (std::size_t l = 0; l < n; l++) {
+            const GLfloat dx(std::max(lo[0] - m_x[l], 0.0f) +
+                             std::max(m_x[l] - hi[0], 0.0f));
+            const GLfloat dy(std::max(lo[1] - m_y[l], 0.0f) +
+                             std::max(m_y[l] - hi[1], 0.0f));
+            const GLfloat dz(std::max(lo[2] - m_z[l], 0.0f) +
+                             std::max(m_z[l] - hi[2], 0.0f));
+            if (dx * dx + dy * dy + dz * dz <= m_r2[l]) list.emplace_back(l);
+        }
+#endif
+    }
+
+    void Upload(int i, GLenum format, GLsizeiptr size, const void* data) {
+        glBindBuffer(GL_TEXTURE_BUFFER, m_buffer[i]);
+        glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, m_texture[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, m_buffer[i]);
+        m_sizes[i] = size;
+        m_memory.set(m_sizes[0] + m_sizes[1] + m_sizes[2]);
+    }
+
+    const std::array<GLint, 3> m_dim;  // tiles_x, tiles_y, slices
+    ThreadPool& m_pool;
+    std::vector<PointLight> m_lights;
+
+    // view-space light spheres (SoA)
+    std::vector<GLfloat> m_x, m_y, m_z, m_r2;
+
+    std::vector<GLfloat> m_texels;   // 4 RGBA texels per light
+    std::vector<GLuint> m_grid;      // (offset, count) per cluster
+    std::vector<GLuint> m_index;     // light indices of all clusters
+    std::vector<std::vector<GLuint>> m_slice_idx;
+
+    std::array<GLfloat, 2> m_tile_size;
+    std::array<GLfloat, 2> m_slice_params;
+
+    GLuint m_buffer[3];   // lights, clusters, light_index
+    GLuint m_texture[3];
+    GLsizeiptr m_sizes[3];
+    MemoryRecord m_memory;
+    GLint m_unit;
+    std::array<GLint, 3> m_location;
+};
+
+// ============================== Skinning =================================
+
+struct SkinnedVertex {
+    GLfloat position[3];
+    GLfloat normal[3];
+    GLubyte joints[4];  // palette indices
+    GLfloat weights[4];  // sum to 1
+};
+
+// Indexed mesh with the SkinnedVertex layout: position (0), normal (1),
+// joints (2, integer) and weights (3).
+class SkinnedGeometry {
+public:
+    SkinnedGeometry(GLsizei vtx_cnt, const SkinnedVertex* vtx, GLsizei idx_cnt,
+                    const GLuint* idx)
+        : m_idx_cnt(idx_cnt), m_memory(MemoryTag::GEOMETRY) {
+        glGenVertexArrays(1, &m_vao);
+        glBindVertexArray(m_vao);
+
+        glGenBuffers(1, &m_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        glBufferData(GL_ARRAY_BUFFER, vtx_cnt * sizeof(SkinnedVertex), vtx,
+                     GL_STATIC_DRAW);
+        const GLsizei stride(sizeof(SkinnedVertex));
+        char* const base(static_cast<char*>(0));
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride,
+                              base + offsetof(SkinnedVertex, position));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
+                              base + offsetof(SkinnedVertex, normal));
+        glEnableVertexAttribArray(1);
+        glVertexAttribIPointer(2, 4, GL_UNSIGNED_BYTE, stride,
+                               base + offsetof(SkinnedVertex, joints));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(3, 4, GL_FLOAT, GL_FALSE, stride,
+                              base + offsetof(SkinnedVertex, weights));
+        glEnableVertexAttribArray(3);
+
+        glGenBuffers(1, &m_ibo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx_cnt * sizeof(GLuint), idx,
+                     GL_STATIC_DRAW);
+        m_memory.add(vtx_cnt * sizeof(SkinnedVertex));
+        m_memory.add(idx_cnt * sizeof(GLuint));
+    }
+
+    virtual ~SkinnedGeometry() {
+        glDeleteVertexArrays(1, &m_vao);
+        glDeleteBuffers(1, &m_vbo);
+        glDeleteBuffers(1, &m_ibo);
+    }
+
+    void draw(GLenum mode = GL_TRIANGLES) const {
+        glBindVertexArray(m_vao);
+        glDrawElements(mode, m_idx_cnt, GL_UNSIGNED_INT, 0);
+    }
+
+private:
+    SkinnedGeometry(const SkinnedGeometry& o);
+    SkinnedGeometry& operator=(const SkinnedGeometry& o);
+
+    GLuint m_vao;
+    GLuint m_vbo;
+    GLuint m_ibo;
+    const GLsizei m_idx_cnt;
+    MemoryRecord m_memory;
+};
+
+// Joint hierarchy. Parents must be added before their children.
+class Skeleton {
+public:
+    // Returns the new joint index. `parent` is -1 for a root.
+    int add(int parent, const Matrix& inverse_bind) {
+        assert(parent < static_cast<int>(m_parent.size()));
+        m_parent.emplace_back(parent);
+        m_inverse_bind.emplace_back(inverse_bind);
+        return static_cast<int>(m_parent.size()) - 1;
+    }
+
+    std::size_t size() const { return m_parent.size(); }
+    int parent(std::size_t i) const { return m_parent[i]; }
+    const Matrix& inverseBind(std::size_t i) const {
+        return m_inverse_bind[i];
+    }
+
+private:
+    std::vector<int> m_parent;
+    std::vector<Matrix> m_inverse_bind;
+};
+
+// Local joint transforms sampled at a fixed rate. Keys are stored frame by
+// frame as separate rotation/translation/scale arrays so that sampling a
+// pose reads two contiguous blocks per channel.
+class AnimationClip {
+public:
+    AnimationClip(std::size_t joints, std::size_t frames, GLfloat rate = 30.0f)
+        : m_joints(joints),
+          m_frames(std::max<std::size_t>(frames, 1)),
+          m_rate(rate),
+          m_rotation(m_frames * joints, Quaternion::Identity()),
+          m_translation(3 * m_frames * joints, 0.0f),
+          m_scale(3 * m_frames * joints, 1.0f) {}
+
+    void setKey(std::size_t frame, std::size_t joint, const Vector& t,
+                const Quaternion& r, const Vector& s = {{1.0f, 1.0f, 1.0f}}) {
+        const std::size_t k(frame * m_joints + joint);
+        m_rotation[k] = r;
+        std::copy(t.begin(), t.begin() + 3, &m_translation[3 * k]);
+        std::copy(s.begin(), s.begin() + 3, &m_scale[3 * k]);
+    }
+
+    std::size_t joints() const { return m_joints; }
+    GLfloat duration() const { return (m_frames - 1) / m_rate; }
+
+    // Writes the local pose at `time` (looping) into r/t/s, which hold
+    // joints() quaternions and 3 * joints() floats.
+    void sample(GLfloat time, Quaternion* r, GLfloat* t, GLfloat* s) const {
+        const GLfloat last(static_cast<GLfloat>(m_frames - 1));
+        GLfloat f(0.0f);
+        if (m_frames > 1) {
+            f = std::fmod(time * m_rate, last);
+            if (f < 0.0f) f += last;
+        }
+        const std::size_t f0(
+            std::min(static_cast<std::size_t>(f), m_frames - 1));
+        const std::size_t f1(std::min(f0 + 1, m_frames - 1));
+        const GLfloat a(f - f0);
+
+        const std::size_t k0(f0 * m_joints), k1(f1 * m_joints);
+        std::vector<GLfloat>& alpha(Scratch());
+        alpha.assign(m_joints, a);
+        InterpolateBatch(&m_rotation[k0], &m_rotation[k1], alpha.data(), r,
+                         m_joints);
+        for (std::size_t i = 0; i < 3 * m_joints; i++) {
+            t[i] = m_translation[3 * k0 + i] +
+                   (m_translation[3 * k1 + i] - m_translation[3 * k0 + i]) * a;
+            s[i] = m_scale[3 * k0 + i] +
+                   (m_scale[3 * k1 + i] - m_scale[3 * k0 + i]) * a;
+        }
+    }
+
+private:
+    static std::vector<GLfloat>& Scratch() {
+        static thread_local std::vector<GLfloat> scratch;
+        return scratch;
+    }
+
+    const std::size_t m_joints;
+    const std::size_t m_frames;
+    const GLfloat m_rate;
+    std::vector<Quaternion> m_rotation;
+    std::vector<GLfloat> m_translation;
+    std::vector<GLfloat> m_scale;
+};
+
+struct SkinInstance {
+    const Skeleton* skeleton;
+    const AnimationClip* clip;
+    GLfloat time;
+    GLint palette_offset;  // set by SkinningPalette::update()
+};
+
+// Evaluates the joint palettes of many skinned instances in parallel and
+// uploads them into one texture buffer with three RGBA texels (the rows of
+// the affine skinning matrix) per joint. Each instance then only sets its
+// palette_offset uniform before drawing (see skinned.vert).
+class SkinningPalette {
+public:
+    explicit SkinningPalette(ThreadPool& pool = DefaultThreadPool())
+        : m_pool(pool), m_memory(MemoryTag::UNIFORM) {
+        glGenBuffers(1, &m_buffer);
+        glGenTextures(1, &m_texture);
+    }
+
+    virtual ~SkinningPalette() {
+        glDeleteTextures(1, &m_texture);
+        glDeleteBuffers(1, &m_buffer);
+    }
+
+    // Instances whose clip does not animate exactly the joints of their
+    // skeleton are reported and left in the bind pose.
+    void update(std::vector<SkinInstance>& instances) {
+        GLint joints(0);
+        m_valid.resize(instances.size());
+        for (std::size_t k = 0; k < instances.size(); k++) {
+            SkinInstance& i(instances[k]);
+            i.palette_offset = joints;
+            joints += static_cast<GLint>(i.skeleton->size());
+            m_valid[k] = i.clip->joints() == i.skeleton->size();
+            if (!m_valid[k]) {
+                std::cerr << "Error: Clip animates " << i.clip->joints()
+                          << " joints, skeleton has " << i.skeleton->size()
+                          << "." << std::endl;
+            }
+        }
+        m_rows.resize(12 * std::max(joints, 1));
+
+        m_pool.parallelFor(static_cast<int>(instances.size()), [&](int i) {
+            const SkinInstance& s(instances[i]);
+            GLfloat* const rows(&m_rows[12 * s.palette_offset]);
+            if (m_valid[i]) {
+                Evaluate(*s.skeleton, *s.clip, s.time, rows);
+                return;
+            }
+            for (std::size_t j = 0; j < s.skeleton->size(); j++) {
+                GLfloat* const o(rows + 12 * j);
+                std::fill(o, o + 12, 0.0f);
+                o[0] = o[5] = o[10] = 1.0f;
+            }
+        });
+
+        glBindBuffer(GL_TEXTURE_BUFFER, m_buffer);
+        glBufferData(GL_TEXTURE_BUFFER, m_rows.size() * sizeof(GLfloat),
+                     m_rows.data(), GL_STREAM_DRAW);
+        m_memory.set(m_rows.size() * sizeof(GLfloat));
+        glBindTexture(GL_TEXTURE_BUFFER, m_texture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, m_buffer);
+    }
+
+    void bind(GLint unit = 1) const {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_BUFFER, m_texture);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+private:
+    SkinningPalette(const SkinningPalette& o);
+    SkinningPalette& operator=(const SkinningPalette& o);
+
+    // Samples the clip and writes the first three rows of
+    // global * inverse_bind for every joint into `rows`. The clip must have
+    // as many joints as the skeleton.
+    static void Evaluate(const Skeleton& skeleton, const AnimationClip& clip,
+                         GLfloat time, GLfloat* rows) {
+        assert(clip.joints() == skeleton.size());
+        static thread_local std::vector<Quaternion> r;
+        static thread_local std::vector<GLfloat> t, s;
+        static thread_local std::vector<Matrix> global;
+        const std::size_t n(skeleton.size());
+        r.resize(n);
+        t.resize(3 * n);
+        s.resize(3 * n);
+        global.resize(n);
+
+        clip.sample(time, r.data(), t.data(), s.data());
+        for (std::size_t j = 0; j < n; j++) {
+            const Matrix local(Matrix::TRS(t[3 * j], t[3 * j + 1],
+                                           t[3 * j + 2], r[j].ToMatrix(),
+                                           s[3 * j], s[3 * j + 1],
+                                           s[3 * j + 2]));
+            const int p(skeleton.parent(j));
+            assert(p < static_cast<int>(j));  // parents come first
+            global[j] = p < 0 ? local : global[p] * local;
+
+            const Matrix skin(global[j] * skeleton.inverseBind(j));
+            const GLfloat* const m(skin.Data());
+            GLfloat* const o(rows + 12 * j);
+            for (int c = 0; c < 4; c++) {
+                o[c] = m[4 * c];
+                o[4 + c] = m[4 * c + 1];
+                o[8 + c] = m[4 * c + 2];
+            }
+        }
+    }
+
+    ThreadPool& m_pool;
+    std::vector<GLfloat> m_rows;
+    std::vector<char> m_valid;  // per instance, written before parallelFor
+    GLuint m_buffer;
+    GLuint m_texture;
+    MemoryRecord m_memory;
+};
+
+// ============================== Texture ==================================
+
+// 8-bit image with 1 (gray) to 4 (RGBA) interleaved channels. Rows are
+// stored bottom to top, the order glTexImage2D() expects.
+struct Image {
+    GLsizei width;
+    GLsizei height;
+    GLsizei channels;
+    std::vector<GLubyte> pixels;
+
+    Image(GLsizei w = 0, GLsizei h = 0, GLsizei c = 4)
+        : width(w), height(h), channels(c), pixels(w * h * c) {}
+
+    GLubyte* row(GLsizei y) { return pixels.data() + y * width * channels; }
+    const GLubyte* row(GLsizei y) const {
+        return pixels.data() + y * width * channels;
+    }
+};
+
+// Decodes Netpbm (P2, P3, P5, P6 with maxval <= 255) and Targa (raw or RLE
+// true-color and gray) images. Rows are read one at a time, so the whole
+// file is never buffered.
+inline bool DecodeImage(std::istream& in, Image& image) {
+    const int magic(in.peek());
+    if (magic == 'P') {
+        char p;
+        int kind, w, h, maxval;
+        in >> p >> kind;
+        auto skip = [&] {  // whitespace and comments between tokens
+            for (in >> std::ws; in.peek() == '#'; in >> std::ws) {
+                in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+            }
+        };
+        skip();
+        in >> w;
+        skip();
+        in >> h;
+        skip();
+        in >> maxval;
+        if (!in || w <= 0 || h <= 0 || maxval <= 0 || maxval > 255 ||
+            kind < 2 || kind == 4 || kind > 6) {
+            return false;
+        }
+        const bool ascii(kind < 4);
+        image = Image(w, h, kind == 2 || kind == 5 ? 1 : 3);
+        in.get();  // single whitespace before binary data
+        const GLsizei stride(w * image.channels);
+        for (GLsizei y = h - 1; y >= 0; y--) {
+            GLubyte* const row(image.row(y));
+            if (ascii) {
+                for (GLsizei i = 0; i < stride; i++) {
+                    int v;
+                    in >> v;
+                    row[i] = static_cast<GLubyte>(v * 255 / maxval);
+                }
+            } else {
+                in.read(reinterpret_cast<char*>(row), stride);
+                if (maxval != 255) {
+                    for (GLsizei i = 0; i < stride; i++) {
+                        row[i] = static_cast<GLubyte>(row[i] * 255 / maxval);
+                    }
+                }
+            }
+            if (!in) return false;
+        }
+        return true;
+    }
+
+    // Targa
+    GLubyte header[18];
+    if (!in.read(reinterpret_cast<char*>(header), sizeof header)) return false;
+    const int type(header[2]);
+    const GLsizei w(header[12] | header[13] << 8);
+    const GLsizei h(header[14] | header[15] << 8);
+    const int bpp(header[16] / 8);
+    const bool top_down((header[17] & 0x20) != 0);
+    const bool rle(type == 10 || type == 11);
+    if (header[1] != 0 || (type != 2 && type != 3 && !rle) || w == 0 ||
+        h == 0 || (bpp != 1 && bpp != 3 && bpp != 4)) {
+        return false;
+    }
+    in.ignore(header[0]);  // image id
+    image = Image(w, h, bpp);
+
+    GLubyte packet[4];
+    int run(0);  // pixels left in the current RLE packet
+    bool repeat(false);
+    for (GLsizei r = 0; r < h; r++) {
+        GLubyte* const row(image.row(top_down ? h - 1 - r : r));
+        if (!rle) {
+            in.read(reinterpret_cast<char*>(row), w * bpp);
+        } else {
+            for (GLsizei x = 0; x < w; x++) {
+                if (run == 0) {
+                    const int c(in.get());
+                    repeat = (c & 0x80) != 0;
+                    run = (c & 0x7f) + 1;
+                    if (repeat) in.read(reinterpret_cast<char*>(packet), bpp);
+                }
+                if (!repeat) in.read(reinterpret_cast<char*>(packet), bpp);
+                std::memcpy(row + x * bpp, packet, bpp);
+                run--;
+            }
+        }
+        if (!in) return false;
+        if (bpp >= 3) {  // BGR(A) to RGB(A)
+            for (GLsizei x = 0; x < w; x++) {
+                std::swap(row[x * bpp], row[x * bpp + 2]);
+            }
+        }
+    }
+    return true;
+}
+
+inline bool ReadImage(const std::string name, Image& image) {
+    std::ifstream file(name, std::ios::binary);
+    if (file.fail()) {
+        std::cerr << "Error: Can't open " << name << std::endl;
+        return false;
+    }
+    if (!DecodeImage(file, image)) {
+        std::cerr << "Error: Could not decode " << name << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Writes binary PGM (1 channel) or PPM (alpha and gray-alpha dropped).
+inline bool WriteImage(const std::string name, const Image& image) {
+    std::ofstream file(name, std::ios::binary);
+    if (file.fail()) {
+        std::cerr << "Error: Can't write " << name << std::endl;
+        return false;
+    }
+    const GLsizei c(image.channels);
+    const GLsizei out(c == 1 ? 1 : 3);
+    file << (out == 1 ? "P5\n" : "P6\n") << image.width << " "
+         << image.height << "\n255\n";
+    std::vector<char> row(image.width * out);
+    for (GLsizei y = image.height - 1; y >= 0; y--) {
+        const GLubyte* const src(image.row(y));
+        for (GLsizei x = 0; x < image.width; x++) {
+            for (GLsizei k = 0; k < out; k++) {
+                row[x * out + k] =
+                    static_cast<char>(src[x * c + (c < 3 ? 0 : k)]);
+            }
+        }
+        file.write(row.data(), row.size());
+    }
+    return file.good();
+}
+
+// Same pixels with 1 to 4 channels; gray expands to RGB, alpha to 255.
+inline Image ConvertChannels(const Image& src, GLsizei channels) {
+    if (src.channels == channels) return src;
+    Image dst(src.width, src.height, channels);
+    const std::size_t n(static_cast<std::size_t>(src.width) * src.height);
+    for (std::size_t i = 0; i < n; i++) {
+        const GLubyte* const s(&src.pixels[i * src.channels]);
+        GLubyte* const d(&dst.pixels[i * channels]);
+        for (GLsizei c = 0; c < channels; c++) {
+            if (c == 3) {
+                d[c] = src.channels == 4 ? s[3] : src.channels == 2 ? s[1]
+                                                                     : 255;
+            } else {
+                d[c] = src.channels < 3 ? s[0] : s[c];
+            }
+        }
+    }
+    return dst;
+}
+
+enum class MipFilter {
+    BOX,    // 2x2 average, fast
+    KAISER  // 6-tap Kaiser-windowed sinc, sharper minification
+};
+
+// Halves `src` with a 2x2 box filter. Odd trailing rows/columns are
+// dropped, except that dimensions of 1 stay 1.
+inline void DownsampleBox(const Image& src, Image& dst,
+                          ThreadPool& pool = DefaultThreadPool()) {
+    const GLsizei c(src.channels);
+    dst = Image(std::max(src.width / 2, 1), std::max(src.height / 2, 1), c);
+    const GLsizei dx(src.width > 1 ? 1 : 0);
+    const GLsizei dy(src.height > 1 ? 1 : 0);
+    pool.parallelFor(dst.height, [&](int y) {
+        const GLubyte* const r0(src.row(y * 2 * dy));
+        const GLubyte* const r1(src.row(y * 2 * dy + dy));
+        GLubyte* const out(dst.row(y));
+        GLsizei x(0);
+#if defined(__SSE2__) || defined(_M_X64)
+        if (c == 4 && dx == 1) {  // two RGBA outputs per iteration
+            const __m128i zero(_mm_setzero_si128());
+            const __m128i two(_mm_set1_epi16(2));
+            for (; x + 2 <= dst.width; x += 2) {
+                const __m128i a(_mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(r0 + x * 8)));
+                const __m128i b(_mm_loadu_si128(
+                    reinterpret_cast<const __m128i*>(r1 + x * 8)));
+                const __m128i lo(_mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+                                               _mm_unpacklo_epi8(b, zero)));
+                const __m128i hi(_mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+                                               _mm_unpackhi_epi8(b, zero)));
+                // pixel pairs (0,1) and (2,3) summed in the low halves
+                const __m128i sum(_mm_unpacklo_epi64(
+                    _mm_add_epi16(lo, _mm_srli_si128(lo, 8)),
+                    _mm_add_epi16(hi, _mm_srli_si128(hi, 8))));
+                const __m128i avg(_mm_srli_epi16(_mm_add_epi16(sum, two), 2));
+                _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x * 4),
+                                 _mm_packus_epi16(avg, avg));
+            }
+        }
+#endif
+        for (; x < dst.width; x++) {
+            const GLsizei x0(x * 2 * dx * c), x1(x0 + dx * c);
+            for (GLsizei k = 0; k < c; k++) {
+                out[x * c + k] = static_cast<GLubyte>(
+                    (r0[x0 + k] + r0[x1 + k] + r1[x0 + k] + r1[x1 + k] + 2) >>
+                    2);
+            }
+        }
+    });
+}
+
+// Halves `src` with a separable Kaiser-windowed sinc (alpha 4, 6 taps),
+// clamping at the edges. The vertical pass runs 4 floats per SSE lane.
+inline void DownsampleKaiser(const Image& src, Image& dst,
+                             ThreadPool& pool = DefaultThreadPool()) {
+    static const std::array<GLfloat, 6> weights([] {
+        auto bessel = [](double x) {  // I0
+            double sum(1.0), term(1.0);
+            for (int k = 1; k < 16; k++) {
+                term *= (x / (2.0 * k)) * (x / (2.0 * k));
+                sum += term;
+            }
+            return sum;
+        };
+        const double alpha(4.0), pi(3.14159265358979323846);
+        std::array<GLfloat, 6> w;
+        double total(0.0);
+        for (int k = 0; k < 6; k++) {
+            const double t((k - 2.5) / 2.0);  // in destination pixels
+            const double r(t / 1.5);
+            const double sinc(std::sin(pi * t) / (pi * t));
+            w[k] = static_cast<GLfloat>(
+                sinc * bessel(alpha * std::sqrt(1.0 - r * r)) / bessel(alpha));
+            total += w[k];
+        }
+        for (GLfloat& v : w) v = static_cast<GLfloat>(v / total);
+        return w;
+    }());
+
+    const GLsizei c(src.channels);
+    dst = Image(std::max(src.width / 2, 1), std::max(src.height / 2, 1), c);
+    const GLsizei hx(src.width > 1 ? 2 : 1);  // source pixels per output
+    const GLsizei hy(src.height > 1 ? 2 : 1);
+
+    // horizontal: src.height rows of dst.width pixels
+    const GLsizei stride(dst.width * c);
+    std::vector<GLfloat> tmp(static_cast<std::size_t>(stride) * src.height);
+    pool.parallelFor(src.height, [&](int y) {
+        const GLubyte* const in(src.row(y));
+        GLfloat* const out(&tmp[static_cast<std::size_t>(y) * stride]);
+        for (GLsizei x = 0; x < dst.width; x++) {
+            for (GLsizei k = 0; k < c; k++) out[x * c + k] = 0.0f;
+            for (int t = 0; t < 6; t++) {
+                const GLfloat w(hx == 1 ? (t == 2 ? 1.0f : 0.0f) : weights[t]);
+                const GLsizei sx(std::min(std::max(x * hx + t - 2, 0),
+                                          src.width - 1));
+                for (GLsizei k = 0; k < c; k++) {
+                    out[x * c + k] += w * in[sx * c + k];
+                }
+            }
+        }
+    });
+
+    // vertical
+    pool.parallelFor(dst.height, [&](int y) {
+        std::vector<GLfloat> acc(stride, 0.0f);
+        for (int t = 0; t < 6; t++) {
+            const GLfloat w(hy == 1 ? (t == 2 ? 1.0f : 0.0f) : weights[t]);
+            if (w == 0.0f) continue;
+            const GLsizei sy(std::min(std::max(y * hy + t - 2, 0),
+                                      src.height - 1));
+            const GLfloat* const in(
+                &tmp[static_cast<std::size_t>(sy) * stride]);
+            GLsizei i(0);
+#if defined(__SSE2__) || defined(_M_X64)
+            const __m128 w4(_mm_set1_ps(w));
+            for (; i + 4 <= stride; i += 4) {
+                _mm_storeu_ps(&acc[i],
+                              _mm_add_ps(_mm_loadu_ps(&acc[i]),
+                                         _mm_mul_ps(w4, _mm_loadu_ps(in + i))));
+            }
+#endif
+            for (; i < stride; i++) acc[i] += w * in[i];
+        }
+        GLubyte* const out(dst.row(y));
+        for (GLsizei i = 0; i < stride; i++) {
+            out[i] = static_cast<GLubyte>(
+                std::min(std::max(acc[i] + 0.5f, 0.0f), 255.0f));
+        }
+    });
+}
+
+// Appends the mip chain of levels[0] down to 1x1.
+inline void GenerateMipmaps(std::vector<Image>& levels,
+                            MipFilter filter = MipFilter::BOX,
+                            ThreadPool& pool = DefaultThreadPool()) {
+    levels.resize(1);
+    while (levels.back().width > 1 || levels.back().height > 1) {
+        Image next;
+        if (filter == MipFilter::KAISER) {
+            DownsampleKaiser(levels.back(), next, pool);
+        } else {
+            DownsampleBox(levels.back(), next, pool);
+        }
+        levels.emplace_back(std::move(next));
+    }
+}
+
+inline GLenum PixelFormat(GLsizei channels) {
+    static constexpr GLenum formats[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+    return formats[channels - 1];
+}
+
+inline GLenum InternalFormat(GLsizei channels) {
+    static constexpr GLenum formats[] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+    return formats[channels - 1];
+}
+
+inline void SetSampler(GLenum target, bool mipmaps, GLenum wrap) {
+    glTexParameteri(target, GL_TEXTURE_MIN_FILTER,
+                    mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(target, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(target, GL_TEXTURE_WRAP_T, wrap);
+}
+
+// Sets GL_UNPACK_ALIGNMENT for the uploads in its scope, then restores the
+// previous value so later uploads are unaffected.
+class UnpackAlignment {
+public:
+    explicit UnpackAlignment(GLint alignment) : m_previous(4) {
+        glGetIntegerv(GL_UNPACK_ALIGNMENT, &m_previous);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    }
+
+    ~UnpackAlignment() { glPixelStorei(GL_UNPACK_ALIGNMENT, m_previous); }
+
+private:
+    UnpackAlignment(const UnpackAlignment& o);
+    UnpackAlignment& operator=(const UnpackAlignment& o);
+
+    GLint m_previous;
+};
+
+// 2D texture from a mip chain (levels[0] is the base image).
+class Texture {
+public:
+    explicit Texture(const std::vector<Image>& levels,
+                     GLenum wrap = GL_REPEAT)
+        : m_width(levels[0].width),
+          m_height(levels[0].height),
+          m_memory(MemoryTag::TEXTURE) {
+        glGenTextures(1, &m_texture);
+        glBindTexture(GL_TEXTURE_2D, m_texture);
+        const UnpackAlignment alignment(1);  // rows are tightly packed
+        std::uint64_t bytes(0);
+        for (std::size_t i = 0; i < levels.size(); i++) {
+            const Image& level(levels[i]);
+            glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(i),
+                         InternalFormat(level.channels), level.width,
+                         level.height, 0, PixelFormat(level.channels),
+                         GL_UNSIGNED_BYTE, level.pixels.data());
+            bytes += level.pixels.size();
+        }
+        m_memory.add(bytes);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                        static_cast<GLint>(levels.size()) - 1);
+        SetSampler(GL_TEXTURE_2D, levels.size() > 1, wrap);
+    }
+
+    virtual ~Texture() { glDeleteTextures(1, &m_texture); }
+
+    void bind(GLuint unit = 0) const {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, m_texture);
+    }
+
+    GLuint id() const { return m_texture; }
+    GLsizei width() const { return m_width; }
+    GLsizei height() const { return m_height; }
+
+private:
+    Texture(const Texture& o);
+    Texture& operator=(const Texture& o);
+
+    GLuint m_texture;
+    const GLsizei m_width;
+    const GLsizei m_height;
+    MemoryRecord m_memory;
+};
+
+inline std::unique_ptr<const Texture> LoadTexture(
+    const std::string name, MipFilter filter = MipFilter::BOX) {
+    std::vector<Image> levels(1);
+    if (!ReadImage(name, levels[0])) return nullptr;
+    GenerateMipmaps(levels, filter);
+    return std::unique_ptr<const Texture>(new Texture(levels));
+}
+
+// Equally sized layers behind one binding (sampler2DArray), so draws using
+// different images need no texture switches.
+class TextureArray {
+public:
+    TextureArray(GLsizei width, GLsizei height, GLsizei layers,
+                 GLsizei channels = 4, bool mipmaps = true)
+        : m_width(width), m_height(height), m_layers(layers),
+          m_channels(channels), m_levels(1), m_memory(MemoryTag::TEXTURE) {
+        glGenTextures(1, &m_texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_texture);
+        std::uint64_t bytes(0);
+        for (GLsizei w = width, h = height;; m_levels++) {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, m_levels - 1,
+                         InternalFormat(channels), w, h, layers, 0,
+                         PixelFormat(channels), GL_UNSIGNED_BYTE, nullptr);
+            bytes += static_cast<std::uint64_t>(w) * h * layers * channels;
+            if (!mipmaps || (w == 1 && h == 1)) break;
+            w = std::max(w / 2, 1);
+            h = std::max(h / 2, 1);
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL,
+                        m_levels - 1);
+        SetSampler(GL_TEXTURE_2D_ARRAY, mipmaps, GL_REPEAT);
+        m_memory.add(bytes);
+    }
+
+    virtual ~TextureArray() { glDeleteTextures(1, &m_texture); }
+
+    // Uploads `image` and its mip chain into `layer`. The image must have
+    // the array's size; channels are converted as needed.
+    bool set(GLsizei layer, const Image& image,
+             MipFilter filter = MipFilter::BOX) {
+        if (image.width != m_width || image.height != m_height ||
+            layer < 0 || layer >= m_layers) {
+            std::cerr << "Error: Layer does not match the texture array."
+                      << std::endl;
+            return false;
+        }
+        std::vector<Image> levels(1, ConvertChannels(image, m_channels));
+        if (m_levels > 1) GenerateMipmaps(levels, filter);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_texture);
+        const UnpackAlignment alignment(1);
+        for (GLsizei i = 0; i < m_levels; i++) {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, i, 0, 0, layer,
+                            levels[i].width, levels[i].height, 1,
+                            PixelFormat(m_channels), GL_UNSIGNED_BYTE,
+                            levels[i].pixels.data());
+        }
+        return true;
+    }
+
+    void bind(GLuint unit = 0) const {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_texture);
+    }
+
+    GLuint id() const { return m_texture; }
+    GLsizei layers() const { return m_layers; }
+
+private:
+    TextureArray(const TextureArray& o);
+    TextureArray& operator=(const TextureArray& o);
+
+    GLuint m_texture;
+    const GLsizei m_width;
+    const GLsizei m_height;
+    const GLsizei m_layers;
+    const GLsizei m_channels;
+    GLint m_levels;
+    MemoryRecord m_memory;
+};
+
+// Skyline bin packer (bottom-left rule): rectangles rest on the lowest
+// segment of the skyline that fits them.
+class SkylinePacker {
+public:
+    SkylinePacker(GLsizei width, GLsizei height)
+        : m_width(width), m_height(height) {
+        clear();
+    }
+
+    void clear() {
+        m_skyline.assign(1, Segment{0, 0, m_width});
+        m_used = 0;
+    }
+
+    // Finds room for w x h; returns false when the rectangle does not fit.
+    bool pack(GLsizei w, GLsizei h, GLsizei& x, GLsizei& y) {
+        std::size_t best(m_skyline.size());
+        GLsizei best_top(m_height + 1), best_width(0);
+        for (std::size_t i = 0; i < m_skyline.size(); i++) {
+            GLsizei top;
+            if (!Fit(i, w, h, top)) continue;
+            if (top < best_top ||
+                (top == best_top && m_skyline[i].width < best_width)) {
+                best = i;
+                best_top = top;
+                best_width = m_skyline[i].width;
+            }
+        }
+        if (best == m_skyline.size()) return false;
+
+        x = m_skyline[best].x;
+        y = best_top - h;
+        m_skyline.insert(m_skyline.begin() + best, Segment{x, best_top, w});
+
+        // trim the segments now covered by the new one
+        for (std::size_t i = best + 1; i < m_skyline.size();) {
+            Segment& s(m_skyline[i]);
+            const GLsizei shrink(x + w - s.x);
+            if (shrink <= 0) break;
+            if (shrink < s.width) {
+                s.x += shrink;
+                s.width -= shrink;
+                break;
+            }
+            m_skyline.erase(m_skyline.begin() + i);
+        }
+        // merge neighbours of equal height
+        for (std::size_t i = 0; i + 1 < m_skyline.size();) {
+            if (m_skyline[i].y == m_skyline[i + 1].y) {
+                m_skyline[i].width += m_skyline[i + 1].width;
+                m_skyline.erase(m_skyline.begin() + i + 1);
+            } else {
+                i++;
+            }
+        }
+        m_used += static_cast<std::size_t>(w) * h;
+        return true;
+    }
+
+    // Fraction of the area covered by packed rectangles.
+    GLfloat occupancy() const {
+        return static_cast<GLfloat>(m_used) /
+               (static_cast<GLfloat>(m_width) * m_height);
+    }
+
+private:
+    struct Segment {
+        GLsizei x;
+        GLsizei y;  // height of the skyline
+        GLsizei width;
+    };
+
+    // Top edge of w x h placed at the left of segment i.
+    bool Fit(std::size_t i, GLsizei w, GLsizei h, GLsizei& top) const {
+        if (m_skyline[i].x + w > m_width) return false;
+        GLsizei y(0);
+        for (GLsizei left(w); left > 0; i++) {
+            y = std::max(y, m_skyline[i].y);
+            left -= m_skyline[i].width;
+        }
+        top = y + h;
+        return top <= m_height;
+    }
+
+    const GLsizei m_width;
+    const GLsizei m_height;
+    std::vector<Segment> m_skyline;
+    std::size_t m_used;
+};
+
+// RGBA atlas packing many small images into one texture. Each image gets
+// `padding` pixels of replicated border against filtering bleed.
+class TextureAtlas {
+public:
+    TextureAtlas(GLsizei width, GLsizei height, GLsizei padding = 2)
+        : m_image(width, height, 4),
+          m_packer(width, height),
+          m_padding(padding) {}
+
+    // Copies `image` into the atlas and returns its texture coordinates
+    // {u0, v0, u1, v1}, or false when the atlas is full.
+    bool add(const Image& image, std::array<GLfloat, 4>& uv) {
+        const GLsizei p(m_padding);
+        GLsizei x, y;
+        if (!m_packer.pack(image.width + 2 * p, image.height + 2 * p, x, y)) {
+            return false;
+        }
+        const Image rgba(ConvertChannels(image, 4));
+        for (GLsizei j = 0; j < image.height + 2 * p; j++) {
+            const GLsizei sy(std::min(std::max(j - p, 0), image.height - 1));
+            GLubyte* const out(m_image.row(y + j) + x * 4);
+            for (GLsizei i = 0; i < image.width + 2 * p; i++) {
+                const GLsizei sx(
+                    std::min(std::max(i - p, 0), image.width - 1));
+                std::memcpy(out + i * 4, rgba.row(sy) + sx * 4, 4);
+            }
+        }
+        const GLfloat w(static_cast<GLfloat>(m_image.width));
+        const GLfloat h(static_cast<GLfloat>(m_image.height));
+        uv = {{(x + p) / w, (y + p) / h, (x + p + image.width) / w,
+               (y + p + image.height) / h}};
+        return true;
+    }
+
+    // Creates the texture from everything added so far.
+    void upload(MipFilter filter = MipFilter::BOX) {
+        std::vector<Image> levels(1, m_image);
+        GenerateMipmaps(levels, filter);
+        m_texture.reset(new Texture(levels, GL_CLAMP_TO_EDGE));
+    }
+
+    void bind(GLuint unit = 0) const {
+        if (m_texture) m_texture->bind(unit);
+    }
+
+    const Image& image() const { return m_image; }
+    GLfloat occupancy() const { return m_packer.occupancy(); }
+
+private:
+    TextureAtlas(const TextureAtlas& o);
+    TextureAtlas& operator=(const TextureAtlas& o);
+
+    Image m_image;
+    SkylinePacker m_packer;
+    const GLsizei m_padding;
+    std::unique_ptr<const Texture> m_texture;
+};
+
+struct TexturedVertex {
+    GLfloat position[3];
+    GLfloat normal[3];
+    GLfloat texcoord[2];
+};
+
+// Indexed mesh with the TexturedVertex layout: position (0), normal (1)
+// and texcoord (4).
+class TexturedGeometry {
+public:
+    TexturedGeometry(GLsizei vtx_cnt, const TexturedVertex* vtx,
+                     GLsizei idx_cnt, const GLuint* idx)
+        : m_idx_cnt(idx_cnt), m_memory(MemoryTag::GEOMETRY) {
+        glGenVertexArrays(1, &m_vao);
+        glBindVertexArray(m_vao);
+
+        glGenBuffers(1, &m_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        glBufferData(GL_ARRAY_BUFFER, vtx_cnt * sizeof(TexturedVertex), vtx,
+                     GL_STATIC_DRAW);
+        const GLsizei stride(sizeof(TexturedVertex));
+        char* const base(static_cast<char*>(0));
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride,
+                              base + offsetof(TexturedVertex, position));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride,
+                              base + offsetof(TexturedVertex, normal));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, stride,
+                              base + offsetof(TexturedVertex, texcoord));
+        glEnableVertexAttribArray(4);
+
+        glGenBuffers(1, &m_ibo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx_cnt * sizeof(GLuint), idx,
+                     GL_STATIC_DRAW);
+        m_memory.add(vtx_cnt * sizeof(TexturedVertex));
+        m_memory.add(idx_cnt * sizeof(GLuint));
+    }
+
+    virtual ~TexturedGeometry() {
+        glDeleteVertexArrays(1, &m_vao);
+        glDeleteBuffers(1, &m_vbo);
+        glDeleteBuffers(1, &m_ibo);
+    }
+
+    void draw(GLenum mode = GL_TRIANGLES) const {
+        glBindVertexArray(m_vao);
+        glDrawElements(mode, m_idx_cnt, GL_UNSIGNED_INT, 0);
+    }
+
+private:
+    TexturedGeometry(const TexturedGeometry& o);
+    TexturedGeometry& operator=(const TexturedGeometry& o);
+
+    GLuint m_vao;
+    GLuint m_vbo;
+    GLuint m_ibo;
+    const GLsizei m_idx_cnt;
+    MemoryRecord m_memory;
+};
+
+// ======================== Texture Compression ============================
+
+// S3TC block formats: 4x4 pixels in 8 (BC1, RGB) or 16 (BC3, RGBA) bytes.
+enum class BlockFormat { BC1, BC3 };
+
+inline GLenum CompressedFormat(BlockFormat format) {
+    return format == BlockFormat::BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+                                      : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+}
+
+inline std::size_t BlockBytes(BlockFormat format) {
+    return format == BlockFormat::BC1 ? 8 : 16;
+}
+
+inline std::size_t CompressedSize(GLsizei width, GLsizei height,
+                                  BlockFormat format) {
+    return static_cast<std::size_t>((width + 3) / 4) * ((height + 3) / 4) *
+           BlockBytes(format);
+}
+
+// Encodes 16 RGBA pixels (row-major) into a 4-color BC1 block, using the
+// inset bounding box of the colors as endpoints.
+inline void EncodeBC1Block(const GLubyte* rgba, GLubyte* out) {
+    GLubyte lo[4], hi[4];
+#if defined(__SSE2__) || defined(_M_X64)
+    __m128i mn(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba)));
+    __m128i mx(mn);
+    for (int i = 1; i < 4; i++) {
+        const __m128i p(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgba + i * 16)));
+        mn = _mm_min_epu8(mn, p);
+        mx = _mm_max_epu8(mx, p);
+    }
+    // reduce the four pixels per register
+    mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 8));
+    mn = _mm_min_epu8(mn, _mm_srli_si128(mn, 4));
+    mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 8));
+    mx = _mm_max_epu8(mx, _mm_srli_si128(mx, 4));
+    const int packed_lo(_mm_cvtsi128_si32(mn));
+    const int packed_hi(_mm_cvtsi128_si32(mx));
+    std::memcpy(lo, &packed_lo, 4);
+    std::memcpy(hi, &packed_hi, 4);
+#else
+    std::memcpy(lo, rgba, 4);
+    std::memcpy(hi, rgba, 4);
+    for (int i = 1; i < 16; i++) {
+        for (int c = 0; c < 4; c++) {
+            lo[c] = std::min(lo[c], rgba[i * 4 + c]);
+            hi[c] = std::max(hi[c], rgba[i * 4 + c]);
+        }
+    }
+#endif
+    for (int c = 0; c < 3; c++) {  // inset against outliers
+        const int inset((hi[c] - lo[c]) >> 4);
+        lo[c] = static_cast<GLubyte>(lo[c] + inset);
+        hi[c] = static_cast<GLubyte>(hi[c] - inset);
+    }
+    auto pack = [](const GLubyte* c) {
+        return static_cast<GLushort>((c[0] >> 3) << 11 | (c[1] >> 2) << 5 |
+                                     c[2] >> 3);
+    };
+    auto unpack = [](GLushort v, int* c) {
+        c[0] = (v >> 11) * 255 / 31;
+        c[1] = (v >> 5 & 63) * 255 / 63;
+        c[2] = (v & 31) * 255 / 31;
+    };
+    const GLushort c0(pack(hi)), c1(pack(lo));
+    out[0] = static_cast<GLubyte>(c0);
+    out[1] = static_cast<GLubyte>(c0 >> 8);
+    out[2] = static_cast<GLubyte>(c1);
+    out[3] = static_cast<GLubyte>(c1 >> 8);
+    std::uint32_t indices(0);
+    if (c0 > c1) {  // otherwise a flat block, all index 0
+        int p0[3], p1[3];
+        unpack(c0, p0);
+        unpack(c1, p1);
+        const int axis[3] = {p0[0] - p1[0], p0[1] - p1[1], p0[2] - p1[2]};
+        const int d1(axis[0] * p1[0] + axis[1] * p1[1] + axis[2] * p1[2]);
+        const int range(axis[0] * axis[0] + axis[1] * axis[1] +
+                        axis[2] * axis[2]);
+        int dots[16];
+#if defined(__SSE2__) || defined(_M_X64)
+        const __m128i zero(_mm_setzero_si128());
+        const __m128i w(_mm_setr_epi16(axis[0], axis[1], axis[2], 0, axis[0],
+                                       axis[1], axis[2], 0));
+        for (int i = 0; i < 4; i++) {
+            const __m128i p(_mm_loadu_si128(
+                reinterpret_cast<const __m128i*>(rgba + i * 16)));
+            // r*ar + g*ag and b*ab per pixel, then the pairs summed
+            const __m128i a(_mm_madd_epi16(_mm_unpacklo_epi8(p, zero), w));
+            const __m128i b(_mm_madd_epi16(_mm_unpackhi_epi8(p, zero), w));
+            const __m128i sum(_mm_add_epi32(
+                _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a),
+                                                _mm_castsi128_ps(b),
+                                                _MM_SHUFFLE(2, 0, 2, 0))),
+                _mm_castps_si128(_mm_shuffle_ps(_mm_castsi128_ps(a),
+                                                _mm_castsi128_ps(b),
+                                                _MM_SHUFFLE(3, 1, 3, 1)))));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dots + i * 4), sum);
+        }
+#else
+        for (int i = 0; i < 16; i++) {
+            dots[i] = axis[0] * rgba[i * 4] + axis[1] * rgba[i * 4 + 1] +
+                      axis[2] * rgba[i * 4 + 2];
+        }
+#endif
+        // position along c1 -> c0 in thirds, mapped to BC1 index order
+        static constexpr std::uint32_t order[4] = {1, 3, 2, 0};
+        for (int i = 0; i < 16; i++) {
+            const int s((3 * (dots[i] - d1) * 2 + range) / (2 * range));
+            indices |= order[std::min(std::max(s, 0), 3)] << (2 * i);
+        }
+    }
+    for (int i = 0; i < 4; i++) {
+        out[4 + i] = static_cast<GLubyte>(indices >> (8 * i));
+    }
+}
+
+// Encodes 16 RGBA pixels into a BC3 block: 8-value alpha then BC1 color.
+inline void EncodeBC3Block(const GLubyte* rgba, GLubyte* out) {
+    int a0(0), a1(255);
+    for (int i = 0; i < 16; i++) {
+        a0 = std::max(a0, static_cast<int>(rgba[i * 4 + 3]));
+        a1 = std::min(a1, static_cast<int>(rgba[i * 4 + 3]));
+    }
+    out[0] = static_cast<GLubyte>(a0);
+    out[1] = static_cast<GLubyte>(a1);
+    std::uint64_t indices(0);
+    if (a0 > a1) {
+        for (int i = 0; i < 16; i++) {
+            const int s(((rgba[i * 4 + 3] - a1) * 14 + (a0 - a1)) /
+                        (2 * (a0 - a1)));
+            const std::uint64_t index(s == 7 ? 0 : s == 0 ? 1 : 8 - s);
+            indices |= index << (3 * i);
+        }
+    }
+    for (int i = 0; i < 6; i++) {
+        out[2 + i] = static_cast<GLubyte>(indices >> (8 * i));
+    }
+    EncodeBC1Block(rgba, out + 8);
+}
+
+inline void DecodeBC1Block(const GLubyte* in, GLubyte* rgba) {
+    const int c0(in[0] | in[1] << 8), c1(in[2] | in[3] << 8);
+    int palette[4][4];
+    for (int k = 0; k < 2; k++) {
+        const int v(k == 0 ? c0 : c1);
+        palette[k][0] = (v >> 11) * 255 / 31;
+        palette[k][1] = (v >> 5 & 63) * 255 / 63;
+        palette[k][2] = (v & 31) * 255 / 31;
+        palette[k][3] = 255;
+    }
+    for (int c = 0; c < 4; c++) {
+        if (c0 > c1) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        } else {
+            palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+            palette[3][c] = 0;  // transparent black
+        }
+    }
+    const std::uint32_t indices(in[4] | in[5] << 8 | in[6] << 16 |
+                                static_cast<std::uint32_t>(in[7]) << 24);
+    for (int i = 0; i < 16; i++) {
+        const int* const p(palette[indices >> (2 * i) & 3]);
+        for (int c = 0; c < 4; c++) {
+            rgba[i * 4 + c] = static_cast<GLubyte>(p[c]);
+        }
+    }
+}
+
+inline void DecodeBC3Block(const GLubyte* in, GLubyte* rgba) {
+    DecodeBC1Block(in + 8, rgba);
+    const int a0(in[0]), a1(in[1]);
+    int palette[8] = {a0, a1};
+    for (int k = 1; k < 7; k++) {
+        palette[k + 1] = a0 > a1 ? ((7 - k) * a0 + k * a1) / 7
+                         : k < 5 ? ((5 - k) * a0 + k * a1) / 5
+                         : k == 5 ? 0
+                                  : 255;
+    }
+    std::uint64_t indices(0);
+    for (int i = 0; i < 6; i++) {
+        indices |= static_cast<std::uint64_t>(in[2 + i]) << (8 * i);
+    }
+    for (int i = 0; i < 16; i++) {
+        rgba[i * 4 + 3] = static_cast<GLubyte>(palette[indices >> (3 * i) & 7]);
+    }
+}
+
+// Compresses `image` block by block; edge blocks repeat the last row and
+// column. Rows of blocks are encoded in parallel.
+inline void CompressImage(const Image& image, BlockFormat format,
+                          std::vector<GLubyte>& out,
+                          ThreadPool& pool = DefaultThreadPool()) {
+    const Image rgba(ConvertChannels(image, 4));
+    const GLsizei bw((image.width + 3) / 4), bh((image.height + 3) / 4);
+    const std::size_t bytes(BlockBytes(format));
+    out.resize(CompressedSize(image.width, image.height, format));
+    pool.parallelFor(bh, [&](int by) {
+        GLubyte block[64];
+        for (GLsizei bx = 0; bx < bw; bx++) {
+            for (int y = 0; y < 4; y++) {
+                const GLubyte* const row(
+                    rgba.row(std::min(by * 4 + y, image.height - 1)));
+                for (int x = 0; x < 4; x++) {
+                    const GLsizei sx(std::min(bx * 4 + x, image.width - 1));
+                    std::memcpy(block + (y * 4 + x) * 4, row + sx * 4, 4);
+                }
+            }
+            GLubyte* const dst(&out[(by * bw + bx) * bytes]);
+            if (format == BlockFormat::BC1) {
+                EncodeBC1Block(block, dst);
+            } else {
+                EncodeBC3Block(block, dst);
+            }
+        }
+    });
+}
+
+// Fallback for contexts without S3TC: expands blocks back to RGBA.
+inline void DecompressImage(const GLubyte* blocks, GLsizei width,
+                            GLsizei height, BlockFormat format, Image& image) {
+    image = Image(width, height, 4);
+    const GLsizei bw((width + 3) / 4), bh((height + 3) / 4);
+    GLubyte block[64];
+    for (GLsizei by = 0; by < bh; by++) {
+        for (GLsizei bx = 0; bx < bw; bx++) {
+            const GLubyte* const src(blocks +
+                                     (by * bw + bx) * BlockBytes(format));
+            if (format == BlockFormat::BC1) {
+                DecodeBC1Block(src, block);
+            } else {
+                DecodeBC3Block(src, block);
+            }
+            for (int y = 0; y < 4 && by * 4 + y < height; y++) {
+                for (int x = 0; x < 4 && bx * 4 + x < width; x++) {
+                    std::memcpy(image.row(by * 4 + y) + (bx * 4 + x) * 4,
+                                block + (y * 4 + x) * 4, 4);
+                }
+            }
+        }
+    }
+}
+
+// Read-only view of a whole file, memory-mapped where the platform allows
+// and read into memory otherwise.
+class MappedFile {
+public:
+    explicit MappedFile(const std::string name) : m_data(nullptr), m_size(0) {
+#if defined(__unix__) || defined(__APPLE__)
+        const int fd(open(name.c_str(), O_RDONLY));
+        if (fd < 0) return;
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* const map(mmap(nullptr, static_cast<std::size_t>(st.st_size),
+                                 PROT_READ, MAP_PRIVATE, fd, 0));
+            if (map != MAP_FAILED) {
+                m_data = static_cast<const GLubyte*>(map);
+                m_size = static_cast<std::size_t>(st.st_size);
+            }
+        }
+        close(fd);
+#else
+        std::ifstream file(name, std::ios::binary);
+        if (file.fail()) return;
+        m_buffer.assign(std::istreambuf_iterator<char>(file),
+                        std::istreambuf_iterator<char>());
+        m_data = reinterpret_cast<const GLubyte*>(m_buffer.data());
+        m_size = m_buffer.size();
+#endif
+    }
+
+    virtual ~MappedFile() {
+#if defined(__unix__) || defined(__APPLE__)
+        if (m_data != nullptr) {
+            munmap(const_cast<GLubyte*>(m_data), m_size);
+        }
+#endif
+    }
+
+    const GLubyte* data() const { return m_data; }
+    std::size_t size() const { return m_size; }
+
+private:
+    MappedFile(const MappedFile& o);
+    MappedFile& operator=(const MappedFile& o);
+
+    const GLubyte* m_data;
+    std::size_t m_size;
+#if !defined(__unix__) && !defined(__APPLE__)
+    std::vector<char> m_buffer;
+#endif
+};
+
+// Transcoded texture cache, laid out like KTX2 (header, level index, then
+// block data of each level) so it can be mapped and uploaded in place. The
+// source size and modification time decide when it is stale.
+struct TextureCacheHeader {
+    char magic[8];  // "TGRTEX1"
+    std::uint32_t format;  // BlockFormat
+    std::uint32_t width;
+    std::uint32_t height;
+    std::uint32_t levels;
+    std::uint64_t source_size;
+    std::uint64_t source_time;
+    // followed by `levels` pairs of std::uint64_t: byte offset, byte length
+};
+
+inline bool SourceStamp(const std::string name, std::uint64_t& size,
+                        std::uint64_t& time) {
+    struct stat st;
+    if (stat(name.c_str(), &st) != 0) return false;
+    size = static_cast<std::uint64_t>(st.st_size);
+    time = static_cast<std::uint64_t>(st.st_mtime);
+    return true;
+}
+
+// Encodes `levels` into the layout of a texture cache file.
+inline void EncodeTextureCache(const std::vector<Image>& levels,
+                               BlockFormat format, std::uint64_t source_size,
+                               std::uint64_t source_time,
+                               std::vector<GLubyte>& cache,
+                               ThreadPool& pool = DefaultThreadPool()) {
+    TextureCacheHeader header = {
+        {'T', 'G', 'R', 'T', 'E', 'X', '1', '\0'},
+        static_cast<std::uint32_t>(format),
+        static_cast<std::uint32_t>(levels[0].width),
+        static_cast<std::uint32_t>(levels[0].height),
+        static_cast<std::uint32_t>(levels.size()),
+        source_size,
+        source_time};
+    std::vector<std::uint64_t> index;
+    std::uint64_t offset(sizeof header + 16 * levels.size());
+    for (const Image& level : levels) {
+        const std::uint64_t size(
+            CompressedSize(level.width, level.height, format));
+        index.emplace_back(offset);
+        index.emplace_back(size);
+        offset += size;
+    }
+    cache.resize(sizeof header + index.size() * sizeof index[0]);
+    std::memcpy(cache.data(), &header, sizeof header);
+    std::memcpy(cache.data() + sizeof header, index.data(),
+                index.size() * sizeof index[0]);
+    cache.reserve(static_cast<std::size_t>(offset));
+    std::vector<GLubyte> blocks;
+    for (const Image& level : levels) {
+        CompressImage(level, format, blocks, pool);
+        cache.insert(cache.end(), blocks.begin(), blocks.end());
+    }
+}
+
+inline bool WriteTextureCache(const std::string name,
+                              const std::vector<GLubyte>& cache) {
+    std::ofstream file(name, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(cache.data()), cache.size());
+    if (!file.good()) {
+        std::cerr << "Error: Can't write " << name << std::endl;
+        return false;
+    }
+    return true;
+}
+
+inline bool WriteTextureCache(const std::string name,
+                              const std::vector<Image>& levels,
+                              BlockFormat format, std::uint64_t source_size,
+                              std::uint64_t source_time,
+                              ThreadPool& pool = DefaultThreadPool()) {
+    std::vector<GLubyte> cache;
+    EncodeTextureCache(levels, format, source_size, source_time, cache, pool);
+    return WriteTextureCache(name, cache);
+}
+
+// Block-compressed 2D texture uploaded straight from a mapped cache file.
+// Without S3TC support the blocks are decoded to RGBA on the CPU.
+class CompressedTexture {
+public:
+    explicit CompressedTexture(const MappedFile& cache)
+        : CompressedTexture(cache.data(), cache.size()) {}
+
+    // From the contents of a cache file
+    CompressedTexture(const GLubyte* cache, std::size_t size)
+        : m_texture(0), m_memory(MemoryTag::TEXTURE) {
+        TextureCacheHeader header;
+        if (!Validate(cache, size, header)) return;
+        const BlockFormat format(static_cast<BlockFormat>(header.format));
+        const bool native(GLEW_EXT_texture_compression_s3tc);
+        glGenTextures(1, &m_texture);
+        glBindTexture(GL_TEXTURE_2D, m_texture);
+        const UnpackAlignment alignment(1);
+        GLsizei w(header.width), h(header.height);
+        for (std::uint32_t i = 0; i < header.levels; i++) {
+            std::uint64_t entry[2];
+            std::memcpy(entry, cache + sizeof header + 16 * i, sizeof entry);
+            const GLubyte* const blocks(cache + entry[0]);
+            if (native) {
+                glCompressedTexImage2D(GL_TEXTURE_2D, i,
+                                       CompressedFormat(format), w, h, 0,
+                                       static_cast<GLsizei>(entry[1]), blocks);
+                m_memory.add(entry[1]);
+            } else {
+                Image level;
+                DecompressImage(blocks, w, h, format, level);
+                glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA8, w, h, 0, GL_RGBA,
+                             GL_UNSIGNED_BYTE, level.pixels.data());
+                m_memory.add(level.pixels.size());
+            }
+            w = std::max(w / 2, 1);
+            h = std::max(h / 2, 1);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                        static_cast<GLint>(header.levels) - 1);
+        SetSampler(GL_TEXTURE_2D, header.levels > 1, GL_REPEAT);
+    }
+
+    virtual ~CompressedTexture() { glDeleteTextures(1, &m_texture); }
+
+    void bind(GLuint unit = 0) const {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(GL_TEXTURE_2D, m_texture);
+    }
+
+    GLuint id() const { return m_texture; }
+
+    // Checks the magic, that every level lies inside the file and that its
+    // length matches the level size computed from the header.
+    static bool Validate(const MappedFile& cache, TextureCacheHeader& header) {
+        return Validate(cache.data(), cache.size(), header);
+    }
+    static bool Validate(const GLubyte* cache, std::size_t size,
+                         TextureCacheHeader& header) {
+        if (cache == nullptr || size < sizeof header) return false;
+        std::memcpy(&header, cache, sizeof header);
+        if (std::memcmp(header.magic, "TGRTEX1", 8) != 0 ||
+            header.format > 1 || header.levels == 0 || header.levels > 32 ||
+            header.width == 0 || header.height == 0 ||
+            header.width > 1u << 16 || header.height > 1u << 16 ||
+            size < sizeof header + 16 * header.levels) {
+            return false;
+        }
+        const BlockFormat format(static_cast<BlockFormat>(header.format));
+        GLsizei w(header.width), h(header.height);
+        for (std::uint32_t i = 0; i < header.levels; i++) {
+            std::uint64_t entry[2];
+            std::memcpy(entry, cache + sizeof header + 16 * i, sizeof entry);
+            if (entry[0] > size || entry[1] > size - entry[0] ||
+                entry[1] != CompressedSize(w, h, format)) {
+                return false;
+            }
+            w = std::max(w / 2, 1);
+            h = std::max(h / 2, 1);
+        }
+        return true;
+    }
+
+private:
+    CompressedTexture(const CompressedTexture& o);
+    CompressedTexture& operator=(const CompressedTexture& o);
+
+    GLuint m_texture;
+    MemoryRecord m_memory;
+};
+
+// Loads `name` through the cache file `cache`, transcoding (with mipmaps)
+// only when the cache is missing or older than the source. A cache that
+// can't be written is reported and the transcoded levels used anyway.
+inline std::unique_ptr<const CompressedTexture> LoadCompressedTexture(
+    const std::string name, const std::string cache,
+    BlockFormat format = BlockFormat::BC1,
+    MipFilter filter = MipFilter::BOX) {
+    std::uint64_t size(0), time(0);
+    const bool source(SourceStamp(name, size, time));
+    {
+        MappedFile mapped(cache);
+        TextureCacheHeader header;
+        if (CompressedTexture::Validate(mapped, header) &&
+            header.format == static_cast<std::uint32_t>(format) &&
+            (!source ||
+             (header.source_size == size && header.source_time == time))) {
+            return std::unique_ptr<const CompressedTexture>(
+                new CompressedTexture(mapped));
+        }
+    }
+    std::vector<Image> levels(1);
+    if (!ReadImage(name, levels[0])) return nullptr;
+    GenerateMipmaps(levels, filter);
+    std::vector<GLubyte> encoded;
+    EncodeTextureCache(levels, format, size, time, encoded);
+    WriteTextureCache(cache, encoded);
+    return std::unique_ptr<const CompressedTexture>(
+        new CompressedTexture(encoded.data(), encoded.size()));
+}
+
+// ============================= Regression ================================
+
+// Perceptual difference of two images in CIELAB (delta E 1976, where about
+// 2.3 is just noticeable).
+struct ImageDiff {
+    double mean;  // average delta E
+    double max;
+    double bad_fraction;  // pixels above the tolerance
+};
+
+inline void ToLab(const GLubyte* rgb, double* lab) {
+    double c[3];
+    for (int k = 0; k < 3; k++) {
+        const double v(rgb[k] / 255.0);
+        c[k] = v <= 0.04045 ? v / 12.92 : std::pow((v + 0.055) / 1.055, 2.4);
+    }
+    const double xyz[3] = {
+        (0.4124 * c[0] + 0.3576 * c[1] + 0.1805 * c[2]) / 0.95047,
+        0.2126 * c[0] + 0.7152 * c[1] + 0.0722 * c[2],
+        (0.0193 * c[0] + 0.1192 * c[1] + 0.9505 * c[2]) / 1.08883};
+    double f[3];
+    for (int k = 0; k < 3; k++) {
+        f[k] = xyz[k] > 0.008856 ? std::cbrt(xyz[k])
+                                 : 7.787 * xyz[k] + 16.0 / 116.0;
+    }
+    lab[0] = 116.0 * f[1] - 16.0;
+    lab[1] = 500.0 * (f[0] - f[1]);
+    lab[2] = 200.0 * (f[1] - f[2]);
+}
+
+// Images of different sizes differ everywhere.
+inline ImageDiff CompareImages(const Image& a, const Image& b,
+                               double tolerance = 2.3) {
+    ImageDiff diff = {0.0, 0.0, 0.0};
+    if (a.width != b.width || a.height != b.height) {
+        diff.mean = diff.max = std::numeric_limits<double>::infinity();
+        diff.bad_fraction = 1.0;
+        return diff;
+    }
+    const Image ra(ConvertChannels(a, 3)), rb(ConvertChannels(b, 3));
+    const std::size_t n(static_cast<std::size_t>(a.width) * a.height);
+    std::size_t bad(0);
+    for (std::size_t i = 0; i < n; i++) {
+        double la[3], lb[3];
+        ToLab(&ra.pixels[i * 3], la);
+        ToLab(&rb.pixels[i * 3], lb);
+        const double d(std::sqrt((la[0] - lb[0]) * (la[0] - lb[0]) +
+                                 (la[1] - lb[1]) * (la[1] - lb[1]) +
+                                 (la[2] - lb[2]) * (la[2] - lb[2])));
+        diff.mean += d;
+        diff.max = std::max(diff.max, d);
+        if (d > tolerance) bad++;
+    }
+    diff.mean /= std::max<std::size_t>(n, 1);
+    diff.bad_fraction = static_cast<double>(bad) / std::max<std::size_t>(n, 1);
+    return diff;
+}
+
+// Summary of the per-frame times written by a captured run.
+struct FrameStats {
+    std::size_t frames;
+    double mean;
+    double median;
+    double p95;
+};
+
+inline bool ReadFrameStats(const std::string name, FrameStats& stats) {
+    std::ifstream file(name);
+    if (file.fail()) {
+        std::cerr << "Error: Can't open " << name << std::endl;
+        return false;
+    }
+    file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    std::vector<double> times;
+    for (double t; file >> t;) times.emplace_back(t);
+    stats = {times.size(), 0.0, 0.0, 0.0};
+    if (times.empty()) return false;
+    std::sort(times.begin(), times.end());
+    for (const double t : times) stats.mean += t;
+    stats.mean /= times.size();
+    stats.median = times[times.size() / 2];
+    stats.p95 = times[std::min(times.size() - 1, times.size() * 95 / 100)];
+    return true;
+}
+
+// ============================== Replay ===================================
+
+// Time spent per recorded call and per frame by ReplayTrace().
+struct TraceStats {
+    std::vector<double> frame_ms;
+    std::uint64_t calls[static_cast<int>(TraceOp::COUNT)];
+    double seconds[static_cast<int>(TraceOp::COUNT)];
+};
+
+inline bool ReadTraceHeader(const std::string name, TraceHeader& header) {
+    std::ifstream file(name, std::ios::binary);
+    if (file.fail()) {
+        std::cerr << "Error: Can't open " << name << std::endl;
+        return false;
+    }
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof header) ||
+        std::strncmp(header.magic, "TGRTRC1", 8) != 0) {
+        std::cerr << "Error: " << name << " is not a trace" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Reads the records of a trace in place.
+class TraceReader {
+public:
+    TraceReader(const GLubyte* data, std::size_t size)
+        : m_p(data), m_end(data + size), m_ok(true) {}
+
+    template <typename T>
+    T get() {
+        T v = T();
+        if (!take(sizeof v)) return v;
+        std::memcpy(&v, m_p - sizeof v, sizeof v);
+        return v;
+    }
+
+    TraceBlob blob() {
+        const std::uint64_t size(get<std::uint64_t>());
+        if (!take(size)) return {nullptr, 0};
+        return {m_p - size, size};
+    }
+
+    std::string string() {
+        const TraceBlob b(blob());
+        return std::string(static_cast<const char*>(b.data), b.size);
+    }
+
+    bool ok() const { return m_ok; }
+
+private:
+    bool take(std::uint64_t size) {
+        if (!m_ok || static_cast<std::uint64_t>(m_end - m_p) < size) {
+            m_ok = false;
+            return false;
+        }
+        m_p += size;
+        return true;
+    }
+
+    const GLubyte* m_p;
+    const GLubyte* const m_end;
+    bool m_ok;
+};
+
+// Recorded object names mapped to the ones created while replaying.
+class TraceNameMap {
+public:
+    GLuint operator()(GLuint name) const {
+        const auto it(m_names.find(name));
+        return it == m_names.end() ? name : it->second;
+    }
+
+    template <typename Gen>
+    void generate(const TraceBlob& recorded, Gen gen) {
+        const GLsizei n(static_cast<GLsizei>(recorded.size / sizeof(GLuint)));
+        std::vector<GLuint> names(n);
+        gen(n, names.data());
+        for (GLsizei i = 0; i < n; i++) {
+            m_names[Name(recorded, i)] = names[i];
+        }
+    }
+
+    template <typename Delete>
+    void remove(const TraceBlob& recorded, Delete del) {
+        const GLsizei n(static_cast<GLsizei>(recorded.size / sizeof(GLuint)));
+        std::vector<GLuint> names(n);
+        for (GLsizei i = 0; i < n; i++) {
+            const GLuint name(Name(recorded, i));
+            names[i] = (*this)(name);
+            m_names.erase(name);
+        }
+        del(n, names.data());
+    }
+
+    void set(GLuint recorded, GLuint name) { m_names[recorded] = name; }
+
+private:
+    static GLuint Name(const TraceBlob& blob, GLsizei i) {
+        GLuint name;
+        std::memcpy(&name, static_cast<const char*>(blob.data) +
+                               i * sizeof(GLuint),
+                    sizeof name);
+        return name;
+    }
+
+    std::unordered_map<GLuint, GLuint> m_names;
+};
+
+// Plays a trace written by TraceRecorder back on the current context as
+// fast as it can, timing every call. Frame times include a glFinish() at
+// each recorded frame end; with `sync` every call is finished too, so its
+// time includes the GPU work rather than only the driver's.
+inline bool ReplayTrace(const std::string name, TraceStats& stats,
+                        bool sync = false) {
+    stats.frame_ms.clear();
+    std::fill(std::begin(stats.calls), std::end(stats.calls), 0);
+    std::fill(std::begin(stats.seconds), std::end(stats.seconds), 0.0);
+    TraceHeader header;
+    if (!ReadTraceHeader(name, header)) return false;
+    const MappedFile file(name);
+    if (file.size() < sizeof header) return false;
+    TraceReader in(file.data() + sizeof header, file.size() - sizeof header);
+
+    TraceNameMap buffers, arrays, textures, framebuffers, renderbuffers;
+    TraceNameMap queries, shaders, programs;
+    // the recorded window draws into DefaultFramebuffer(), so an offscreen
+    // one set by the caller measures them without a visible window
+    framebuffers.set(0, DefaultFramebuffer());
+    glBindFramebuffer(GL_FRAMEBUFFER, DefaultFramebuffer());
+    // per program, recorded uniform locations and block indices
+    std::unordered_map<GLuint, std::unordered_map<GLint, GLint>> locations;
+    std::unordered_map<GLuint, std::unordered_map<GLuint, GLuint>> blocks;
+    std::unordered_map<GLenum, GLuint> bound;  // buffer bindings
+    GLuint program(0);  // recorded name
+    std::vector<GLubyte> pixels;
+    std::vector<const void*> offsets;
+    const auto location = [&](GLint recorded) {
+        const auto& l(locations[program]);
+        const auto it(l.find(recorded));
+        return it == l.end() ? recorded : it->second;
+    };
+    const auto block = [&](GLuint p, GLuint recorded) {
+        const auto& b(blocks[p]);
+        const auto it(b.find(recorded));
+        return it == b.end() ? recorded : it->second;
+    };
+    // the window's back buffer is the color attachment of an offscreen one
+    const auto window_buffer = [](GLenum buffer) {
+        return DefaultFramebuffer() != 0 && buffer == GL_BACK
+                   ? GLenum(GL_COLOR_ATTACHMENT0)
+                   : buffer;
+    };
+    const auto pointer = [](std::uint64_t offset) {
+        return reinterpret_cast<const void*>(
+            static_cast<std::uintptr_t>(offset));
+    };
+
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point frame_start(Clock::now());
+    for (;;) {
+        const TraceOp op(in.get<TraceOp>());
+        if (!in.ok()) {
+            std::cerr << "Error: " << name << " is truncated" << std::endl;
+            return false;
+        }
+        if (op == TraceOp::END) break;
+        const Clock::time_point start(Clock::now());
+        switch (op) {
+            case TraceOp::FRAME: {
+                glFinish();
+                const Clock::time_point now(Clock::now());
+                stats.frame_ms.emplace_back(
+                    std::chrono::duration<double, std::milli>(now -
+                                                              frame_start)
+                        .count());
+                frame_start = now;
+                break;
+            }
+            case TraceOp::ENABLE:
+                glEnable(in.get<GLenum>());
+                break;
+            case TraceOp::DISABLE:
+                glDisable(in.get<GLenum>());
+                break;
+            case TraceOp::DEPTH_FUNC:
+                glDepthFunc(in.get<GLenum>());
+                break;
+            case TraceOp::DEPTH_MASK:
+                glDepthMask(in.get<GLboolean>());
+                break;
+            case TraceOp::COLOR_MASK: {
+                const GLboolean r(in.get<GLboolean>());
+                const GLboolean g(in.get<GLboolean>());
+                const GLboolean b(in.get<GLboolean>());
+                glColorMask(r, g, b, in.get<GLboolean>());
+                break;
+            }
+            case TraceOp::CULL_FACE:
+                glCullFace(in.get<GLenum>());
+                break;
+            case TraceOp::FRONT_FACE:
+                glFrontFace(in.get<GLenum>());
+                break;
+            case TraceOp::BLEND_FUNC: {
+                const GLenum s(in.get<GLenum>());
+                glBlendFunc(s, in.get<GLenum>());
+                break;
+            }
+            case TraceOp::VIEWPORT: {
+                const GLint x(in.get<GLint>()), y(in.get<GLint>());
+                const GLsizei w(in.get<GLsizei>());
+                glViewport(x, y, w, in.get<GLsizei>());
+                break;
+            }
+            case TraceOp::CLEAR_COLOR: {
+                const GLfloat r(in.get<GLfloat>()), g(in.get<GLfloat>());
+                const GLfloat b(in.get<GLfloat>());
+                glClearColor(r, g, b, in.get<GLfloat>());
+                break;
+            }
+            case TraceOp::CLEAR_DEPTH:
+                glClearDepth(in.get<GLdouble>());
+                break;
+            case TraceOp::CLEAR:
+                glClear(in.get<GLbitfield>());
+                break;
+            case TraceOp::PIXEL_STORE: {
+                const GLenum pname(in.get<GLenum>());
+                glPixelStorei(pname, in.get<GLint>());
+                break;
+            }
+            case TraceOp::FINISH:
+                glFinish();
+                break;
+            case TraceOp::GEN_BUFFERS:
+                buffers.generate(in.blob(), glGenBuffers);
+                break;
+            case TraceOp::DELETE_BUFFERS:
+                buffers.remove(in.blob(), glDeleteBuffers);
+                break;
+            case TraceOp::BIND_BUFFER: {
+                const GLenum target(in.get<GLenum>());
+                bound[target] = buffers(in.get<GLuint>());
+                glBindBuffer(target, bound[target]);
+                break;
+            }
+            case TraceOp::BIND_BUFFER_RANGE: {
+                const GLenum target(in.get<GLenum>());
+                const GLuint index(in.get<GLuint>());
+                bound[target] = buffers(in.get<GLuint>());
+                const std::int64_t offset(in.get<std::int64_t>());
+                glBindBufferRange(target, index, bound[target],
+                                  static_cast<GLintptr>(offset),
+                                  static_cast<GLsizeiptr>(
+                                      in.get<std::int64_t>()));
+                break;
+            }
+            case TraceOp::BUFFER_DATA: {
+                const GLenum target(in.get<GLenum>());
+                const std::int64_t size(in.get<std::int64_t>());
+                const TraceBlob data(in.blob());
+                glBufferData(target, static_cast<GLsizeiptr>(size),
+                             data.size != 0 ? data.data : nullptr,
+                             in.get<GLenum>());
+                break;
+            }
+            case TraceOp::BUFFER_SUB_DATA: {
+                const GLenum target(in.get<GLenum>());
+                const std::int64_t offset(in.get<std::int64_t>());
+                const TraceBlob data(in.blob());
+                glBufferSubData(target, static_cast<GLintptr>(offset),
+                                static_cast<GLsizeiptr>(data.size),
+                                data.data);
+                break;
+            }
+            case TraceOp::BUFFER_UPDATE: {
+                // written through the copy binding, which is put back
+                const GLuint buffer(buffers(in.get<GLuint>()));
+                const std::uint64_t offset(in.get<std::uint64_t>());
+                const TraceBlob data(in.blob());
+                glBindBuffer(GL_COPY_WRITE_BUFFER, buffer);
+                glBufferSubData(GL_COPY_WRITE_BUFFER,
+                                static_cast<GLintptr>(offset),
+                                static_cast<GLsizeiptr>(data.size),
+                                data.data);
+                glBindBuffer(GL_COPY_WRITE_BUFFER,
+                             bound[GL_COPY_WRITE_BUFFER]);
+                break;
+            }
+            case TraceOp::GEN_VERTEX_ARRAYS:
+                arrays.generate(in.blob(), glGenVertexArrays);
+                break;
+            case TraceOp::DELETE_VERTEX_ARRAYS:
+                arrays.remove(in.blob(), glDeleteVertexArrays);
+                break;
+            case TraceOp::BIND_VERTEX_ARRAY:
+                glBindVertexArray(arrays(in.get<GLuint>()));
+                break;
+            case TraceOp::VERTEX_ATTRIB_POINTER: {
+                const GLuint index(in.get<GLuint>());
+                const GLint size(in.get<GLint>());
+                const GLenum type(in.get<GLenum>());
+                const GLboolean normalized(in.get<GLboolean>());
+                const GLsizei stride(in.get<GLsizei>());
+                glVertexAttribPointer(index, size, type, normalized, stride,
+                                      pointer(in.get<std::uint64_t>()));
+                break;
+            }
+            case TraceOp::VERTEX_ATTRIB_I_POINTER: {
+                const GLuint index(in.get<GLuint>());
+                const GLint size(in.get<GLint>());
+                const GLenum type(in.get<GLenum>());
+                const GLsizei stride(in.get<GLsizei>());
+                glVertexAttribIPointer(index, size, type, stride,
+                                       pointer(in.get<std::uint64_t>()));
+                break;
+            }
+            case TraceOp::ENABLE_VERTEX_ATTRIB_ARRAY:
+                glEnableVertexAttribArray(in.get<GLuint>());
+                break;
+            case TraceOp::GEN_TEXTURES:
+                textures.generate(in.blob(), glGenTextures);
+                break;
+            case TraceOp::DELETE_TEXTURES:
+                textures.remove(in.blob(), glDeleteTextures);
+                break;
+            case TraceOp::BIND_TEXTURE: {
+                const GLenum target(in.get<GLenum>());
+                glBindTexture(target, textures(in.get<GLuint>()));
+                break;
+            }
+            case TraceOp::ACTIVE_TEXTURE:
+                glActiveTexture(in.get<GLenum>());
+                break;
+            case TraceOp::TEX_PARAMETER: {
+                const GLenum target(in.get<GLenum>());
+                const GLenum pname(in.get<GLenum>());
+                glTexParameteri(target, pname, in.get<GLint>());
+                break;
+            }
+            case TraceOp::TEX_IMAGE_2D: {
+                const GLenum target(in.get<GLenum>());
+                const GLint level(in.get<GLint>());
+                const GLint internal(in.get<GLint>());
+                const GLsizei w(in.get<GLsizei>()), h(in.get<GLsizei>());
+                const GLenum format(in.get<GLenum>());
+                const GLenum type(in.get<GLenum>());
+                const TraceBlob data(in.blob());
+                glTexImage2D(target, level, internal, w, h, 0, format, type,
+                             data.size != 0 ? data.data : nullptr);
+                break;
+            }
+            case TraceOp::TEX_IMAGE_3D: {
+                const GLenum target(in.get<GLenum>());
+                const GLint level(in.get<GLint>());
+                const GLint internal(in.get<GLint>());
+                const GLsizei w(in.get<GLsizei>()), h(in.get<GLsizei>());
+                const GLsizei d(in.get<GLsizei>());
+                const GLenum format(in.get<GLenum>());
+                const GLenum type(in.get<GLenum>());
+                const TraceBlob data(in.blob());
+                glTexImage3D(target, level, internal, w, h, d, 0, format,
+                             type, data.size != 0 ? data.data : nullptr);
+                break;
+            }
+            case TraceOp::TEX_SUB_IMAGE_3D: {
+                const GLenum target(in.get<GLenum>());
+                const GLint level(in.get<GLint>());
+                const GLint x(in.get<GLint>()), y(in.get<GLint>());
+                const GLint z(in.get<GLint>());
+                const GLsizei w(in.get<GLsizei>()), h(in.get<GLsizei>());
+                const GLsizei d(in.get<GLsizei>());
+                const GLenum format(in.get<GLenum>());
+                const GLenum type(in.get<GLenum>());
+                glTexSubImage3D(target, level, x, y, z, w, h, d, format, type,
+                                in.blob().data);
+                break;
+            }
+            case TraceOp::COMPRESSED_TEX_IMAGE_2D: {
+                const GLenum target(in.get<GLenum>());
+                const GLint level(in.get<GLint>());
+                const GLenum internal(in.get<GLenum>());
+                const GLsizei w(in.get<GLsizei>()), h(in.get<GLsizei>());
+                const TraceBlob data(in.blob());
+                glCompressedTexImage2D(target, level, internal, w, h, 0,
+                                       static_cast<GLsizei>(data.size),
+                                       data.data);
+                break;
+            }
+            case TraceOp::TEX_BUFFER: {
+                const GLenum target(in.get<GLenum>());
+                const GLenum internal(in.get<GLenum>());
+                glTexBuffer(target, internal, buffers(in.get<GLuint>()));
+                break;
+            }
+            case TraceOp::GEN_FRAMEBUFFERS:
+                framebuffers.generate(in.blob(), glGenFramebuffers);
+                break;
+            case TraceOp::DELETE_FRAMEBUFFERS:
+                framebuffers.remove(in.blob(), glDeleteFramebuffers);
+                break;
+            case TraceOp::BIND_FRAMEBUFFER: {
+                const GLenum target(in.get<GLenum>());
+                glBindFramebuffer(target, framebuffers(in.get<GLuint>()));
+                break;
+            }
+            case TraceOp::FRAMEBUFFER_TEXTURE_2D: {
+                const GLenum target(in.get<GLenum>());
+                const GLenum attachment(in.get<GLenum>());
+                const GLenum textarget(in.get<GLenum>());
+                const GLuint texture(textures(in.get<GLuint>()));
+                glFramebufferTexture2D(target, attachment, textarget, texture,
+                                       in.get<GLint>());
+                break;
+            }
+            case TraceOp::GEN_RENDERBUFFERS:
+                renderbuffers.generate(in.blob(), glGenRenderbuffers);
+                break;
+            case TraceOp::DELETE_RENDERBUFFERS:
+                renderbuffers.remove(in.blob(), glDeleteRenderbuffers);
+                break;
+            case TraceOp::BIND_RENDERBUFFER: {
+                const GLenum target(in.get<GLenum>());
+                glBindRenderbuffer(target, renderbuffers(in.get<GLuint>()));
+                break;
+            }
+            case TraceOp::RENDERBUFFER_STORAGE_MULTISAMPLE: {
+                const GLenum target(in.get<GLenum>());
+                const GLsizei samples(in.get<GLsizei>());
+                const GLenum internal(in.get<GLenum>());
+                const GLsizei w(in.get<GLsizei>());
+                glRenderbufferStorageMultisample(target, samples, internal, w,
+                                                 in.get<GLsizei>());
+                break;
+            }
+            case TraceOp::FRAMEBUFFER_RENDERBUFFER: {
+                const GLenum target(in.get<GLenum>());
+                const GLenum attachment(in.get<GLenum>());
+                const GLenum rbtarget(in.get<GLenum>());
+                glFramebufferRenderbuffer(target, attachment, rbtarget,
+                                          renderbuffers(in.get<GLuint>()));
+                break;
+            }
+            case TraceOp::DRAW_BUFFERS: {
+                const TraceBlob bufs(in.blob());
+                std::vector<GLenum> b(bufs.size / sizeof(GLenum));
+                if (!b.empty()) std::memcpy(b.data(), bufs.data, bufs.size);
+                glDrawBuffers(static_cast<GLsizei>(b.size()), b.data());
+                break;
+            }
+            case TraceOp::DRAW_BUFFER:
+                glDrawBuffer(window_buffer(in.get<GLenum>()));
+                break;
+            case TraceOp::READ_BUFFER:
+                glReadBuffer(window_buffer(in.get<GLenum>()));
+                break;
+            case TraceOp::BLIT_FRAMEBUFFER: {
+                GLint r[8];
+                for (GLint& v : r) v = in.get<GLint>();
+                const GLbitfield mask(in.get<GLbitfield>());
+                glBlitFramebuffer(r[0], r[1], r[2], r[3], r[4], r[5], r[6],
+                                  r[7], mask, in.get<GLenum>());
+                break;
+            }
+            case TraceOp::CLEAR_BUFFER: {
+                const GLenum buffer(in.get<GLenum>());
+                const GLint drawbuffer(in.get<GLint>());
+                const TraceBlob value(in.blob());
+                GLuint v[4] = {0, 0, 0, 0};
+                std::memcpy(v, value.data,
+                            std::min<std::size_t>(value.size, sizeof v));
+                glClearBufferuiv(buffer, drawbuffer, v);
+                break;
+            }
+            case TraceOp::READ_PIXELS: {
+                const GLint x(in.get<GLint>()), y(in.get<GLint>());
+                const GLsizei w(in.get<GLsizei>()), h(in.get<GLsizei>());
+                const GLenum format(in.get<GLenum>());
+                const GLenum type(in.get<GLenum>());
+                const bool pbo(in.get<GLint>() != 0);
+                const std::uint64_t offset(in.get<std::uint64_t>());
+                const std::uint64_t size(in.get<std::uint64_t>());
+                if (!pbo && pixels.size() < size) pixels.resize(size);
+                glReadPixels(x, y, w, h, format, type,
+                             pbo ? const_cast<void*>(pointer(offset))
+                                 : pixels.data());
+                break;
+            }
+            case TraceOp::CREATE_SHADER: {
+                const GLenum type(in.get<GLenum>());
+                shaders.set(in.get<GLuint>(), glCreateShader(type));
+                break;
+            }
+            case TraceOp::SHADER_SOURCE: {
+                const GLuint shader(shaders(in.get<GLuint>()));
+                const TraceBlob source(in.blob());
+                const GLchar* const s(
+                    static_cast<const GLchar*>(source.data));
+                const GLint length(static_cast<GLint>(source.size));
+                glShaderSource(shader, 1, &s, &length);
+                break;
+            }
+            case TraceOp::COMPILE_SHADER:
+                glCompileShader(shaders(in.get<GLuint>()));
+                break;
+            case TraceOp::DELETE_SHADER:
+                glDeleteShader(shaders(in.get<GLuint>()));
+                break;
+            case TraceOp::CREATE_PROGRAM:
+                programs.set(in.get<GLuint>(), glCreateProgram());
+                break;
+            case TraceOp::ATTACH_SHADER: {
+                const GLuint p(programs(in.get<GLuint>()));
+                glAttachShader(p, shaders(in.get<GLuint>()));
+                break;
+            }
+            case TraceOp::BIND_ATTRIB_LOCATION: {
+                const GLuint p(programs(in.get<GLuint>()));
+                const GLuint index(in.get<GLuint>());
+                glBindAttribLocation(p, index, in.string().c_str());
+                break;
+            }
+            case TraceOp::BIND_FRAG_DATA_LOCATION: {
+                const GLuint p(programs(in.get<GLuint>()));
+                const GLuint color(in.get<GLuint>());
+                glBindFragDataLocation(p, color, in.string().c_str());
+                break;
+            }
+            case TraceOp::LINK_PROGRAM:
+                glLinkProgram(programs(in.get<GLuint>()));
+                break;
+            case TraceOp::DELETE_PROGRAM: {
+                const GLuint p(in.get<GLuint>());
+                glDeleteProgram(programs(p));
+                locations.erase(p);
+                blocks.erase(p);
+                break;
+            }
+            case TraceOp::USE_PROGRAM:
+                program = in.get<GLuint>();
+                glUseProgram(programs(program));
+                break;
+            case TraceOp::UNIFORM_LOCATION: {
+                const GLuint p(in.get<GLuint>());
+                const GLint recorded(in.get<GLint>());
+                locations[p][recorded] =
+                    glGetUniformLocation(programs(p), in.string().c_str());
+                break;
+            }
+            case TraceOp::UNIFORM_BLOCK_INDEX: {
+                const GLuint p(in.get<GLuint>());
+                const GLuint recorded(in.get<GLuint>());
+                blocks[p][recorded] =
+                    glGetUniformBlockIndex(programs(p), in.string().c_str());
+                break;
+            }
+            case TraceOp::UNIFORM_BLOCK_BINDING: {
+                const GLuint p(in.get<GLuint>());
+                const GLuint index(block(p, in.get<GLuint>()));
+                glUniformBlockBinding(programs(p), index, in.get<GLuint>());
+                break;
+            }
+            case TraceOp::UNIFORM_FLOAT: {
+                const GLint l(location(in.get<GLint>()));
+                const GLint components(in.get<GLint>());
+                const TraceBlob data(in.blob());
+                const GLfloat* const v(static_cast<const GLfloat*>(data.data));
+                const GLsizei count(static_cast<GLsizei>(
+                    data.size / (sizeof(GLfloat) * std::max(components, 1))));
+                switch (components) {
+                    case 1:
+                        glUniform1fv(l, count, v);
+                        break;
+                    case 2:
+                        glUniform2fv(l, count, v);
+                        break;
+                    case 3:
+                        glUniform3fv(l, count, v);
+                        break;
+                    case 4:
+                        glUniform4fv(l, count, v);
+                        break;
+                }
+                break;
+            }
+            case TraceOp::UNIFORM_INT: {
+                const GLint l(location(in.get<GLint>()));
+                const GLint components(in.get<GLint>());
+                const TraceBlob data(in.blob());
+                const GLint* const v(static_cast<const GLint*>(data.data));
+                const GLsizei count(static_cast<GLsizei>(
+                    data.size / (sizeof(GLint) * std::max(components, 1))));
+                switch (components) {
+                    case 1:
+                        glUniform1iv(l, count, v);
+                        break;
+                    case 2:
+                        glUniform2iv(l, count, v);
+                        break;
+                    case 3:
+                        glUniform3iv(l, count, v);
+                        break;
+                    case 4:
+                        glUniform4iv(l, count, v);
+                        break;
+                }
+                break;
+            }
+            case TraceOp::UNIFORM_MATRIX: {
+                const GLint l(location(in.get<GLint>()));
+                const GLint n(in.get<GLint>());
+                const GLboolean transpose(in.get<GLboolean>());
+                const TraceBlob data(in.blob());
+                const GLfloat* const v(static_cast<const GLfloat*>(data.data));
+                const GLsizei count(static_cast<GLsizei>(
+                    data.size / (sizeof(GLfloat) * n * n)));
+                if (n == 2) glUniformMatrix2fv(l, count, transpose, v);
+                if (n == 3) glUniformMatrix3fv(l, count, transpose, v);
+                if (n == 4) glUniformMatrix4fv(l, count, transpose, v);
+                break;
+            }
+            case TraceOp::GEN_QUERIES:
+                queries.generate(in.blob(), glGenQueries);
+                break;
+            case TraceOp::DELETE_QUERIES:
+                queries.remove(in.blob(), glDeleteQueries);
+                break;
+            case TraceOp::BEGIN_QUERY: {
+                const GLenum target(in.get<GLenum>());
+                glBeginQuery(target, queries(in.get<GLuint>()));
+                break;
+            }
+            case TraceOp::END_QUERY:
+                glEndQuery(in.get<GLenum>());
+                break;
+            case TraceOp::BEGIN_CONDITIONAL_RENDER: {
+                const GLuint id(queries(in.get<GLuint>()));
+                glBeginConditionalRender(id, in.get<GLenum>());
+                break;
+            }
+            case TraceOp::END_CONDITIONAL_RENDER:
+                glEndConditionalRender();
+                break;
+            case TraceOp::DRAW_ARRAYS: {
+                const GLenum mode(in.get<GLenum>());
+                const GLint first(in.get<GLint>());
+                glDrawArrays(mode, first, in.get<GLsizei>());
+                break;
+            }
+            case TraceOp::DRAW_ELEMENTS: {
+                const GLenum mode(in.get<GLenum>());
+                const GLsizei count(in.get<GLsizei>());
+                const GLenum type(in.get<GLenum>());
+                glDrawElements(mode, count, type,
+                               pointer(in.get<std::uint64_t>()));
+                break;
+            }
+            case TraceOp::DRAW_ELEMENTS_BASE_VERTEX: {
+                const GLenum mode(in.get<GLenum>());
+                const GLsizei count(in.get<GLsizei>());
+                const GLenum type(in.get<GLenum>());
+                const void* const indices(pointer(in.get<std::uint64_t>()));
+                glDrawElementsBaseVertex(mode, count, type, indices,
+                                         in.get<GLint>());
+                break;
+            }
+            case TraceOp::MULTI_DRAW_ELEMENTS: {
+                const GLenum mode(in.get<GLenum>());
+                const GLenum type(in.get<GLenum>());
+                const TraceBlob counts(in.blob());
+                const TraceBlob indices(in.blob());
+                const std::size_t n(counts.size / sizeof(GLsizei));
+                std::vector<GLsizei> c(n);
+                offsets.resize(n);
+                for (std::size_t i = 0; i < n; i++) {
+                    std::uint64_t offset;
+                    std::memcpy(&c[i],
+                                static_cast<const char*>(counts.data) +
+                                    i * sizeof(GLsizei),
+                                sizeof(GLsizei));
+                    std::memcpy(&offset,
+                                static_cast<const char*>(indices.data) +
+                                    i * sizeof offset,
+                                sizeof offset);
+                    offsets[i] = pointer(offset);
+                }
+                glMultiDrawElements(mode, c.data(), type, offsets.data(),
+                                    static_cast<GLsizei>(n));
+                break;
+            }
+            default:
+                std::cerr << "Error: Unknown call "
+                          << static_cast<int>(op) << " in " << name
+                          << std::endl;
+                return false;
+        }
+        if (sync && op != TraceOp::FRAME) glFinish();
+        const int i(static_cast<int>(op));
+        stats.calls[i]++;
+        stats.seconds[i] +=
+            std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    return in.ok();
+}
+
+// ============================= Primitive =================================
+
+std::unique_ptr<const Geometry2D> Rectangle(GLfloat x, GLfloat y, GLfloat w,
+                                            GLfloat h);
+std::unique_ptr<const Geometry3D> Octahedron(GLfloat s = 1.0f);
+std::unique_ptr<const GeometryIndex3D> WireCube(GLfloat s = 1.0f,
+                                                GLfloat d = 0.8f,
+                                                GLfloat t = 0.1f);
+std::unique_ptr<const GeometryIndex3D> SolidCube(GLfloat s = 1.0f);
+std::unique_ptr<const GeometryIndex3D> SolidSphere(int samples = 8);
+std::unique_ptr<const TexturedGeometry> TexturedCube(GLfloat s = 1.0f);
+
+// =============================== Mesh ====================================
+
+struct MeshData {
+    MeshData()
+        : vtx(TrackingAllocator<Vertex3D>(MemoryTag::MESH)),
+          idx(TrackingAllocator<GLuint>(MemoryTag::MESH)) {}
+
+    TrackedVector<Vertex3D> vtx;
+    TrackedVector<GLuint> idx;
+};
+
+// Merges vertices closer than `epsilon` (and, with `match_normals`, facing
+// the same way) using a spatial hash of epsilon-sized cells. Returns the
+// number of vertices removed.
+inline std::size_t WeldVertices(MeshData& mesh, GLfloat epsilon = 1e-5f,
+                                bool match_normals = false) {
+    const std::size_t n(mesh.vtx.size());
+    auto cell = [&](GLfloat v) {
+        return static_cast<std::int64_t>(std::floor(v / epsilon));
+    };
+    auto key = [](std::int64_t x, std::int64_t y, std::int64_t z) {
+        return static_cast<std::uint64_t>(x) * 73856093u ^
+               static_cast<std::uint64_t>(y) * 19349663u ^
+               static_cast<std::uint64_t>(z) * 83492791u;
+    };
+
+    std::unordered_map<std::uint64_t, GLuint> heads;  // cell -> first kept
+    heads.reserve(n);
+    std::vector<GLuint> next;  // chain of kept vertices per cell
+    std::vector<GLuint> remap(n);
+    TrackedVector<Vertex3D> kept(mesh.vtx.get_allocator());
+    kept.reserve(n);
+    for (std::size_t i = 0; i < n; i++) {
+        const Vertex3D& v(mesh.vtx[i]);
+        const std::int64_t c[3] = {cell(v.position[0]), cell(v.position[1]),
+                                   cell(v.position[2])};
+        GLuint match(~0u);
+        for (int d = 0; d < 27 && match == ~0u; d++) {
+            const auto it(heads.find(
+                key(c[0] + d % 3 - 1, c[1] + d / 3 % 3 - 1, c[2] + d / 9 - 1)));
+            if (it == heads.end()) continue;
+            for (GLuint k = it->second; k != ~0u; k = next[k]) {
+                const Vertex3D& w(kept[k]);
+                GLfloat d2(0.0f), dot(0.0f);
+                for (int a = 0; a < 3; a++) {
+                    d2 += (v.position[a] - w.position[a]) *
+                          (v.position[a] - w.position[a]);
+                    dot += v.normal[a] * w.normal[a];
+                }
+                if (d2 <= epsilon * epsilon &&
+                    (!match_normals || dot >= 0.999f)) {
+                    match = k;
+                    break;
+                }
+            }
+        }
+        if (match == ~0u) {
+            match = static_cast<GLuint>(kept.size());
+            kept.emplace_back(v);
+            const auto head(heads.emplace(key(c[0], c[1], c[2]), ~0u).first);
+            next.emplace_back(head->second);
+            head->second = match;
+        }
+        remap[i] = match;
+    }
+    for (GLuint& i : mesh.idx) i = remap[i];
+    mesh.vtx.swap(kept);
+    return n - mesh.vtx.size();
+}
+
+// Drops triangles with repeated vertices or an area of at most `min_area`,
+// then vertices no triangle uses. Returns the number of triangles removed.
+inline std::size_t RemoveDegenerates(MeshData& mesh, GLfloat min_area = 0.0f) {
+    const std::size_t tri_cnt(mesh.idx.size() / 3);
+    TrackedVector<GLuint> idx(mesh.idx.get_allocator());
+    idx.reserve(mesh.idx.size());
+    for (std::size_t t = 0; t < tri_cnt; t++) {
+        const GLuint* const f(&mesh.idx[t * 3]);
+        if (f[0] == f[1] || f[1] == f[2] || f[2] == f[0]) continue;
+        const GLfloat* const a(mesh.vtx[f[0]].position);
+        const GLfloat* const b(mesh.vtx[f[1]].position);
+        const GLfloat* const c(mesh.vtx[f[2]].position);
+        const GLfloat u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        const GLfloat w[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        const GLfloat n[3] = {u[1] * w[2] - u[2] * w[1],
+                              u[2] * w[0] - u[0] * w[2],
+                              u[0] * w[1] - u[1] * w[0]};
+        const GLfloat area(
+            0.5f * std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]));
+        if (area <= min_area) continue;
+        idx.insert(idx.end(), f, f + 3);
+    }
+
+    std::vector<GLuint> remap(mesh.vtx.size(), ~0u);
+    TrackedVector<Vertex3D> vtx(mesh.vtx.get_allocator());
+    for (GLuint& i : idx) {
+        if (remap[i] == ~0u) {
+            remap[i] = static_cast<GLuint>(vtx.size());
+            vtx.emplace_back(mesh.vtx[i]);
+        }
+        i = remap[i];
+    }
+    mesh.vtx.swap(vtx);
+    mesh.idx.swap(idx);
+    return tri_cnt - mesh.idx.size() / 3;
+}
+
+enum class NormalWeight {
+    AREA,  // larger faces dominate
+    ANGLE  // corner angle, independent of tessellation
+};
+
+// Smooth vertex normals. Faces meeting at more than `crease_degrees` are
+// not averaged; such vertices are split so both sides keep their own
+// normal. Face normals and per-corner sums run in parallel chunks, each
+// writing only its own outputs, so no atomics are needed.
+inline void ComputeNormals(MeshData& mesh, GLfloat crease_degrees = 180.0f,
+                           NormalWeight weight = NormalWeight::ANGLE,
+                           ThreadPool& pool = DefaultThreadPool()) {
+    static constexpr int chunk(4096);
+    const int tri_cnt(static_cast<int>(mesh.idx.size() / 3));
+    const std::size_t vtx_cnt(mesh.vtx.size());
+
+    // unit face normals and the weight of each corner
+    std::vector<GLfloat> face(tri_cnt * 3), corner(tri_cnt * 3);
+    pool.parallelFor((tri_cnt + chunk - 1) / chunk, [&](int c) {
+        const int end(std::min(tri_cnt, (c + 1) * chunk));
+        for (int t = c * chunk; t < end; t++) {
+            const GLfloat* p[3];
+            for (int k = 0; k < 3; k++) {
+                p[k] = mesh.vtx[mesh.idx[t * 3 + k]].position;
+            }
+            GLfloat e[3][3];  // edge k runs from corner k to k + 1
+            for (int k = 0; k < 3; k++) {
+                for (int a = 0; a < 3; a++) {
+                    e[k][a] = p[(k + 1) % 3][a] - p[k][a];
+                }
+            }
+            GLfloat* const n(&face[t * 3]);
+            n[0] = e[0][1] * e[2][2] - e[0][2] * e[2][1];
+            n[1] = e[0][2] * e[2][0] - e[0][0] * e[2][2];
+            n[2] = e[0][0] * e[2][1] - e[0][1] * e[2][0];
+            const GLfloat length(
+                std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]));
+            // e[0] x e[2] points inward for counter-clockwise faces
+            for (int a = 0; a < 3; a++) {
+                n[a] = length > 0.0f ? -n[a] / length : 0.0f;
+            }
+            for (int k = 0; k < 3; k++) {
+                if (weight == NormalWeight::AREA) {
+                    corner[t * 3 + k] = 0.5f * length;
+                    continue;
+                }
+                const GLfloat* const u(e[k]);
+                const GLfloat* const w(e[(k + 2) % 3]);
+                const GLfloat lu(std::sqrt(u[0] * u[0] + u[1] * u[1] +
+                                           u[2] * u[2]));
+                const GLfloat lw(std::sqrt(w[0] * w[0] + w[1] * w[1] +
+                                           w[2] * w[2]));
+                const GLfloat cosine(lu > 0.0f && lw > 0.0f
+                                         ? -(u[0] * w[0] + u[1] * w[1] +
+                                             u[2] * w[2]) / (lu * lw)
+                                         : 1.0f);
+                corner[t * 3 + k] =
+                    std::acos(std::min(std::max(cosine, -1.0f), 1.0f));
+            }
+        }
+    });
+
+    // vertex -> corners
+    std::vector<GLuint> start(vtx_cnt + 1, 0), corners(mesh.idx.size());
+    for (const GLuint v : mesh.idx) start[v + 1]++;
+    for (std::size_t v = 0; v < vtx_cnt; v++) start[v + 1] += start[v];
+    {
+        std::vector<GLuint> fill(start.begin(), start.end() - 1);
+        for (std::size_t i = 0; i < mesh.idx.size(); i++) {
+            corners[fill[mesh.idx[i]]++] = static_cast<GLuint>(i);
+        }
+    }
+
+    // normal of every corner from the faces around its vertex within the
+    // crease angle
+    const bool smooth(crease_degrees >= 180.0f);
+    const GLfloat threshold(
+        std::cos(crease_degrees * 3.14159265358979323846f / 180.0f));
+    std::vector<GLfloat> normals(mesh.idx.size() * 3);
+    const int vtx_chunks(static_cast<int>((vtx_cnt + chunk - 1) / chunk));
+    pool.parallelFor(vtx_chunks, [&](int c) {
+        const std::size_t end(std::min(vtx_cnt, std::size_t(c + 1) * chunk));
+        for (std::size_t v = std::size_t(c) * chunk; v < end; v++) {
+            for (GLuint i = start[v]; i < start[v + 1]; i++) {
+                const GLfloat* const own(&face[corners[i] / 3 * 3]);
+                GLfloat sum[3] = {0.0f, 0.0f, 0.0f};
+                for (GLuint j = start[v]; j < start[v + 1]; j++) {
+                    const GLfloat* const other(&face[corners[j] / 3 * 3]);
+                    if (!smooth && own[0] * other[0] + own[1] * other[1] +
+                                           own[2] * other[2] <
+                                       threshold) {
+                        continue;
+                    }
+                    for (int a = 0; a < 3; a++) {
+                        sum[a] += corner[corners[j]] * other[a];
+                    }
+                }
+                const GLfloat length(std::sqrt(
+                    sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]));
+                for (int a = 0; a < 3; a++) {
+                    normals[corners[i] * 3 + a] =
+                        length > 0.0f ? sum[a] / length : own[a];
+                }
+                if (smooth) {  // the same for every corner of v
+                    for (GLuint j = start[v] + 1; j < start[v + 1]; j++) {
+                        std::copy(&normals[corners[i] * 3],
+                                  &normals[corners[i] * 3] + 3,
+                                  &normals[corners[j] * 3]);
+                    }
+                    break;
+                }
+            }
+        }
+    });
+
+    // the first normal of a vertex stays, other distinct ones get copies
+    for (std::size_t v = 0; v < vtx_cnt; v++) {
+        for (GLuint i = start[v]; i < start[v + 1]; i++) {
+            const GLfloat* const n(&normals[corners[i] * 3]);
+            GLuint target(static_cast<GLuint>(v));
+            for (GLuint j = start[v]; j < i; j++) {
+                const GLfloat* const m(&normals[corners[j] * 3]);
+                if (n[0] * m[0] + n[1] * m[1] + n[2] * m[2] >= 0.9999f) {
+                    target = mesh.idx[corners[j]];
+                    break;
+                }
+                if (j + 1 == i) {  // no earlier corner matched
+                    const Vertex3D copy(mesh.vtx[v]);
+                    target = static_cast<GLuint>(mesh.vtx.size());
+                    mesh.vtx.emplace_back(copy);
+                }
+            }
+            std::copy(n, n + 3, mesh.vtx[target].normal);
+            mesh.idx[corners[i]] = target;
+        }
+    }
+}
+
+// ============================== Loader ===================================
+
+// Parses positions, normals and (fan-triangulated) faces of a Wavefront OBJ
+// stream, generating normals when the file has none. Texture coordinates
+// are skipped; vertices sharing the same position/normal pair are emitted
+// once.
+inline bool ParseObj(std::istream& in, MeshData& mesh) {
+    std::vector<std::array<GLfloat, 3>> positions, normals;
+    std::unordered_map<std::uint64_t, GLuint> lookup;
+    std::vector<GLuint> face;
+    std::string line, tag, token;
+
+    mesh.vtx.clear();
+    mesh.idx.clear();
+    while (std::getline(in, line)) {
+        std::istringstream ss(line);
+        if (!(ss >> tag)) continue;
+        if (tag == "v" || tag == "vn") {
+            std::array<GLfloat, 3> p = {{0.0f, 0.0f, 0.0f}};
+            ss >> p[0] >> p[1] >> p[2];
+            (tag == "v" ? positions : normals).emplace_back(p);
+        } else if (tag == "f") {
+            face.clear();
+            while (ss >> token) {
+                // v, v/vt, v//vn or v/vt/vn (1-based, negative is relative)
+                long v(0), n(0);
+                const std::size_t s1(token.find('/'));
+                v = std::strtol(token.c_str(), nullptr, 10);
+                if (s1 != std::string::npos) {
+                    const std::size_t s2(token.find('/', s1 + 1));
+                    if (s2 != std::string::npos) {
+                        n = std::strtol(token.c_str() + s2 + 1, nullptr, 10);
+                    }
+                }
+                v = v < 0 ? static_cast<long>(positions.size()) + v : v - 1;
+                n = n < 0 ? static_cast<long>(normals.size()) + n : n - 1;
+                if (v < 0 || v >= static_cast<long>(positions.size())) {
+                    return false;
+                }
+                if (n >= static_cast<long>(normals.size())) n = -1;
+
+                const std::uint64_t key(
+                    (static_cast<std::uint64_t>(v) << 32) |
+                    static_cast<std::uint32_t>(n));
+                auto it(lookup.find(key));
+                if (it == lookup.end()) {
+                    Vertex3D vertex = {
+                        {positions[v][0], positions[v][1], positions[v][2]},
+                        {0.0f, 0.0f, 0.0f}};
+                    if (n >= 0) {
+                        std::copy(normals[n].begin(), normals[n].end(),
+                                  vertex.normal);
+                    }
+                    const GLuint i(static_cast<GLuint>(mesh.vtx.size()));
+                    mesh.vtx.emplace_back(vertex);
+                    it = lookup.emplace(key, i).first;
+                }
+                face.emplace_back(it->second);
+            }
+            for (std::size_t i = 2; i < face.size(); i++) {
+                mesh.idx.emplace_back(face[0]);
+                mesh.idx.emplace_back(face[i - 1]);
+                mesh.idx.emplace_back(face[i]);
+            }
+        }
+    }
+    if (normals.empty()) {  // smooth normals, hard edges beyond 60 degrees
+        ComputeNormals(mesh, 60.0f);
+    }
+    return true;
+}
+
+inline bool ReadObj(const std::string name, MeshData& mesh) {
+    std::ifstream file(name);
+    if (file.fail()) {
+        std::cerr << "Error: Can't open " << name << std::endl;
+        return false;
+    }
+    if (!ParseObj(file, mesh)) {
+        std::cerr << "Error: Could not parse " << name << std::endl;
+        return false;
+    }
+    return true;
+}
+
+inline std::unique_ptr<const GeometryIndex3D> LoadObj(const std::string name) {
+    MeshData mesh;
+    if (!ReadObj(name, mesh)) return nullptr;
+    std::unique_ptr<const GeometryIndex3D> shape(new GeometryIndex3D(
+        3, static_cast<GLsizei>(mesh.vtx.size()), mesh.vtx.data(),
+        static_cast<GLsizei>(mesh.idx.size()), mesh.idx.data()));
+    return shape;
+}
+
+// Multi-producer single-consumer queue (Vyukov). push() is wait-free for
+// any number of producers, pop() must only be called from one thread.
+template <typename T>
+class MPSCQueue {
+public:
+    MPSCQueue() : m_head(new Node()), m_tail(m_head.load()) {}
+    virtual ~MPSCQueue() {
+        T value;
+        while (pop(value)) {
+        }
+        delete m_tail;
+    }
+
+    void push(T value) {
+        Node* const node(new Node(std::move(value)));
+        Node* const prev(m_head.exchange(node, std::memory_order_acq_rel));
+        prev->next.store(node, std::memory_order_release);
+    }
+
+    bool pop(T& value) {
+        Node* const tail(m_tail);
+        Node* const next(tail->next.load(std::memory_order_acquire));
+        if (next == nullptr) return false;
+        value = std::move(next->value);
+        m_tail = next;
+        delete tail;
+        return true;
+    }
+
+private:
+    MPSCQueue(const MPSCQueue& o);
+    MPSCQueue& operator=(const MPSCQueue& o);
+
+    struct Node {
+        std::atomic<Node*> next;
+        T value;
+        Node() : next(nullptr) {}
+        explicit Node(T v) : next(nullptr), value(std::move(v)) {}
+    };
+
+    std::atomic<Node*> m_head;  // producers
+    Node* m_tail;               // consumer
+};
+
+// Result of AssetLoader::load(). Only touched from the GL thread once the
+// loader has handed it over, so no synchronization is needed to query it.
+class MeshHandle {
+public:
+    bool ready() const { return m_geometry != nullptr; }
+    bool failed() const { return m_failed; }
+    const GeometryIndex3D* get() const { return m_geometry.get(); }
+    const std::string& name() const { return m_name; }
+
+private:
+    friend class AssetLoader;
+    explicit MeshHandle(const std::string& name)
+        : m_name(name), m_failed(false) {}
+
+    const std::string m_name;
+    std::unique_ptr<const GeometryIndex3D> m_geometry;
+    bool m_failed;
+};
+
+// Reads and parses meshes on worker threads and uploads them on the GL
+// thread in slices of at most `budget` bytes per update() so that loading
+// never stalls a frame.
+class AssetLoader {
+public:
+    explicit AssetLoader(unsigned int workers = 2)
+        : m_quit(false), m_outstanding(0) {
+        for (unsigned int i = 0; i < std::max(workers, 1u); i++) {
+            m_workers.emplace_back(&AssetLoader::Work, this);
+        }
+    }
+
+    virtual ~AssetLoader() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_cond.notify_all();
+        for (std::thread& t : m_workers) t.join();
+    }
+
+    std::shared_ptr<const MeshHandle> load(const std::string name) {
+        std::shared_ptr<MeshHandle> handle(new MeshHandle(name));
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.emplace_back(handle);
+        }
+        m_outstanding++;
+        m_cond.notify_one();
+        return handle;
+    }
+
+    // Uploads staged meshes; call once per frame on the GL thread.
+    // Returns the number of bytes uploaded.
+    GLsizeiptr update(GLsizeiptr budget = 4 << 20) {
+        GLsizeiptr uploaded(0);
+        while (uploaded < budget) {
+            if (!m_current && !m_staged.pop(m_current)) break;
+            Staged& s(*m_current);
+            if (!s.mesh) {
+                s.handle->m_failed = true;
+                m_current.reset();
+                m_outstanding--;
+                continue;
+            }
+            if (!s.geometry) {
+                s.geometry.reset(new GeometryIndex3D(
+                    3, static_cast<GLsizei>(s.mesh->vtx.size()), nullptr,
+                    static_cast<GLsizei>(s.mesh->idx.size()), nullptr));
+            }
+
+            const GLsizeiptr vtx_size(s.mesh->vtx.size() * sizeof(Vertex3D));
+            const GLsizeiptr idx_size(s.mesh->idx.size() * sizeof(GLuint));
+            const GLsizeiptr n(
+                std::min(budget - uploaded, vtx_size + idx_size - s.offset));
+            if (s.offset < vtx_size) {
+                const GLsizeiptr m(std::min(n, vtx_size - s.offset));
+                s.geometry->object().upload(
+                    GL_ARRAY_BUFFER, s.offset, m,
+                    reinterpret_cast<const char*>(s.mesh->vtx.data()) +
+                        s.offset);
+                s.offset += m;
+                uploaded += m;
+            } else {
+                const GLsizeiptr o(s.offset - vtx_size);
+                s.geometry->object().upload(
+                    GL_ELEMENT_ARRAY_BUFFER, o, n,
+                    reinterpret_cast<const char*>(s.mesh->idx.data()) + o);
+                s.offset += n;
+                uploaded += n;
+            }
+
+            if (s.offset >= vtx_size + idx_size) {
+                s.handle->m_geometry = std::move(s.geometry);
+                m_current.reset();
+                m_outstanding--;
+            }
+        }
+        return uploaded;
+    }
+
+    // True when every requested mesh is either ready or failed.
+    bool idle() const { return m_outstanding == 0; }
+
+private:
+    AssetLoader(const AssetLoader& o);
+    AssetLoader& operator=(const AssetLoader& o);
+
+    struct Staged {
+        std::shared_ptr<MeshHandle> handle;
+        std::unique_ptr<MeshData> mesh;  // nullptr when parsing failed
+        std::unique_ptr<GeometryIndex3D> geometry;
+        GLsizeiptr offset;
+    };
+
+    void Work() {
+        for (;;) {
+            std::shared_ptr<MeshHandle> handle;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cond.wait(lock, [this] { return m_quit || !m_jobs.empty(); });
+                if (m_quit) return;
+                handle = std::move(m_jobs.front());
+                m_jobs.pop_front();
+            }
+            std::unique_ptr<MeshData> mesh(new MeshData());
+            if (!ReadObj(handle->m_name, *mesh)) mesh.reset();
+            std::unique_ptr<Staged> s(new Staged());
+            s->handle = std::move(handle);
+            s->mesh = std::move(mesh);
+            s->offset = 0;
+            m_staged.push(std::move(s));
+        }
+    }
+
+    std::vector<std::thread> m_workers;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<std::shared_ptr<MeshHandle>> m_jobs;
+    bool m_quit;
+
+    MPSCQueue<std::unique_ptr<Staged>> m_staged;  // workers -> GL thread
+    std::unique_ptr<Staged> m_current;            // mesh being uploaded
+    std::atomic<int> m_outstanding;
+};
+
+// ============================ Initializer ================================
+
+inline void Initialize() {
+    assert(glfwInit());
+    atexit(glfwTerminate);
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+    // captured runs render offscreen
+    if (std::getenv("TGR_CAPTURE") != nullptr) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
+}
+
+inline GLboolean PrintShaderInfoLog(GLuint shader, const char* str) {
+    // Get compile outputs
+    GLint status;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status == GL_FALSE) std::cerr << "Error in " << str << std::endl;
+
+    // Get length of compile logs
+    GLsizei buf_size;
+    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &buf_size);
+
+    // Show logs
+    if (buf_size > 1) {
+        std::vector<GLchar> info_log(buf_size);
+        GLsizei length;
+        glGetShaderInfoLog(shader, buf_size, &length, &info_log[0]);
+        std::cerr << &info_log[0] << std::endl;
+    }
+    return static_cast<GLboolean>(status);
+}
+
+inline GLboolean PrintProgramInfoLog(GLuint program) {
+    GLint status;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status == GL_FALSE) std::cerr << "Link Error" << std::endl;
+
+    // Get length of link logs
+    GLsizei buf_size;
+    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &buf_size);
+
+    // Show logs
+    if (buf_size > 1) {
+        std::vector<GLchar> info_log(buf_size);
+        GLsizei length;
+        glGetProgramInfoLog(program, buf_size, &length, &info_log[0]);
+        std::cerr << &info_log[0] << std::endl;
+    }
+    return static_cast<GLboolean>(status);
+}
+
+inline GLuint CreateProgram(const char* vsrc, const char* fsrc,
+                            bool use_normal = false) {
+    const GLuint program(glCreateProgram());
+    if (vsrc == nullptr || fsrc == nullptr) {
+        std::cout << "Incompatible shader source." << std::endl;
+        exit(1);
+    }
+
+    // Compile vertex shader
+    const GLuint vobj(glCreateShader(GL_VERTEX_SHADER));
+    glShaderSource(vobj, 1, &vsrc, NULL);
+    glCompileShader(vobj);
+    if (PrintShaderInfoLog(vobj, "vertex shader"))
+        glAttachShader(program, vobj);
+    glDeleteShader(vobj);
+
+    // Compile fragment shader
+    const GLuint fobj(glCreateShader(GL_FRAGMENT_SHADER));
+    glShaderSource(fobj, 1, &fsrc, NULL);
+    glCompileShader(fobj);
+    if (PrintShaderInfoLog(fobj, "fragment shader"))
+        glAttachShader(program, fobj);
+    glDeleteShader(fobj);
+
+    // Link shaders
+    glBindAttribLocation(program, 0, "position");
+    if (use_normal) {
+        glBindAttribLocation(program, 1, "normal");
+    }
+    // SkinnedVertex attributes, ignored by programs without them
+    glBindAttribLocation(program, 2, "joints");
+    glBindAttribLocation(program, 3, "weights");
+    // TexturedVertex and BatchVertex attributes
+    glBindAttribLocation(program, 4, "texcoord");
+    glBindAttribLocation(program, 5, "color");
+    glBindFragDataLocation(program, 0, "fragment");
+    glLinkProgram(program);
+    if (PrintProgramInfoLog(program)) return program;
+    glDeleteProgram(program);
+    return 0;
+}
+
+inline GLboolean ReadShaderSource(const std::string name,
+                                  std::vector<GLchar>& buffer) {
+    std::ifstream file(name, std::ios::binary);
+    if (file.fail()) {
+        std::cerr << "Error: Can't open " << name << std::endl;
+        return false;
+    }
+
+    // Allocate memory
+    file.seekg(0L, std::ios::end);
+    GLsizei length = static_cast<GLsizei>(file.tellg());
+    buffer.resize(length + 1);
+
+    // Open file
+    file.seekg(0L, std::ios::beg);
+    file.read(buffer.data(), length);
+    buffer[length] = '\0';
+
+    if (file.fail()) {
+        std::cerr << "Error: Could not read " << name << std::endl;
+        file.close();
+        return false;
+    }
+
+    file.close();
+    return true;
+}
+
+inline GLuint LoadProgram(const std::string vert_shader_file,
+                          const std::string frag_shader_file,
+                          bool use_normal = false) {
+    std::vector<GLchar> vsrc, fsrc;
+    const bool vst(ReadShaderSource(vert_shader_file, vsrc));
+    const bool fst(ReadShaderSource(frag_shader_file, fsrc));
+    return vst && fst ? CreateProgram(vsrc.data(), fsrc.data(), use_normal) : 0;
+}
+
+// Inserts `defines` right after the #version line of `src` (or in front of
+// it when there is none) followed by a #line directive so that compile
+// errors keep pointing at the original line numbers. Before GLSL 3.30,
+// `#line N` numbers the line after it N + 1.
+inline std::string InjectDefines(const char* src, const std::string& defines) {
+    const std::string s(src);
+    std::size_t pos(0);
+    int line(1);
+    int glsl(110);  // without #version
+    const std::size_t version(s.find("#version"));
+    if (version != std::string::npos) {
+        glsl = std::atoi(s.c_str() + version + 8);
+        pos = s.find('\n', version);
+        pos = pos == std::string::npos ? s.size() : pos + 1;
+        line += static_cast<int>(std::count(s.begin(), s.begin() + pos, '\n'));
+    }
+    std::string out(s, 0, pos);
+    if (!out.empty() && out.back() != '\n') out += '\n';
+    out += defines;
+    out += "#line " + std::to_string(glsl < 330 ? line - 1 : line) + "\n";
+    out.append(s, pos, std::string::npos);
+    return out;
+}
+
+// Compiles variants of one vertex/fragment shader pair on demand. Each
+// feature is a `#define` ("NAME" or "NAME value") owning one bit, and every
+// linked program is cached by its feature bitmask, so the draw path can ask
+// for exactly the features a material needs instead of branching in an
+// uber-shader.
+class ShaderPermutations {
+public:
+    ShaderPermutations(const std::string vert_shader_file,
+                       const std::string frag_shader_file,
+                       bool use_normal = false)
+        : m_use_normal(use_normal) {
+        if (!ReadShaderSource(vert_shader_file, m_vsrc) ||
+            !ReadShaderSource(frag_shader_file, m_fsrc)) {
+            m_vsrc.clear();
+            m_fsrc.clear();
+        }
+    }
+
+    virtual ~ShaderPermutations() {
+        for (const auto& p : m_programs) glDeleteProgram(p.second);
+    }
+
+    // Registers a feature and returns its bit. Registering the same define
+    // twice returns the same bit.
+    std::uint32_t feature(const std::string define) {
+        for (std::size_t i = 0; i < m_features.size(); i++) {
+            if (m_features[i] == define) return 1u << i;
+        }
+        if (m_features.size() >= 32) {
+            std::cerr << "Error: Too many shader features." << std::endl;
+            return 0;
+        }
+        m_features.emplace_back(define);
+        return 1u << (m_features.size() - 1);
+    }
+
+    // Returns the program compiled with `features`, building it on first
+    // use. Returns 0 when compiling or linking fails, which is not cached
+    // so that the next call tries again.
+    GLuint program(std::uint32_t features) {
+        const auto it(m_programs.find(features));
+        if (it != m_programs.end()) return it->second;
+        if (m_vsrc.empty() || m_fsrc.empty()) return 0;
+
+        std::string defines;
+        for (std::size_t i = 0; i < m_features.size(); i++) {
+            if (features & (1u << i)) {
+                defines += "#define " + m_features[i] + "\n";
+            }
+        }
+        const std::string vsrc(InjectDefines(m_vsrc.data(), defines));
+        const std::string fsrc(InjectDefines(m_fsrc.data(), defines));
+        const GLuint program(
+            CreateProgram(vsrc.c_str(), fsrc.c_str(), m_use_normal));
+        if (program != 0) m_programs.emplace(features, program);
+        return program;
+    }
+
+    std::size_t size() const { return m_programs.size(); }
+
+private:
+    ShaderPermutations(const ShaderPermutations& o);
+    ShaderPermutations& operator=(const ShaderPermutations& o);
+
+    std::vector<GLchar> m_vsrc;
+    std::vector<GLchar> m_fsrc;
+    const bool m_use_normal;
+    std::vector<std::string> m_features;
+    std::unordered_map<std::uint32_t, GLuint> m_programs;
+};
+
+// FNV-1a hash of a uniform/block name, usable at compile time through the
+// "name"_hash literal so that lookups never touch strings at draw time.
+constexpr std::uint32_t Hash(const char* s, std::size_t n) {
+    std::uint32_t h(2166136261u);
+    for (std::size_t i = 0; i < n; i++) {
+        h = (h ^ static_cast<unsigned char>(s[i])) * 16777619u;
+    }
+    return h;
+}
+
+inline std::uint32_t Hash(const std::string& s) {
+    return Hash(s.data(), s.size());
+}
+
+constexpr std::uint32_t operator"" _hash(const char* s, std::size_t n) {
+    return Hash(s, n);
+}
+
+// Binding point shared by every uniform block called `name`, so a Uniform
+// selected once serves all programs declaring that block; GL_INVALID_INDEX
+// once GL_MAX_UNIFORM_BUFFER_BINDINGS names are taken. Programs may be
+// built on loader threads.
+inline GLuint UniformBlockBinding(const std::string& name) {
+    static std::mutex mutex;
+    static std::unordered_map<std::string, GLuint> bindings;
+    std::lock_guard<std::mutex> lock(mutex);
+    const auto it(bindings.find(name));
+    if (it != bindings.end()) return it->second;
+    GLint max(0);
+    glGetIntegerv(GL_MAX_UNIFORM_BUFFER_BINDINGS, &max);
+    const GLuint binding(static_cast<GLuint>(bindings.size()));
+    if (binding >= static_cast<GLuint>(max)) {
+        std::cerr << "Error: No uniform buffer binding left for " << name
+                  << std::endl;
+        return GL_INVALID_INDEX;
+    }
+    bindings.emplace(name, binding);
+    return binding;
+}
+
+// Linked program with its active uniforms and uniform blocks reflected into
+// hashed tables. Setters compare against a shadow copy of the last uploaded
+// value and skip redundant glUniform* calls; they require the program to be
+// in use.
+class Program {
+public:
+    explicit Program(GLuint program) : m_program(program) {
+        if (m_program == 0) return;
+
+        GLint count(0), length(0);
+        glGetProgramiv(m_program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &length);
+        std::vector<GLchar> name(std::max(length, 1));
+        for (GLint i = 0; i < count; i++) {
+            GLint size;
+            GLenum type;
+            glGetActiveUniform(m_program, i, length, nullptr, &size, &type,
+                               name.data());
+            const GLint location(glGetUniformLocation(m_program, name.data()));
+            if (location < 0) continue;  // member of a uniform block
+
+            // "Lpos[0]" is registered as "Lpos"
+            std::string key(name.data());
+            const std::size_t bracket(key.find('['));
+            if (bracket != std::string::npos) key.erase(bracket);
+
+            Entry e = {location, type, size, m_shadow.size(), false};
+            m_shadow.resize(m_shadow.size() + Components(type) * size);
+            Insert(m_uniforms, key, e);
+        }
+
+        glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+        glGetProgramiv(m_program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH,
+                       &length);
+        name.resize(std::max(length, 1));
+        for (GLint i = 0; i < count; i++) {
+            glGetActiveUniformBlockName(m_program, i, length, nullptr,
+                                        name.data());
+            const GLuint binding(UniformBlockBinding(name.data()));
+            if (binding == GL_INVALID_INDEX) continue;
+            glUniformBlockBinding(m_program, i, binding);
+            Insert(m_blocks, name.data(), binding);
+        }
+    }
+
+    virtual ~Program() { glDeleteProgram(m_program); }
+
+    GLuint id() const { return m_program; }
+    void use() const { glUseProgram(m_program); }
+
+    // -1 when the uniform is not active
+    GLint location(std::uint32_t name) const {
+        const auto it(m_uniforms.find(name));
+        return it == m_uniforms.end() ? -1 : it->second.location;
+    }
+
+    // Binding point of a uniform block, GL_INVALID_INDEX when not active
+    GLuint binding(std::uint32_t name) const {
+        const auto it(m_blocks.find(name));
+        return it == m_blocks.end() ? GL_INVALID_INDEX : it->second;
+    }
+
+    // Uploads `count` elements of a float, vector or matrix uniform; any
+    // beyond the reflected array length are ignored.
+    void set(std::uint32_t name, const GLfloat* v, GLsizei count = 1) {
+        Entry* const e(Find(name));
+        if (e == nullptr) return;
+        count = std::min(count, e->size);
+        if (!Changed(*e, v, count)) return;
+        switch (e->type) {
+            case GL_FLOAT:
+                glUniform1fv(e->location, count, v);
+                break;
+            case GL_FLOAT_VEC2:
+                glUniform2fv(e->location, count, v);
+                break;
+            case GL_FLOAT_VEC3:
+                glUniform3fv(e->location, count, v);
+                break;
+            case GL_FLOAT_VEC4:
+                glUniform4fv(e->location, count, v);
+                break;
+            case GL_FLOAT_MAT2:
+                glUniformMatrix2fv(e->location, count, GL_FALSE, v);
+                break;
+            case GL_FLOAT_MAT3:
+                glUniformMatrix3fv(e->location, count, GL_FALSE, v);
+                break;
+            case GL_FLOAT_MAT4:
+                glUniformMatrix4fv(e->location, count, GL_FALSE, v);
+                break;
+            default:
+                std::cerr << "Error: Uniform type mismatch." << std::endl;
+                return;
+        }
+        Store(*e, v, count);
+    }
+
+    // Uploads `count` elements of an integer, boolean or sampler uniform.
+    void set(std::uint32_t name, const GLint* v, GLsizei count = 1) {
+        Entry* const e(Find(name));
+        if (e == nullptr) return;
+        count = std::min(count, e->size);
+        if (!Changed(*e, v, count)) return;
+        if (IsFloat(e->type)) {
+            std::cerr << "Error: Uniform type mismatch." << std::endl;
+            return;
+        }
+        switch (Components(e->type)) {
+            case 1:
+                glUniform1iv(e->location, count, v);
+                break;
+            case 2:
+                glUniform2iv(e->location, count, v);
+                break;
+            case 3:
+                glUniform3iv(e->location, count, v);
+                break;
+            case 4:
+                glUniform4iv(e->location, count, v);
+                break;
+        }
+        Store(*e, v, count);
+    }
+
+    void set(std::uint32_t name, GLfloat v) { set(name, &v); }
+    void set(std::uint32_t name, GLint v) { set(name, &v); }
+    void set(std::uint32_t name, const Vector& v) { set(name, v.data()); }
+    void set(std::uint32_t name, const Matrix& m) { set(name, m.Data()); }
+
+private:
+    Program(const Program& o);
+    Program& operator=(const Program& o);
+
+    struct Entry {
+        GLint location;
+        GLenum type;
+        GLint size;          // array length
+        std::size_t shadow;  // offset into m_shadow
+        bool valid;          // shadow holds the uploaded value
+    };
+
+    static GLint Components(GLenum type) {
+        switch (type) {
+            case GL_FLOAT_VEC2:
+            case GL_INT_VEC2:
+            case GL_BOOL_VEC2:
+                return 2;
+            case GL_FLOAT_VEC3:
+            case GL_INT_VEC3:
+            case GL_BOOL_VEC3:
+                return 3;
+            case GL_FLOAT_VEC4:
+            case GL_INT_VEC4:
+            case GL_BOOL_VEC4:
+            case GL_FLOAT_MAT2:
+                return 4;
+            case GL_FLOAT_MAT3:
+                return 9;
+            case GL_FLOAT_MAT4:
+                return 16;
+            default:
+                return 1;  // scalars and samplers
+        }
+    }
+
+    static bool IsFloat(GLenum type) {
+        switch (type) {
+            case GL_FLOAT:
+            case GL_FLOAT_VEC2:
+            case GL_FLOAT_VEC3:
+            case GL_FLOAT_VEC4:
+            case GL_FLOAT_MAT2:
+            case GL_FLOAT_MAT3:
+            case GL_FLOAT_MAT4:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    template <typename V>
+    static void Insert(std::unordered_map<std::uint32_t, V>& map,
+                       const std::string& key, const V& value) {
+        if (!map.emplace(Hash(key), value).second) {
+            std::cerr << "Error: Hash collision on " << key << std::endl;
+        }
+    }
+
+    Entry* Find(std::uint32_t name) {
+        const auto it(m_uniforms.find(name));
+        return it == m_uniforms.end() ? nullptr : &it->second;
+    }
+
+    // Compares `count` elements against the shadow copy. Both GLfloat and
+    // GLint are stored bitwise in 32-bit slots.
+    template <typename T>
+    bool Changed(const Entry& e, const T* v, GLsizei count) const {
+        static_assert(sizeof(T) == sizeof(GLfloat), "32-bit uniform");
+        count = std::min(count, e.size);
+        const std::size_t bytes(Components(e.type) * count * sizeof(T));
+        return !e.valid || std::memcmp(&m_shadow[e.shadow], v, bytes) != 0;
+    }
+
+    // Refreshes the shadow copy once the value has been uploaded.
+    template <typename T>
+    void Store(Entry& e, const T* v, GLsizei count) {
+        count = std::min(count, e.size);
+        std::memcpy(&m_shadow[e.shadow], v,
+                    Components(e.type) * count * sizeof(T));
+        e.valid = count == e.size;
+    }
+
+    const GLuint m_program;
+    std::unordered_map<std::uint32_t, Entry> m_uniforms;
+    std::unordered_map<std::uint32_t, GLuint> m_blocks;
+    std::vector<GLfloat> m_shadow;
+};
+
+// ============================ Render Target ==============================
+
+// Offscreen framebuffer with color/depth texture attachments. With
+// `samples` > 1 rendering goes to multisampled renderbuffers and resolve()
+// blits them into the textures.
+class RenderTarget {
+public:
+    RenderTarget(GLsizei width, GLsizei height,
+                 const std::vector<GLenum>& color_formats = {GL_RGBA8},
+                 GLenum depth_format = GL_DEPTH_COMPONENT24,
+                 GLsizei samples = 0)
+        : m_width(0),
+          m_height(0),
+          m_color_formats(color_formats),
+          m_depth_format(depth_format),
+          m_samples(samples > 1 ? samples : 0),
+          m_fbo(0),
+          m_resolve_fbo(0),
+          m_memory(MemoryTag::TARGET) {
+        resize(width, height);
+    }
+
+    virtual ~RenderTarget() { Release(); }
+
+    // Reallocates every attachment; no-op when the size is unchanged.
+    void resize(GLsizei width, GLsizei height) {
+        width = std::max(width, 1);
+        height = std::max(height, 1);
+        if (width == m_width && height == m_height) return;
+        Release();
+        m_width = width;
+        m_height = height;
+
+        const GLsizei n(static_cast<GLsizei>(m_color_formats.size()));
+        m_color.resize(n);
+        glGenTextures(n, m_color.data());
+        const std::uint64_t pixels(static_cast<std::uint64_t>(m_width) *
+                                   m_height);
+        for (GLsizei i = 0; i < n; i++) {
+            Texture(m_color[i], m_color_formats[i]);
+            m_memory.add(pixels * FormatBytes(m_color_formats[i]));
+        }
+        m_depth = 0;
+        if (m_depth_format != GL_NONE) {
+            glGenTextures(1, &m_depth);
+            Texture(m_depth, m_depth_format);
+            m_memory.add(pixels * FormatBytes(m_depth_format));
+        }
+
+        glGenFramebuffers(1, &m_fbo);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+        if (m_samples > 0) {
+            // multisampled storage, resolved into the textures
+            m_msaa.resize(n + (m_depth != 0 ? 1 : 0));
+            glGenRenderbuffers(static_cast<GLsizei>(m_msaa.size()),
+                               m_msaa.data());
+            for (std::size_t i = 0; i < m_msaa.size(); i++) {
+                const bool depth(i == static_cast<std::size_t>(n));
+                glBindRenderbuffer(GL_RENDERBUFFER, m_msaa[i]);
+                glRenderbufferStorageMultisample(
+                    GL_RENDERBUFFER, m_samples,
+                    depth ? m_depth_format : m_color_formats[i], m_width,
+                    m_height);
+                m_memory.add(
+                    pixels * m_samples *
+                    FormatBytes(depth ? m_depth_format : m_color_formats[i]));
+                glFramebufferRenderbuffer(
+                    GL_FRAMEBUFFER, depth ? DepthAttachment() : Color(i),
+                    GL_RENDERBUFFER, m_msaa[i]);
+            }
+            glGenFramebuffers(1, &m_resolve_fbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, m_resolve_fbo);
+        }
+        for (GLsizei i = 0; i < n; i++) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, Color(i), GL_TEXTURE_2D,
+                                   m_color[i], 0);
+        }
+        if (m_depth != 0) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, DepthAttachment(),
+                                   GL_TEXTURE_2D, m_depth, 0);
+        }
+
+        // every color attachment is a draw buffer
+        std::vector<GLenum> buffers(n);
+        for (GLsizei i = 0; i < n; i++) buffers[i] = Color(i);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+        glDrawBuffers(n, buffers.data());
+        if (n == 0) glDrawBuffer(GL_NONE);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) !=
+            GL_FRAMEBUFFER_COMPLETE) {
+            std::cerr << "Error: Incomplete framebuffer." << std::endl;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, DefaultFramebuffer());
+    }
+
+    // Renders into this target from now on.
+    void bind() const {
+        glBindFramebuffer(GL_FRAMEBUFFER, m_fbo);
+        glViewport(0, 0, m_width, m_height);
+    }
+
+    // Renders into the window again.
+    static void BindDefault(GLsizei width, GLsizei height) {
+        glBindFramebuffer(GL_FRAMEBUFFER, DefaultFramebuffer());
+        glViewport(0, 0, width, height);
+    }
+
+    // Copies the multisampled attachments into the textures.
+    void resolve() const {
+        if (m_samples == 0) return;
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_fbo);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_resolve_fbo);
+        for (std::size_t i = 0; i < m_color.size(); i++) {
+            glReadBuffer(Color(i));
+            glDrawBuffer(Color(i));
+            glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height,
+                              GL_COLOR_BUFFER_BIT, GL_NEAREST);
+        }
+        if (m_depth != 0) {
+            glBlitFramebuffer(0, 0, m_width, m_height, 0, 0, m_width, m_height,
+                              GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, DefaultFramebuffer());
+    }
+
+    GLuint framebuffer() const { return m_fbo; }
+    GLuint color(std::size_t i = 0) const { return m_color[i]; }
+    GLuint depth() const { return m_depth; }
+    GLsizei width() const { return m_width; }
+    GLsizei height() const { return m_height; }
+    GLsizei samples() const { return m_samples; }
+    const std::vector<GLenum>& colorFormats() const { return m_color_formats; }
+    GLenum depthFormat() const { return m_depth_format; }
+
+private:
+    RenderTarget(const RenderTarget& o);
+    RenderTarget& operator=(const RenderTarget& o);
+
+    static GLenum Color(std::size_t i) {
+        return GL_COLOR_ATTACHMENT0 + static_cast<GLenum>(i);
+    }
+
+    GLenum DepthAttachment() const {
+        return m_depth_format == GL_DEPTH24_STENCIL8 ||
+                       m_depth_format == GL_DEPTH32F_STENCIL8
+                   ? GL_DEPTH_STENCIL_ATTACHMENT
+                   : GL_DEPTH_ATTACHMENT;
+    }
+
+    // Bytes per pixel of the sized internal formats used for attachments.
+    static std::uint64_t FormatBytes(GLenum format) {
+        switch (format) {
+            case GL_R8:
+                return 1;
+            case GL_RG8:
+            case GL_R16F:
+            case GL_DEPTH_COMPONENT16:
+                return 2;
+            case GL_RGBA16F:
+            case GL_RG32F:
+            case GL_RG32UI:
+            case GL_RG32I:
+            case GL_DEPTH32F_STENCIL8:
+                return 8;
+            case GL_RGBA32F:
+            case GL_RGBA32UI:
+            case GL_RGBA32I:
+                return 16;
+            case GL_RGB16F:
+                return 6;
+            case GL_RGB32F:
+                return 12;
+            default:  // RGBA8, R32F, R32UI, DEPTH24 (padded), ...
+                return 4;
+        }
+    }
+
+    void Texture(GLuint texture, GLenum format) const {
+        // glTexStorage2D() needs GL 4.2; any matching format/type will do
+        // for an allocation without data
+        const bool depth(format == GL_DEPTH_COMPONENT16 ||
+                         format == GL_DEPTH_COMPONENT24 ||
+                         format == GL_DEPTH_COMPONENT32F);
+        const bool stencil(format == GL_DEPTH24_STENCIL8 ||
+                           format == GL_DEPTH32F_STENCIL8);
+        // integer formats (IDs) need an _INTEGER format and cannot filter
+        const bool integer(format == GL_R32UI || format == GL_RG32UI ||
+                           format == GL_RGBA32UI || format == GL_R32I ||
+                           format == GL_RG32I || format == GL_RGBA32I);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, m_width, m_height, 0,
+                     depth     ? GL_DEPTH_COMPONENT
+                     : stencil ? GL_DEPTH_STENCIL
+                     : integer ? GL_RGBA_INTEGER
+                               : GL_RGBA,
+                     format == GL_DEPTH32F_STENCIL8
+                         ? GL_FLOAT_32_UNSIGNED_INT_24_8_REV
+                     : stencil ? GL_UNSIGNED_INT_24_8
+                     : integer ? GL_UNSIGNED_INT
+                               : GL_FLOAT,
+                     nullptr);
+        const GLint filter(integer ? GL_NEAREST : GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    void Release() {
+        if (m_fbo == 0) return;
+        glDeleteFramebuffers(1, &m_fbo);
+        glDeleteFramebuffers(1, &m_resolve_fbo);
+        glDeleteRenderbuffers(static_cast<GLsizei>(m_msaa.size()),
+                              m_msaa.data());
+        glDeleteTextures(static_cast<GLsizei>(m_color.size()), m_color.data());
+        glDeleteTextures(1, &m_depth);
+        m_fbo = m_resolve_fbo = 0;
+        m_msaa.clear();
+        m_memory.clear();
+    }
+
+    GLsizei m_width;
+    GLsizei m_height;
+    const std::vector<GLenum> m_color_formats;
+    const GLenum m_depth_format;
+    const GLsizei m_samples;
+    GLuint m_fbo;
+    GLuint m_resolve_fbo;
+    std::vector<GLuint> m_msaa;
+    std::vector<GLuint> m_color;
+    GLuint m_depth;
+    MemoryRecord m_memory;
+};
+
+// Draws one triangle covering the viewport; the vertex shader derives the
+// positions from gl_VertexID (see fullscreen.vert).
+inline void DrawFullscreenTriangle() {
+    static GLuint vao(0);  // core profile needs a bound VAO
+    if (vao == 0) glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
+
+// Frame graph of render passes. Each pass reads some resources as textures
+// and renders into one resource (or the window). compile() drops passes
+// whose output never reaches the window or an exported resource, then
+// assigns pooled RenderTargets so that resources with identical
+// descriptions and disjoint lifetimes share memory.
+class RenderGraph {
+public:
+    static constexpr int BACKBUFFER = -1;
+
+    struct TargetDesc {
+        GLfloat scale;  // relative to the graph size
+        std::vector<GLenum> color_formats;
+        GLenum depth_format;
+        GLsizei samples;
+    };
+
+    RenderGraph(GLsizei width, GLsizei height)
+        : m_width(width), m_height(height), m_compiled(false) {}
+
+    // Declares a transient resource and returns its handle.
+    int createTarget(const TargetDesc& desc) {
+        m_resources.push_back({desc, false, -1});
+        m_compiled = false;
+        return static_cast<int>(m_resources.size()) - 1;
+    }
+
+    // Keeps a resource alive (and its producers running) after the frame.
+    void exportTarget(int resource) {
+        m_resources[resource].exported = true;
+        m_compiled = false;
+    }
+
+    // `execute` runs with the output bound; inputs are resolved textures.
+    void addPass(const std::string& name, const std::vector<int>& inputs,
+                 int output, std::function<void(const RenderGraph&)> execute) {
+        m_passes.push_back({name, inputs, output, std::move(execute), false});
+        m_compiled = false;
+    }
+
+    // Size of the window; drops pooled targets that no longer fit.
+    void resize(GLsizei width, GLsizei height) {
+        m_width = width;
+        m_height = height;
+        m_pool.clear();
+        m_compiled = false;
+    }
+
+    void compile() {
+        // cull: walk backwards from the window and exported resources
+        std::vector<bool> needed(m_resources.size(), false);
+        for (std::size_t r = 0; r < m_resources.size(); r++) {
+            needed[r] = m_resources[r].exported;
+        }
+        for (std::size_t p = m_passes.size(); p-- > 0;) {
+            Pass& pass(m_passes[p]);
+            pass.live = pass.output == BACKBUFFER || needed[pass.output];
+            if (!pass.live) continue;
+            for (int r : pass.inputs) needed[r] = true;
+        }
+
+        // lifetimes in pass order
+        std::vector<int> first(m_resources.size(), -1);
+        std::vector<int> last(m_resources.size(), -1);
+        for (std::size_t p = 0; p < m_passes.size(); p++) {
+            const Pass& pass(m_passes[p]);
+            if (!pass.live) continue;
+            if (pass.output != BACKBUFFER) {
+                if (first[pass.output] < 0) first[pass.output] = int(p);
+                last[pass.output] = std::max(last[pass.output], int(p));
+            }
+            for (int r : pass.inputs) last[r] = std::max(last[r], int(p));
+        }
+        for (std::size_t r = 0; r < m_resources.size(); r++) {
+            if (m_resources[r].exported) last[r] = INT_MAX;
+        }
+
+        // assign pooled targets, reusing those whose resource has died;
+        // culled resources are left without one
+        for (Resource& res : m_resources) res.physical = -1;
+        std::vector<int> busy_until(m_pool.size(), -1);
+        for (std::size_t p = 0; p < m_passes.size(); p++) {
+            const Pass& pass(m_passes[p]);
+            if (!pass.live || pass.output == BACKBUFFER ||
+                first[pass.output] != static_cast<int>(p)) {
+                continue;
+            }
+            Resource& res(m_resources[pass.output]);
+            for (std::size_t t = 0; t < m_pool.size(); t++) {
+                if (busy_until[t] < static_cast<int>(p) &&
+                    Matches(*m_pool[t], res.desc)) {
+                    res.physical = static_cast<int>(t);
+                    break;
+                }
+            }
+            if (res.physical < 0) {
+                m_pool.emplace_back(new RenderTarget(
+                    Scaled(m_width, res.desc), Scaled(m_height, res.desc),
+                    res.desc.color_formats, res.desc.depth_format,
+                    res.desc.samples));
+                busy_until.emplace_back(-1);
+                res.physical = static_cast<int>(m_pool.size()) - 1;
+            }
+            busy_until[res.physical] = last[pass.output];
+        }
+        m_compiled = true;
+    }
+
+    void execute() {
+        if (!m_compiled) compile();
+        for (const Pass& pass : m_passes) {
+            if (!pass.live) continue;
+            if (pass.output == BACKBUFFER) {
+                RenderTarget::BindDefault(m_width, m_height);
+            } else {
+                target(pass.output)->bind();
+            }
+            pass.execute(*this);
+            if (pass.output != BACKBUFFER) target(pass.output)->resolve();
+        }
+        RenderTarget::BindDefault(m_width, m_height);
+    }
+
+    // Physical target of a resource; valid after compile().
+    const RenderTarget* target(int resource) const {
+        const int p(m_resources[resource].physical);
+        return p < 0 ? nullptr : m_pool[p].get();
+    }
+
+    bool live(const std::string& pass) const {
+        for (const Pass& p : m_passes) {
+            if (p.name == pass) return p.live;
+        }
+        return false;
+    }
+
+    std::size_t pooled() const { return m_pool.size(); }
+
+private:
+    struct Resource {
+        TargetDesc desc;
+        bool exported;
+        int physical;  // index into m_pool
+    };
+
+    struct Pass {
+        std::string name;
+        std::vector<int> inputs;
+        int output;
+        std::function<void(const RenderGraph&)> execute;
+        bool live;
+    };
+
+    static GLsizei Scaled(GLsizei size, const TargetDesc& desc) {
+        return std::max(static_cast<GLsizei>(size * desc.scale), 1);
+    }
+
+    bool Matches(const RenderTarget& t, const TargetDesc& desc) const {
+        return t.width() == Scaled(m_width, desc) &&
+               t.height() == Scaled(m_height, desc) &&
+               t.colorFormats() == desc.color_formats &&
+               t.depthFormat() == desc.depth_format &&
+               t.samples() == (desc.samples > 1 ? desc.samples : 0);
+    }
+
+    GLsizei m_width;
+    GLsizei m_height;
+    bool m_compiled;
+    std::vector<Resource> m_resources;
+    std::vector<Pass> m_passes;
+    std::vector<std::unique_ptr<RenderTarget>> m_pool;
+};
+
+// =============================== Occlusion ===============================
+
+// Fills only the depth buffer; draw with a position-only program so the
+// shading pass afterwards runs its fragment shader once per pixel. Both
+// programs must compute gl_Position with the same expression and declare
+// it `invariant`, or the GL_LEQUAL shading pass may fail against the
+// pre-pass depth (see depth.vert and naive_mvp.vert).
+inline void BeginDepthPrepass() {
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+}
+
+// Shades against the pre-pass depth without writing it again.
+inline void EndDepthPrepass() {
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(GL_FALSE);
+    glDepthFunc(GL_LEQUAL);
+}
+
+// Hardware occlusion culling. Each object's bounding box is rasterized as a
+// query against the current depth buffer; the result gates the object's
+// draws one frame later through conditional rendering, so the CPU never
+// waits on the GPU. Queries alternate between two sets per object. Boxes
+// are slightly inflated and tested with GL_LEQUAL so an object's own depth
+// never hides it.
+class OcclusionCuller {
+public:
+    explicit OcclusionCuller(GLsizei count = 0)
+        : m_box(SolidCube(1.0f)),
+          m_target(GLEW_ARB_occlusion_query2 ? GL_ANY_SAMPLES_PASSED
+                                             : GL_SAMPLES_PASSED),
+          m_frame(0),
+          m_conditional(false),
+          m_color_mask{GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE},
+          m_depth_mask(GL_TRUE),
+          m_depth_func(GL_LESS),
+          m_cull_face(GL_FALSE) {
+        resize(count);
+    }
+
+    virtual ~OcclusionCuller() { Release(); }
+
+    void resize(GLsizei count) {
+        Release();
+        for (auto& queries : m_queries) {
+            queries.resize(count);
+            glGenQueries(count, queries.data());
+        }
+        for (auto& issued : m_issued) issued.assign(count, false);
+    }
+
+    GLsizei size() const { return static_cast<GLsizei>(m_queries[0].size()); }
+
+    // Sets up the state for query(): no color or depth writes, both faces.
+    // The previous state is restored by endQueries().
+    void beginQueries() {
+        glGetBooleanv(GL_COLOR_WRITEMASK, m_color_mask);
+        glGetBooleanv(GL_DEPTH_WRITEMASK, &m_depth_mask);
+        glGetIntegerv(GL_DEPTH_FUNC, &m_depth_func);
+        m_cull_face = glIsEnabled(GL_CULL_FACE);
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glDepthMask(GL_FALSE);
+        glDepthFunc(GL_LEQUAL);
+        glDisable(GL_CULL_FACE);
+    }
+
+    void endQueries() {
+        glColorMask(m_color_mask[0], m_color_mask[1], m_color_mask[2],
+                    m_color_mask[3]);
+        glDepthMask(m_depth_mask);
+        glDepthFunc(m_depth_func);
+        if (m_cull_face == GL_TRUE) glEnable(GL_CULL_FACE);
+    }
+
+    // Tests the world-space box of object i with `program`, which must have
+    // a "model" matrix uniform and its view/projection already set. A box
+    // containing the eye is always visible and skips the query.
+    void query(GLsizei i, Program& program, const GLfloat min[3],
+               const GLfloat max[3], const GLfloat eye[3]) {
+        bool inside(true);
+        for (int k = 0; k < 3; k++) {
+            inside = inside && min[k] <= eye[k] && eye[k] <= max[k];
+        }
+        m_issued[m_frame][i] = !inside;
+        if (inside) return;
+
+        static constexpr GLfloat inflate(0.5f * 1.001f);
+        program.set("model"_hash,
+                    Matrix::Translate(0.5f * (min[0] + max[0]),
+                                      0.5f * (min[1] + max[1]),
+                                      0.5f * (min[2] + max[2])) *
+                        Matrix::Scale(inflate * (max[0] - min[0]),
+                                      inflate * (max[1] - min[1]),
+                                      inflate * (max[2] - min[2])));
+        glBeginQuery(m_target, m_queries[m_frame][i]);
+        m_box->draw(GL_TRIANGLES);
+        glEndQuery(m_target);
+    }
+
+    // Draws until endConditional() are skipped by the GPU when object i's
+    // box was hidden last frame. Pending results count as visible.
+    void beginConditional(GLsizei i) const {
+        const int prev(m_frame ^ 1);
+        m_conditional = m_issued[prev][i];
+        if (m_conditional) {
+            glBeginConditionalRender(m_queries[prev][i], GL_QUERY_NO_WAIT);
+        }
+    }
+
+    void endConditional() const {
+        if (m_conditional) glEndConditionalRender();
+        m_conditional = false;
+    }
+
+    // Call once at the end of the frame, after every beginConditional();
+    // the results issued this frame gate the next frame's draws.
+    void swap() {
+        m_frame ^= 1;
+        std::fill(m_issued[m_frame].begin(), m_issued[m_frame].end(), false);
+    }
+
+private:
+    OcclusionCuller(const OcclusionCuller& o);
+    OcclusionCuller& operator=(const OcclusionCuller& o);
+
+    void Release() {
+        for (auto& queries : m_queries) {
+            if (!queries.empty()) {
+                glDeleteQueries(static_cast<GLsizei>(queries.size()),
+                                queries.data());
+            }
+            queries.clear();
+        }
+    }
+
+    const std::unique_ptr<const GeometryIndex3D> m_box;
+    const GLenum m_target;
+    std::array<std::vector<GLuint>, 2> m_queries;
+    std::array<std::vector<bool>, 2> m_issued;
+    int m_frame;
+    mutable bool m_conditional;
+    GLboolean m_color_mask[4];
+    GLboolean m_depth_mask;
+    GLint m_depth_func;
+    GLboolean m_cull_face;
+};
+
+// =============================== Meshlet =================================
+
+// Cluster of consecutive triangles in a reordered index buffer, with the
+// bounds used for culling (model space).
+struct Meshlet {
+    GLuint index_offset;
+    GLuint index_count;
+    GLuint vertex_count;  // distinct vertices
+    GLfloat center[3];
+    GLfloat radius;
+    GLfloat cone_axis[3];  // average facing
+    GLfloat cone_sin;  // sine of the normal spread, 1 when unusable
+};
+
+// View-space frustum planes (a, b, c, d with unit normals pointing inward)
+// from the rows of the projection (Gribb/Hartmann).
+inline void FrustumPlanes(const Matrix& projection, GLfloat planes[6][4]) {
+    const GLfloat* const p(projection.Data());
+    for (int i = 0; i < 6; i++) {
+        const int row(i / 2);
+        const GLfloat sign(i % 2 == 0 ? 1.0f : -1.0f);
+        GLfloat length(0.0f);
+        for (int k = 0; k < 4; k++) {
+            planes[i][k] = p[k * 4 + 3] + sign * p[k * 4 + row];
+            if (k < 3) length += planes[i][k] * planes[i][k];
+        }
+        length = std::sqrt(length);
+        for (int k = 0; k < 4; k++) planes[i][k] /= length;
+    }
+}
+
+// Splits an indexed triangle list into meshlets of at most `max_vertices`
+// vertices and `max_triangles` triangles. Triangles are grown greedily
+// across shared vertices, preferring those adding the fewest new ones, so
+// clusters stay compact. `idx` is reordered so each meshlet is contiguous.
+// The limits are raised to at least one triangle of 3 vertices.
+inline void BuildMeshlets(const Vertex3D* vtx, GLsizei vtx_cnt,
+                          std::vector<GLuint>& idx,
+                          std::vector<Meshlet>& meshlets,
+                          GLuint max_vertices = 64,
+                          GLuint max_triangles = 124) {
+    const std::size_t tri_cnt(idx.size() / 3);
+    meshlets.clear();
+    max_vertices = std::max(max_vertices, 3u);
+    max_triangles = std::max(max_triangles, 1u);
+
+    // vertex -> triangles
+    std::vector<GLuint> start(vtx_cnt + 1, 0), adjacency(tri_cnt * 3);
+    for (const GLuint v : idx) start[v + 1]++;
+    for (GLsizei v = 0; v < vtx_cnt; v++) start[v + 1] += start[v];
+    {
+        std::vector<GLuint> fill(start.begin(), start.end() - 1);
+        for (std::size_t t = 0; t < tri_cnt; t++) {
+            for (int k = 0; k < 3; k++) {
+                adjacency[fill[idx[t * 3 + k]]++] = static_cast<GLuint>(t);
+            }
+        }
+    }
+
+    std::vector<GLfloat> normals(tri_cnt * 3);
+    for (std::size_t t = 0; t < tri_cnt; t++) {
+        const GLfloat* const a(vtx[idx[t * 3]].position);
+        const GLfloat* const b(vtx[idx[t * 3 + 1]].position);
+        const GLfloat* const c(vtx[idx[t * 3 + 2]].position);
+        const GLfloat u[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        const GLfloat w[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        GLfloat* const n(&normals[t * 3]);
+        n[0] = u[1] * w[2] - u[2] * w[1];
+        n[1] = u[2] * w[0] - u[0] * w[2];
+        n[2] = u[0] * w[1] - u[1] * w[0];
+        const GLfloat length(
+            std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]));
+        for (int k = 0; k < 3; k++) {
+            n[k] = length > 0.0f ? n[k] / length : 0.0f;
+        }
+    }
+
+    std::vector<GLuint> reordered;
+    reordered.reserve(idx.size());
+    std::vector<bool> used(tri_cnt, false);
+    std::vector<GLuint> owner(vtx_cnt, ~0u);  // meshlet holding a vertex
+    std::vector<GLuint> verts, tris, candidates;
+    auto fresh = [&](std::size_t t, GLuint id) {
+        return (owner[idx[t * 3]] != id) + (owner[idx[t * 3 + 1]] != id) +
+               (owner[idx[t * 3 + 2]] != id);
+    };
+
+    for (std::size_t seed = 0; seed < tri_cnt; seed++) {
+        if (used[seed]) continue;
+        const GLuint id(static_cast<GLuint>(meshlets.size()));
+        verts.clear();
+        tris.clear();
+        candidates.assign(1, static_cast<GLuint>(seed));
+        while (!candidates.empty() && tris.size() < max_triangles) {
+            // candidate adding the fewest vertices
+            std::size_t best(0);
+            unsigned int best_new(4);  // none found
+            for (std::size_t i = 0; i < candidates.size();) {
+                if (used[candidates[i]]) {
+                    candidates[i] = candidates.back();
+                    candidates.pop_back();
+                    continue;
+                }
+                const unsigned int n(fresh(candidates[i], id));
+                if (n < best_new && verts.size() + n <= max_vertices) {
+                    best = i;
+                    best_new = n;
+                    if (n == 0) break;
+                }
+                i++;
+            }
+            if (best_new == 4) break;
+            const GLuint t(candidates[best]);
+            used[t] = true;
+            tris.emplace_back(t);
+            for (int k = 0; k < 3; k++) {
+                const GLuint v(idx[t * 3 + k]);
+                if (owner[v] == id) continue;
+                owner[v] = id;
+                verts.emplace_back(v);
+                for (GLuint a = start[v]; a < start[v + 1]; a++) {
+                    if (!used[adjacency[a]]) {
+                        candidates.emplace_back(adjacency[a]);
+                    }
+                }
+            }
+        }
+
+        Meshlet m;
+        m.index_offset = static_cast<GLuint>(reordered.size());
+        m.index_count = static_cast<GLuint>(tris.size() * 3);
+        m.vertex_count = static_cast<GLuint>(verts.size());
+        for (const GLuint t : tris) {
+            for (int k = 0; k < 3; k++) reordered.emplace_back(idx[t * 3 + k]);
+        }
+
+        // sphere around the box center
+        GLfloat lo[3], hi[3];
+        for (int k = 0; k < 3; k++) {
+            lo[k] = hi[k] = vtx[verts[0]].position[k];
+        }
+        for (const GLuint v : verts) {
+            for (int k = 0; k < 3; k++) {
+                lo[k] = std::min(lo[k], vtx[v].position[k]);
+                hi[k] = std::max(hi[k], vtx[v].position[k]);
+            }
+        }
+        for (int k = 0; k < 3; k++) m.center[k] = 0.5f * (lo[k] + hi[k]);
+        GLfloat r2(0.0f);
+        for (const GLuint v : verts) {
+            GLfloat d2(0.0f);
+            for (int k = 0; k < 3; k++) {
+                const GLfloat d(vtx[v].position[k] - m.center[k]);
+                d2 += d * d;
+            }
+            r2 = std::max(r2, d2);
+        }
+        m.radius = std::sqrt(r2);
+
+        // normal cone
+        GLfloat axis[3] = {0.0f, 0.0f, 0.0f};
+        for (const GLuint t : tris) {
+            for (int k = 0; k < 3; k++) axis[k] += normals[t * 3 + k];
+        }
+        const GLfloat length(std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] +
+                                       axis[2] * axis[2]));
+        GLfloat min_cos(length > 0.0f ? 1.0f : -1.0f);
+        for (int k = 0; k < 3; k++) {
+            m.cone_axis[k] = length > 0.0f ? axis[k] / length : 0.0f;
+        }
+        for (const GLuint t : tris) {
+            const GLfloat* const n(&normals[t * 3]);
+            min_cos = std::min(min_cos, n[0] * m.cone_axis[0] +
+                                            n[1] * m.cone_axis[1] +
+                                            n[2] * m.cone_axis[2]);
+        }
+        m.cone_sin = min_cos > 0.0f ? std::sqrt(1.0f - min_cos * min_cos)
+                                    : 1.0f;
+        meshlets.emplace_back(m);
+    }
+    idx.swap(reordered);
+}
+
+// Indexed mesh split into meshlets. cull() tests every meshlet against the
+// view frustum and its normal cone, then draw() renders the survivors as
+// merged index ranges with one glMultiDrawElements().
+class MeshletGeometry {
+public:
+    MeshletGeometry(GLsizei vtx_cnt, const Vertex3D* vtx, GLsizei idx_cnt,
+                    const GLuint* idx, GLuint max_vertices = 64,
+                    GLuint max_triangles = 124) {
+        std::vector<GLuint> reordered(idx, idx + idx_cnt);
+        BuildMeshlets(vtx, vtx_cnt, reordered, m_meshlets, max_vertices,
+                      max_triangles);
+        m_geometry.reset(new GeometryIndex3D(
+            3, vtx_cnt, vtx, static_cast<GLsizei>(reordered.size()),
+            reordered.data()));
+        m_visible.assign(m_meshlets.size(), 1);
+        Compact();
+    }
+
+    // Keeps the meshlets that may be visible through `projection` from the
+    // origin of view space. `modelview` may rotate, translate and scale
+    // uniformly. Returns the number of triangles left to draw.
+    GLsizei cull(const Matrix& modelview, const Matrix& projection,
+                 ThreadPool& pool = DefaultThreadPool()) {
+        const GLfloat* const mv(modelview.Data());
+        GLfloat planes[6][4];
+        FrustumPlanes(projection, planes);
+        GLfloat scale(0.0f);
+        for (int c = 0; c < 3; c++) {
+            scale = std::max(scale, std::sqrt(mv[c * 4] * mv[c * 4] +
+                                              mv[c * 4 + 1] * mv[c * 4 + 1] +
+                                              mv[c * 4 + 2] * mv[c * 4 + 2]));
+        }
+
+        static constexpr int chunk(256);
+        const int count(static_cast<int>(m_meshlets.size()));
+        pool.parallelFor((count + chunk - 1) / chunk, [&](int c) {
+            const int end(std::min(count, (c + 1) * chunk));
+            for (int i = c * chunk; i < end; i++) {
+                const Meshlet& m(m_meshlets[i]);
+                GLfloat center[3], axis[3];
+                for (int k = 0; k < 3; k++) {
+                    center[k] = mv[k] * m.center[0] + mv[4 + k] * m.center[1] +
+                                mv[8 + k] * m.center[2] + mv[12 + k];
+                    axis[k] = (mv[k] * m.cone_axis[0] +
+                               mv[4 + k] * m.cone_axis[1] +
+                               mv[8 + k] * m.cone_axis[2]) / scale;
+                }
+                const GLfloat radius(m.radius * scale);
+                bool visible(true);
+                for (int j = 0; j < 6 && visible; j++) {
+                    visible = planes[j][0] * center[0] +
+                                  planes[j][1] * center[1] +
+                                  planes[j][2] * center[2] + planes[j][3] >=
+                              -radius;
+                }
+                // back-facing when every direction from the eye into the
+                // sphere is within 90 degrees minus the spread of the axis
+                if (visible && m.cone_sin < 1.0f) {
+                    const GLfloat distance(std::sqrt(center[0] * center[0] +
+                                                     center[1] * center[1] +
+                                                     center[2] * center[2]));
+                    visible = center[0] * axis[0] + center[1] * axis[1] +
+                                  center[2] * axis[2] <=
+                              m.cone_sin * distance +
+                                  radius * (1.0f + m.cone_sin);
+                }
+                m_visible[i] = visible;
+            }
+        });
+        return Compact();
+    }
+
+    void draw(GLenum mode = GL_TRIANGLES) const {
+        if (m_counts.empty()) return;
+        m_geometry->object().bind();
+        glMultiDrawElements(mode, m_counts.data(), GL_UNSIGNED_INT,
+                            m_offsets.data(),
+                            static_cast<GLsizei>(m_counts.size()));
+    }
+
+    const std::vector<Meshlet>& meshlets() const { return m_meshlets; }
+    // Index ranges of the last cull(); adjacent meshlets are merged.
+    GLsizei ranges() const { return static_cast<GLsizei>(m_counts.size()); }
+
+private:
+    MeshletGeometry(const MeshletGeometry& o);
+    MeshletGeometry& operator=(const MeshletGeometry& o);
+
+    GLsizei Compact() {
+        m_counts.clear();
+        m_offsets.clear();
+        GLsizei triangles(0), end(-1);
+        for (std::size_t i = 0; i < m_meshlets.size(); i++) {
+            if (!m_visible[i]) continue;
+            const Meshlet& m(m_meshlets[i]);
+            if (static_cast<GLsizei>(m.index_offset) == end) {
+                m_counts.back() += m.index_count;
+            } else {
+                m_counts.emplace_back(m.index_count);
+                m_offsets.emplace_back(static_cast<const char*>(0) +
+                                       m.index_offset * sizeof(GLuint));
+            }
+            end = m.index_offset + m.index_count;
+            triangles += m.index_count / 3;
+        }
+        return triangles;
+    }
+
+    std::unique_ptr<const GeometryIndex3D> m_geometry;
+    std::vector<Meshlet> m_meshlets;
+    std::vector<char> m_visible;  // written concurrently, so not bool
+    std::vector<GLsizei> m_counts;
+    std::vector<const void*> m_offsets;
+};
+
+// =============================== Batch 2D ================================
+
+struct BatchVertex {
+    GLfloat position[2];
+    GLfloat texcoord[2];
+    GLubyte color[4];  // normalized RGBA
+};
+
+// Immediate-mode 2D renderer for overlays. Filled and outlined rectangles,
+// lines and sprites are collected into one streamed vertex buffer and drawn
+// as indexed triangles with one draw per texture/program change. Positions
+// follow the keep_aspect/keep_scale conventions of the rect examples; line
+// thickness is in pixels.
+class SpriteBatch {
+public:
+    enum Fit {
+        KEEP_ASPECT,  // x divided by the aspect ratio, y in [-1, 1]
+        KEEP_SCALE    // window.GetScale() pixels per unit, moved by location
+    };
+
+    explicit SpriteBatch(GLsizei max_quads = 4096)
+        : m_max_quads(max_quads),
+          m_builtin(CreateProgram(VertexSource(), FragmentSource())),
+          m_program(&m_builtin),
+          m_texture(0),
+          m_draws(0),
+          m_memory(MemoryTag::STREAMING) {
+        glGenVertexArrays(1, &m_vao);
+        glBindVertexArray(m_vao);
+
+        glGenBuffers(1, &m_vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        glBufferData(GL_ARRAY_BUFFER, max_quads * 4 * sizeof(BatchVertex),
+                     nullptr, GL_STREAM_DRAW);
+        const GLsizei stride(sizeof(BatchVertex));
+        char* const base(static_cast<char*>(0));
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride,
+                              base + offsetof(BatchVertex, position));
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, stride,
+                              base + offsetof(BatchVertex, texcoord));
+        glEnableVertexAttribArray(4);
+        glVertexAttribPointer(5, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                              base + offsetof(BatchVertex, color));
+        glEnableVertexAttribArray(5);
+
+        // the quad pattern never changes, only vertices are streamed
+        std::vector<GLuint> idx;
+        idx.reserve(max_quads * 6);
+        for (GLuint q = 0; q < static_cast<GLuint>(max_quads); q++) {
+            for (GLuint i : {0u, 1u, 2u, 0u, 2u, 3u}) {
+                idx.emplace_back(q * 4 + i);
+            }
+        }
+        glGenBuffers(1, &m_ibo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_ibo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx.size() * sizeof(GLuint),
+                     idx.data(), GL_STATIC_DRAW);
+
+        static constexpr GLubyte white[] = {255, 255, 255, 255};
+        glGenTextures(1, &m_white);
+        glBindTexture(GL_TEXTURE_2D, m_white);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA,
+                     GL_UNSIGNED_BYTE, white);
+        SetSampler(GL_TEXTURE_2D, false, GL_CLAMP_TO_EDGE);
+        m_vertices.reserve(max_quads * 4);
+        m_memory.add(max_quads * 4 * sizeof(BatchVertex));
+        m_memory.add(idx.size() * sizeof(GLuint));
+        m_memory.add(sizeof(white));
+    }
+
+    virtual ~SpriteBatch() {
+        glDeleteVertexArrays(1, &m_vao);
+        glDeleteBuffers(1, &m_vbo);
+        glDeleteBuffers(1, &m_ibo);
+        glDeleteTextures(1, &m_white);
+    }
+
+    // Starts a frame with the mapping of the window's current size.
+    void begin(const Window& window, Fit fit = KEEP_ASPECT) {
+        if (fit == KEEP_ASPECT) {
+            m_scale[0] = 1.0f / window.GetAspect();
+            m_scale[1] = 1.0f;
+            m_offset[0] = m_offset[1] = 0.0f;
+        } else {
+            m_scale[0] = 2.0f * window.GetScale() / window.GetWidth();
+            m_scale[1] = 2.0f * window.GetScale() / window.GetHeight();
+            m_offset[0] = window.GetLocation()[0];
+            m_offset[1] = window.GetLocation()[1];
+        }
+        // pixels per unit, for thickness
+        m_pixels[0] = 0.5f * m_scale[0] * window.GetWidth();
+        m_pixels[1] = 0.5f * m_scale[1] * window.GetHeight();
+        m_draws = 0;
+    }
+
+    // Flushes and draws the rest of the frame.
+    void end() { flush(); }
+
+    // 0 draws untextured.
+    void setTexture(GLuint texture) {
+        if (texture == m_texture) return;
+        flush();
+        m_texture = texture;
+    }
+
+    // Replaces the built-in program (nullptr restores it); it must accept
+    // the same attributes and "scale", "offset" and "image" uniforms.
+    void setProgram(Program* program) {
+        if (program == nullptr) program = &m_builtin;
+        if (program == m_program) return;
+        flush();
+        m_program = program;
+    }
+
+    void fillRect(GLfloat x, GLfloat y, GLfloat w, GLfloat h,
+                  const Vector& color) {
+        sprite(x, y, w, h, {{0.0f, 0.0f, 1.0f, 1.0f}}, color);
+    }
+
+    // Textured rectangle; uv is {u0, v0, u1, v1} as TextureAtlas returns.
+    void sprite(GLfloat x, GLfloat y, GLfloat w, GLfloat h,
+                const std::array<GLfloat, 4>& uv,
+                const Vector& color = {{1.0f, 1.0f, 1.0f, 1.0f}}) {
+        const GLfloat position[] = {x, y, x + w, y, x + w, y + h, x, y + h};
+        const GLfloat texcoord[] = {uv[0], uv[1], uv[2], uv[1],
+                                    uv[2], uv[3], uv[0], uv[3]};
+        quad(position, texcoord, color);
+    }
+
+    // Outline `thickness` pixels wide, inside the rectangle.
+    void rect(GLfloat x, GLfloat y, GLfloat w, GLfloat h, GLfloat thickness,
+              const Vector& color) {
+        const GLfloat tx(std::min(thickness / m_pixels[0], 0.5f * w));
+        const GLfloat ty(std::min(thickness / m_pixels[1], 0.5f * h));
+        fillRect(x, y, w, ty, color);
+        fillRect(x, y + h - ty, w, ty, color);
+        fillRect(x, y + ty, tx, h - 2.0f * ty, color);
+        fillRect(x + w - tx, y + ty, tx, h - 2.0f * ty, color);
+    }
+
+    void line(GLfloat x0, GLfloat y0, GLfloat x1, GLfloat y1,
+              GLfloat thickness, const Vector& color) {
+        // perpendicular measured in pixels so anisotropic scales keep width
+        const GLfloat dx((x1 - x0) * m_pixels[0]);
+        const GLfloat dy((y1 - y0) * m_pixels[1]);
+        const GLfloat length(std::sqrt(dx * dx + dy * dy));
+        if (length == 0.0f) return;
+        const GLfloat nx(-dy / length * 0.5f * thickness / m_pixels[0]);
+        const GLfloat ny(dx / length * 0.5f * thickness / m_pixels[1]);
+        const GLfloat position[] = {x0 - nx, y0 - ny, x1 - nx, y1 - ny,
+                                    x1 + nx, y1 + ny, x0 + nx, y0 + ny};
+        static constexpr GLfloat texcoord[8] = {};
+        quad(position, texcoord, color);
+    }
+
+    // Four corners in counter-clockwise order.
+    void quad(const GLfloat* position, const GLfloat* texcoord,
+              const Vector& color) {
+        if (m_vertices.size() == static_cast<std::size_t>(m_max_quads) * 4) {
+            flush();
+        }
+        BatchVertex v;
+        for (int k = 0; k < 4; k++) {
+            v.color[k] = static_cast<GLubyte>(
+                std::min(std::max(color[k], 0.0f), 1.0f) * 255.0f + 0.5f);
+        }
+        for (int i = 0; i < 4; i++) {
+            v.position[0] = position[i * 2];
+            v.position[1] = position[i * 2 + 1];
+            v.texcoord[0] = texcoord[i * 2];
+            v.texcoord[1] = texcoord[i * 2 + 1];
+            m_vertices.emplace_back(v);
+        }
+    }
+
+    // Draws everything queued so far in one call.
+    void flush() {
+        if (m_vertices.empty()) return;
+        m_program->use();
+        m_program->set("scale"_hash, m_scale, 1);
+        m_program->set("offset"_hash, m_offset, 1);
+        m_program->set("image"_hash, 0);
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, m_texture != 0 ? m_texture : m_white);
+
+        glBindVertexArray(m_vao);
+        glBindBuffer(GL_ARRAY_BUFFER, m_vbo);
+        const GLsizeiptr bytes(m_vertices.size() * sizeof(BatchVertex));
+        glBufferData(GL_ARRAY_BUFFER, m_max_quads * 4 * sizeof(BatchVertex),
+                     nullptr, GL_STREAM_DRAW);  // orphan the last frame's
+        glBufferSubData(GL_ARRAY_BUFFER, 0, bytes, m_vertices.data());
+        glDrawElements(GL_TRIANGLES,
+                       static_cast<GLsizei>(m_vertices.size() / 4 * 6),
+                       GL_UNSIGNED_INT, 0);
+        m_vertices.clear();
+        m_draws++;
+    }
+
+    // Draw calls issued since begin().
+    GLsizei draws() const { return m_draws; }
+
+private:
+    SpriteBatch(const SpriteBatch& o);
+    SpriteBatch& operator=(const SpriteBatch& o);
+
+    static const char* VertexSource() {
+        return "#version 150 core\n"
+               "uniform vec2 scale;\n"
+               "uniform vec2 offset;\n"
+               "in vec4 position;\n"
+               "in vec2 texcoord;\n"
+               "in vec4 color;\n"
+               "out vec2 uv;\n"
+               "out vec4 tint;\n"
+               "void main() {\n"
+               "    uv = texcoord;\n"
+               "    tint = color;\n"
+               "    gl_Position = vec4(position.xy * scale + offset, 0.0, "
+               "1.0);\n"
+               "}\n";
+    }
+
+    static const char* FragmentSource() {
+        return "#version 150 core\n"
+               "uniform sampler2D image;\n"
+               "in vec2 uv;\n"
+               "in vec4 tint;\n"
+               "out vec4 fragment;\n"
+               "void main() { fragment = tint * texture(image, uv); }\n";
+    }
+
+    const GLsizei m_max_quads;
+    Program m_builtin;
+    Program* m_program;
+    GLuint m_vao;
+    GLuint m_vbo;
+    GLuint m_ibo;
+    GLuint m_white;
+    GLuint m_texture;
+    GLfloat m_scale[2];
+    GLfloat m_offset[2];
+    GLfloat m_pixels[2];
+    GLsizei m_draws;
+    std::vector<BatchVertex> m_vertices;
+    MemoryRecord m_memory;
+};
+
+// ============================= Point Cloud ===============================
+
+// Point as stored in a cloud file and in its vertex buffers.
+struct CloudPoint {
+    GLfloat position[3];
+    GLubyte color[4];
+};
+
+// Octree file written by BuildPointCloud(): this header, the points of each
+// node in a page-aligned chunk of its own, then the node table at
+// `table_offset`. A node keeps one point per cell of a grid over its cube
+// and passes the rest to its children, so a node and any of its children
+// drawn together never repeat a point.
+struct PointCloudHeader {
+    char magic[8];  // "TGRPCD1"
+    std::uint32_t node_count;
+    std::uint32_t reserved;
+    std::uint64_t point_count;
+    std::uint64_t table_offset;
+};
+
+struct PointNode {
+    GLfloat center[3];
+    GLfloat half;     // half the edge of the cube
+    GLfloat spacing;  // edge of a sampling cell
+    std::uint32_t children[8];  // node index, 0 when absent (0 is the root)
+    std::uint32_t count;
+    std::uint64_t offset;  // byte offset of the points
+};
+
+// Builds the octree file `output` from `input`, a raw array of CloudPoint
+// that need not fit in memory. Nodes are split through temporary files next
+// to `output`, so at most one node's points and a `grid`^3 occupancy mask
+// are held at a time. Nodes of at most `max_points` points become leaves.
+inline bool BuildPointCloud(const std::string input, const std::string output,
+                            std::uint32_t max_points = 65536, int grid = 64) {
+    static constexpr std::size_t block(65536);
+    static constexpr int max_depth(24);  // beyond it, duplicates are dropped
+    static constexpr std::uint64_t page(4096);
+    std::vector<CloudPoint> points(block);
+
+    // pass 1: bounds
+    std::ifstream in(input, std::ios::binary);
+    if (in.fail()) {
+        std::cerr << "Error: Can't open " << input << std::endl;
+        return false;
+    }
+    const GLfloat inf(std::numeric_limits<GLfloat>::infinity());
+    GLfloat lo[3] = {inf, inf, inf};
+    GLfloat hi[3] = {-inf, -inf, -inf};
+    std::uint64_t total(0);
+    for (;;) {
+        in.read(reinterpret_cast<char*>(points.data()),
+                block * sizeof(CloudPoint));
+        const std::size_t n(in.gcount() / sizeof(CloudPoint));
+        for (std::size_t i = 0; i < n; i++) {
+            for (int k = 0; k < 3; k++) {
+                lo[k] = std::min(lo[k], points[i].position[k]);
+                hi[k] = std::max(hi[k], points[i].position[k]);
+            }
+        }
+        total += n;
+        if (n < block) break;
+    }
+    in.close();
+    if (total == 0) {
+        std::cerr << input << " has no points" << std::endl;
+        return false;
+    }
+
+    std::ofstream out(output, std::ios::binary);
+    if (out.fail()) {
+        std::cerr << "Error: Can't open " << output << std::endl;
+        return false;
+    }
+    PointCloudHeader header = {{'T', 'G', 'R', 'P', 'C', 'D', '1', '\0'},
+                               0, 0, total, 0};
+    out.write(reinterpret_cast<const char*>(&header), sizeof header);
+
+    struct Task {
+        std::string source;
+        std::uint64_t count;
+        GLfloat center[3];
+        GLfloat half;
+        int depth;
+        std::uint32_t parent;
+        int octant;
+    };
+    Task root = {input, total, {}, 0.0f, 0, 0, -1};
+    for (int k = 0; k < 3; k++) {
+        root.center[k] = 0.5f * (lo[k] + hi[k]);
+        root.half = std::max(root.half, 0.5f * (hi[k] - lo[k]));
+    }
+    root.half = root.half * 1.001f + 1e-6f;  // keep the maximum inside
+
+    std::vector<PointNode> nodes;
+    std::vector<char> occupied(static_cast<std::size_t>(grid) * grid * grid);
+    std::vector<CloudPoint> kept;
+    std::vector<Task> stack(1, root);
+    int temporaries(0);
+    while (!stack.empty()) {
+        const Task t(std::move(stack.back()));
+        stack.pop_back();
+        const std::uint32_t index(static_cast<std::uint32_t>(nodes.size()));
+        PointNode node = {{t.center[0], t.center[1], t.center[2]},
+                          t.half, 2.0f * t.half / grid, {}, 0, 0};
+        if (t.octant >= 0) nodes[t.parent].children[t.octant] = index;
+
+        // keep the first point of each cell, route the rest to children
+        const bool leaf(t.count <= max_points || t.depth >= max_depth);
+        Task child[8];
+        std::ofstream child_out[8];
+        std::vector<CloudPoint> child_buf[8];
+        auto spill = [&](int c) {
+            if (!child_out[c].is_open()) {
+                child[c].source =
+                    output + ".tmp" + std::to_string(temporaries++);
+                child_out[c].open(child[c].source, std::ios::binary);
+            }
+            child_out[c].write(
+                reinterpret_cast<const char*>(child_buf[c].data()),
+                child_buf[c].size() * sizeof(CloudPoint));
+            child[c].count += child_buf[c].size();
+            child_buf[c].clear();
+        };
+        for (int c = 0; c < 8; c++) {
+            child[c].count = 0;
+            child[c].half = 0.5f * t.half;
+            for (int k = 0; k < 3; k++) {
+                child[c].center[k] =
+                    t.center[k] + (c >> k & 1 ? 0.5f : -0.5f) * t.half;
+            }
+            child[c].depth = t.depth + 1;
+            child[c].parent = index;
+            child[c].octant = c;
+        }
+        std::fill(occupied.begin(), occupied.end(), 0);
+        kept.clear();
+        in.open(t.source, std::ios::binary);
+        for (std::uint64_t read = 0; read < t.count;) {
+            const std::size_t n(static_cast<std::size_t>(
+                std::min<std::uint64_t>(block, t.count - read)));
+            in.read(reinterpret_cast<char*>(points.data()),
+                    n * sizeof(CloudPoint));
+            if (static_cast<std::size_t>(in.gcount()) !=
+                n * sizeof(CloudPoint)) {
+                std::cerr << "Error: Can't read " << t.source << std::endl;
+                return false;
+            }
+            read += n;
+            for (std::size_t i = 0; i < n; i++) {
+                const CloudPoint& p(points[i]);
+                if (leaf) {
+                    if (kept.size() < max_points) kept.emplace_back(p);
+                    continue;
+                }
+                std::size_t cell(0);
+                int octant(0);
+                for (int k = 2; k >= 0; k--) {
+                    const GLfloat u((p.position[k] - t.center[k]) / t.half);
+                    const int g(std::min(
+                        std::max(static_cast<int>((u + 1.0f) * 0.5f * grid),
+                                 0),
+                        grid - 1));
+                    cell = cell * grid + g;
+                    octant = octant * 2 + (u >= 0.0f);
+                }
+                if (!occupied[cell]) {
+                    occupied[cell] = 1;
+                    kept.emplace_back(p);
+                } else {
+                    child_buf[octant].emplace_back(p);
+                    if (child_buf[octant].size() == block) spill(octant);
+                }
+            }
+        }
+        in.close();
+        in.clear();
+        if (t.source != input) std::remove(t.source.c_str());
+
+        // page-aligned so a node maps without touching its neighbours
+        const std::uint64_t at(static_cast<std::uint64_t>(out.tellp()));
+        const std::vector<char> pad((page - at % page) % page, 0);
+        out.write(pad.data(), pad.size());
+        node.offset = at + pad.size();
+        node.count = static_cast<std::uint32_t>(kept.size());
+        out.write(reinterpret_cast<const char*>(kept.data()),
+                  kept.size() * sizeof(CloudPoint));
+        nodes.emplace_back(node);
+
+        for (int c = 7; c >= 0; c--) {
+            if (!child_buf[c].empty()) spill(c);
+            if (child[c].count == 0) continue;
+            child_out[c].close();
+            stack.emplace_back(std::move(child[c]));
+        }
+    }
+
+    const std::uint64_t at(static_cast<std::uint64_t>(out.tellp()));
+    const std::vector<char> pad((8 - at % 8) % 8, 0);
+    out.write(pad.data(), pad.size());
+    header.node_count = static_cast<std::uint32_t>(nodes.size());
+    header.table_offset = at + pad.size();
+    out.write(reinterpret_cast<const char*>(nodes.data()),
+              nodes.size() * sizeof(PointNode));
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof header);
+    if (out.fail()) {
+        std::cerr << "Error: Can't write " << output << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Streams a file from BuildPointCloud(). update() picks the nodes to draw
+// by how far apart their points land on screen, nearest detail first, up
+// to a point budget, and requests missing ones from a worker thread that
+// copies them out of the mapping. Vertex buffers are kept in an LRU cache
+// of at most `budget` bytes, so frame time and memory stay bounded however
+// large the file is.
+class PointCloud {
+public:
+    explicit PointCloud(const std::string name, GLsizeiptr budget = 256 << 20)
+        : m_file(name),
+          m_header(),
+          m_budget(budget),
+          m_resident(0),
+          m_program(CreateProgram(VertexSource(), FragmentSource())),
+          m_pixels(0.0f),
+          m_scale(1.0f),
+          m_frame(0),
+          m_points(0),
+          m_drawn(0),
+          m_quit(false) {
+        if (!Validate(m_file, m_header)) {
+            std::cerr << "Error: Invalid point cloud " << name << std::endl;
+            m_header.node_count = 0;
+        }
+        m_worker = std::thread(&PointCloud::Work, this);
+    }
+
+    virtual ~PointCloud() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_quit = true;
+        }
+        m_cond.notify_all();
+        m_worker.join();
+        for (auto& r : m_cache) {
+            glDeleteVertexArrays(1, &r.second.vao);
+            glDeleteBuffers(1, &r.second.vbo);
+            DefaultMemoryTracker().release(MemoryTag::STREAMING,
+                                           MemoryKind::GPU,
+                                           r.second.count * sizeof(CloudPoint));
+        }
+    }
+
+    // Selects the nodes to draw from `modelview` (which may scale only
+    // uniformly) and a perspective `projection` for a viewport `height`
+    // pixels tall. Children are refined while their parent's sampling cell
+    // covers more than `pixels` pixels. Uploads at most `upload` bytes of
+    // streamed nodes. Call once per frame on the GL thread.
+    void update(const Matrix& modelview, const Matrix& projection,
+                GLsizei height, GLsizei point_budget = 4 << 20,
+                GLfloat pixels = 2.0f, GLsizeiptr upload = 8 << 20) {
+        m_frame++;
+        m_modelview = modelview;
+        m_projection = projection;
+        m_selected.clear();
+        m_points = 0;
+        if (m_header.node_count == 0) return;
+
+        const GLfloat* const mv(modelview.Data());
+        GLfloat planes[6][4];
+        FrustumPlanes(projection, planes);
+        GLfloat scale(0.0f);
+        for (int c = 0; c < 3; c++) {
+            scale = std::max(scale, std::sqrt(mv[c * 4] * mv[c * 4] +
+                                              mv[c * 4 + 1] * mv[c * 4 + 1] +
+                                              mv[c * 4 + 2] * mv[c * 4 + 2]));
+        }
+        m_scale = scale;
+        // pixels covered by one unit at distance one
+        m_pixels = 0.5f * height * projection.Data()[5];
+
+        // largest projected cell first
+        std::priority_queue<std::pair<GLfloat, std::uint32_t>> queue;
+        auto visit = [&](std::uint32_t i) {
+            const PointNode n(Node(i));
+            GLfloat center[3];
+            for (int k = 0; k < 3; k++) {
+                center[k] = mv[k] * n.center[0] + mv[4 + k] * n.center[1] +
+                            mv[8 + k] * n.center[2] + mv[12 + k];
+            }
+            const GLfloat radius(n.half * 1.7320508f * scale);
+            for (int j = 0; j < 6; j++) {
+                if (planes[j][0] * center[0] + planes[j][1] * center[1] +
+                        planes[j][2] * center[2] + planes[j][3] <
+                    -radius) {
+                    return;
+                }
+            }
+            const GLfloat distance(
+                std::max(std::sqrt(center[0] * center[0] +
+                                   center[1] * center[1] +
+                                   center[2] * center[2]) -
+                             radius,
+                         1e-6f));
+            queue.emplace(n.spacing * scale * m_pixels / distance, i);
+        };
+        visit(0);
+        while (!queue.empty()) {
+            const std::pair<GLfloat, std::uint32_t> top(queue.top());
+            queue.pop();
+            const PointNode n(Node(top.second));
+            if (m_points + static_cast<GLsizei>(n.count) > point_budget) {
+                continue;
+            }
+            m_points += n.count;
+            m_selected.emplace_back(top.second);
+            if (top.first <= pixels) continue;
+            for (std::uint32_t c : n.children) {
+                if (c != 0 && c < m_header.node_count) visit(c);
+            }
+        }
+
+        for (std::uint32_t i : m_selected) {
+            const auto it(m_cache.find(i));
+            if (it == m_cache.end()) continue;
+            m_lru.splice(m_lru.begin(), m_lru, it->second.lru);
+            it->second.frame = m_frame;
+        }
+        Stream(upload);
+        // most urgent first, as the queue ordered them
+        for (std::uint32_t i : m_selected) {
+            if (m_cache.find(i) == m_cache.end()) Request(i);
+        }
+    }
+
+    // Draws the selected nodes that are resident with their points scaled
+    // to `size` sampling cells.
+    void draw(GLfloat size = 1.0f) {
+        m_program.use();
+        m_program.set("modelview"_hash, m_modelview);
+        m_program.set("projection"_hash, m_projection);
+        m_program.set("scale"_hash, m_pixels);
+        glEnable(GL_PROGRAM_POINT_SIZE);
+        m_drawn = 0;
+        for (std::uint32_t i : m_selected) {
+            const auto it(m_cache.find(i));
+            if (it == m_cache.end()) continue;
+            m_program.set("size"_hash, Node(i).spacing * m_scale * size);
+            glBindVertexArray(it->second.vao);
+            glDrawArrays(GL_POINTS, 0, it->second.count);
+            m_drawn += it->second.count;
+        }
+        glDisable(GL_PROGRAM_POINT_SIZE);
+    }
+
+    bool valid() const { return m_header.node_count != 0; }
+    std::uint64_t size() const { return m_header.point_count; }
+    std::uint32_t nodes() const { return m_header.node_count; }
+    // Points selected by the last update() and actually drawn by draw().
+    GLsizei selected() const { return m_points; }
+    GLsizei drawn() const { return m_drawn; }
+    // Bytes of vertex buffers held.
+    GLsizeiptr resident() const { return m_resident; }
+
+    // Checks the magic and that the table and every chunk lie inside the
+    // file.
+    static bool Validate(const MappedFile& file, PointCloudHeader& header) {
+        if (file.data() == nullptr || file.size() < sizeof header) {
+            return false;
+        }
+        std::memcpy(&header, file.data(), sizeof header);
+        if (std::memcmp(header.magic, "TGRPCD1", 8) != 0 ||
+            header.node_count == 0 || header.table_offset > file.size() ||
+            (file.size() - header.table_offset) / sizeof(PointNode) <
+                header.node_count) {
+            return false;
+        }
+        for (std::uint32_t i = 0; i < header.node_count; i++) {
+            PointNode n;
+            std::memcpy(&n,
+                        file.data() + header.table_offset +
+                            i * sizeof(PointNode),
+                        sizeof n);
+            if (n.offset > file.size() ||
+                (file.size() - n.offset) / sizeof(CloudPoint) < n.count) {
+                return false;
+            }
+            // children follow their parent, which rules out cycles
+            for (const std::uint32_t c : n.children) {
+                if (c != 0 && (c <= i || c >= header.node_count)) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+private:
+    PointCloud(const PointCloud& o);
+    PointCloud& operator=(const PointCloud& o);
+
+    struct Resident {
+        GLuint vao;
+        GLuint vbo;
+        GLsizei count;
+        unsigned int frame;  // last update() that selected it
+        std::list<std::uint32_t>::iterator lru;
+    };
+
+    struct Staged {
+        std::uint32_t node;
+        std::vector<CloudPoint> points;
+    };
+
+    PointNode Node(std::uint32_t i) const {
+        PointNode n;
+        std::memcpy(&n,
+                    m_file.data() + m_header.table_offset +
+                        i * sizeof(PointNode),
+                    sizeof n);
+        return n;
+    }
+
+    void Request(std::uint32_t i) {
+        static constexpr std::size_t max_requests(16);
+        if (m_pending.size() >= max_requests ||
+            !m_pending.emplace(i, 0).second) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_jobs.emplace_back(i);
+        }
+        m_cond.notify_one();
+    }
+
+    // Uploads copied nodes, evicting the least recently selected ones that
+    // the current frame does not need.
+    void Stream(GLsizeiptr upload) {
+        GLsizeiptr uploaded(0);
+        std::unique_ptr<Staged> s;
+        while (uploaded < upload && m_staged.pop(s)) {
+            m_pending.erase(s->node);
+            const GLsizeiptr bytes(s->points.size() * sizeof(CloudPoint));
+            while (m_resident + bytes > m_budget && !m_lru.empty() &&
+                   m_cache[m_lru.back()].frame != m_frame) {
+                Resident& r(m_cache[m_lru.back()]);
+                glDeleteVertexArrays(1, &r.vao);
+                glDeleteBuffers(1, &r.vbo);
+                m_resident -= r.count * sizeof(CloudPoint);
+                DefaultMemoryTracker().release(MemoryTag::STREAMING,
+                                               MemoryKind::GPU,
+                                               r.count * sizeof(CloudPoint));
+                m_cache.erase(m_lru.back());
+                m_lru.pop_back();
+            }
+            if (m_resident + bytes > m_budget) continue;  // all in use
+
+            Resident r;
+            r.count = static_cast<GLsizei>(s->points.size());
+            r.frame = m_frame;
+            glGenVertexArrays(1, &r.vao);
+            glBindVertexArray(r.vao);
+            glGenBuffers(1, &r.vbo);
+            glBindBuffer(GL_ARRAY_BUFFER, r.vbo);
+            glBufferData(GL_ARRAY_BUFFER, bytes, s->points.data(),
+                         GL_STATIC_DRAW);
+            const GLsizei stride(sizeof(CloudPoint));
+            char* const base(static_cast<char*>(0));
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride,
+                                  base + offsetof(CloudPoint, position));
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(5, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                                  base + offsetof(CloudPoint, color));
+            glEnableVertexAttribArray(5);
+            m_lru.emplace_front(s->node);
+            r.lru = m_lru.begin();
+            m_cache.emplace(s->node, r);
+            m_resident += bytes;
+            uploaded += bytes;
+            DefaultMemoryTracker().allocate(MemoryTag::STREAMING,
+                                            MemoryKind::GPU, bytes);
+        }
     }
 
-    virtual ~Object() {
-        glDeleteBuffers(1, &m_vao);
-        glDeleteBuffers(1, &m_vbo);
-        glDeleteBuffers(1, &m_ibo);
+    void Work() {
+        for (;;) {
+            std::uint32_t i;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cond.wait(lock, [this] { return m_quit || !m_jobs.empty(); });
+                if (m_quit) return;
+                i = m_jobs.front();
+                m_jobs.pop_front();
+            }
+            // page faults of the mapping happen here, not on the GL thread
+            const PointNode n(Node(i));
+            const CloudPoint* const p(
+                reinterpret_cast<const CloudPoint*>(m_file.data() + n.offset));
+            std::unique_ptr<Staged> s(new Staged());
+            s->node = i;
+            s->points.assign(p, p + n.count);
+            m_staged.push(std::move(s));
+        }
     }
 
-    void bind() const { glBindVertexArray(m_vao); }
+    static const char* VertexSource() {
+        return "#version 150 core\n"
+               "uniform mat4 modelview;\n"
+               "uniform mat4 projection;\n"
+               "uniform float scale;\n"
+               "uniform float size;\n"
+               "in vec4 position;\n"
+               "in vec4 color;\n"
+               "out vec4 tint;\n"
+               "void main() {\n"
+               "    vec4 p = modelview * position;\n"
+               "    gl_Position = projection * p;\n"
+               "    gl_PointSize = clamp(size * scale / max(-p.z, 1e-4), "
+               "1.0, 64.0);\n"
+               "    tint = color;\n"
+               "}\n";
+    }
 
-private:
-    Object(const Object& o);
-    Object& operator=(const Object& o);
+    static const char* FragmentSource() {
+        return "#version 150 core\n"
+               "in vec4 tint;\n"
+               "out vec4 fragment;\n"
+               "void main() {\n"
+               "    vec2 d = gl_PointCoord * 2.0 - 1.0;\n"
+               "    if (dot(d, d) > 1.0) discard;\n"
+               "    fragment = tint;\n"
+               "}\n";
+    }
 
-    GLuint m_vao;
-    GLuint m_vbo;
-    GLuint m_ibo;
+    const MappedFile m_file;
+    PointCloudHeader m_header;
+    const GLsizeiptr m_budget;
+    GLsizeiptr m_resident;
+    Program m_program;
+    Matrix m_modelview;
+    Matrix m_projection;
+    GLfloat m_pixels;
+    GLfloat m_scale;  // of the modelview, applied to node spacings
+    unsigned int m_frame;
+    GLsizei m_points;
+    GLsizei m_drawn;
+    std::vector<std::uint32_t> m_selected;
+    std::unordered_map<std::uint32_t, Resident> m_cache;
+    std::list<std::uint32_t> m_lru;  // most recently selected first
+    std::unordered_map<std::uint32_t, char> m_pending;
+
+    std::thread m_worker;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<std::uint32_t> m_jobs;
+    bool m_quit;
+    MPSCQueue<std::unique_ptr<Staged>> m_staged;  // worker -> GL thread
 };
 
-using Object2D = Object<2>;
-using Object3D = Object<3>;
+// =============================== Picking =================================
 
-template <int N>
-class Geometry {
-public:
-    Geometry(GLint size, GLsizei vtx_cnt, const Vertex<N>* vtx,
-             GLsizei idx_cnt = 0, const GLuint* idx = nullptr)
-        : m_obj(new Object<N>(size, vtx_cnt, vtx, idx_cnt, idx)),
-          m_vtx_cnt(vtx_cnt) {}
+// What was drawn at a pixel; 0 means nothing.
+struct PickResult {
+    GLuint object;     // id given to PickBuffer::select()
+    GLuint primitive;  // gl_PrimitiveID + 1 within that draw
+    GLint x, y;        // hit pixel, window coordinates from the top left
+};
 
-    void draw(GLenum mode = GL_LINE_LOOP) const {
-        m_obj->bind();
-        execute(mode);
+// Renders object and primitive IDs into an RG32UI target and reads back
+// only a `region` x `region` square around the cursor into a ring of pixel
+// buffers, each guarded by a fence. poll() hands out the newest finished
+// readback, typically a frame or two old, without ever waiting on the GPU.
+class PickBuffer {
+public:
+    PickBuffer(GLsizei width, GLsizei height, GLsizei region = 7)
+        : m_target(width, height, {GL_RG32UI}),
+          m_program(CreateProgram(VertexSource(), FragmentSource())),
+          m_region(std::max(region | 1, 1)),
+          m_next(0),
+          m_memory(MemoryTag::TARGET) {
+        glGenBuffers(slots, m_pbo);
+        for (int i = 0; i < slots; i++) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbo[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER,
+                         m_region * m_region * 2 * sizeof(GLuint), nullptr,
+                         GL_STREAM_READ);
+            m_memory.add(m_region * m_region * 2 * sizeof(GLuint));
+            m_fences[i] = nullptr;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
     }
 
-    virtual void execute(GLenum mode = GL_LINE_LOOP) const {
-        glDrawArrays(mode, 0, m_vtx_cnt);
+    virtual ~PickBuffer() {
+        for (GLsync f : m_fences) {
+            if (f != nullptr) glDeleteSync(f);
+        }
+        glDeleteBuffers(slots, m_pbo);
     }
 
-private:
-    std::shared_ptr<const Object<N>> m_obj;
-    const GLsizei m_vtx_cnt;
-};
-
-using Geometry2D = Geometry<2>;
-using Geometry3D = Geometry<3>;
-
-template <int N>
-class GeometryIndex : public Geometry<N> {
-public:
-    GeometryIndex(GLint size, GLsizei vtx_cnt, const Vertex<N>* vtx,
-                  GLsizei idx_cnt = 0, const GLuint* idx = nullptr)
-        : Geometry<N>(size, vtx_cnt, vtx, idx_cnt, idx), m_idx_cnt(idx_cnt) {}
+    void resize(GLsizei width, GLsizei height) {
+        m_target.resize(width, height);
+    }
 
-    virtual void execute(GLenum mode = GL_LINES) const {
-        glDrawElements(mode, m_idx_cnt, GL_UNSIGNED_INT, 0);
+    // Binds the ID target cleared to 0 and the ID program.
+    void begin() {
+        m_target.bind();
+        static constexpr GLuint zero[4] = {};
+        glClearBufferuiv(GL_COLOR, 0, zero);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        m_program.use();
     }
 
-protected:
-    const GLsizei m_idx_cnt;
-};
+    // Tags the following draws with `object` (non-zero); draw them with
+    // their own draw() between begin() and end().
+    void select(GLuint object, const Matrix& modelview,
+                const Matrix& projection) {
+        m_program.set("modelview"_hash, modelview);
+        m_program.set("projection"_hash, projection);
+        m_program.set("object"_hash, static_cast<GLint>(object));
+    }
 
-using GeometryIndex2D = GeometryIndex<2>;
-using GeometryIndex3D = GeometryIndex<3>;
+    // Queues the readback around (`x`, `y`), cursor coordinates in pixels
+    // from the top left, and binds the window's framebuffer again. Skipped
+    // when every pixel buffer is still in flight.
+    void end(double x, double y) {
+        const int slot(m_next);
+        if (m_fences[slot] != nullptr) {
+            if (!Signaled(m_fences[slot])) {
+                Restore();
+                return;
+            }
+            glDeleteSync(m_fences[slot]);  // superseded by this readback
+        }
+        const GLint cx(static_cast<GLint>(std::floor(x)));
+        const GLint cy(m_target.height() - 1 -
+                       static_cast<GLint>(std::floor(y)));
+        Rect& r(m_rects[slot]);
+        r.x = std::min(std::max(cx - m_region / 2, 0),
+                       std::max(m_target.width() - m_region, 0));
+        r.y = std::min(std::max(cy - m_region / 2, 0),
+                       std::max(m_target.height() - m_region, 0));
+        r.w = std::min(m_region, m_target.width());
+        r.h = std::min(m_region, m_target.height());
+        r.cx = cx;
+        r.cy = cy;
 
-// ============================== Material =================================
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, m_target.framebuffer());
+        glReadBuffer(GL_COLOR_ATTACHMENT0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbo[slot]);
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+        glReadPixels(r.x, r.y, r.w, r.h, GL_RG_INTEGER, GL_UNSIGNED_INT, 0);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        m_fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        m_next = (slot + 1) % slots;
+        Restore();
+    }
 
-struct Material {
-    alignas(16) std::array<GLfloat, 3> ambient;
-    alignas(16) std::array<GLfloat, 3> diffuse;
-    alignas(16) std::array<GLfloat, 3> specular;
-    alignas(4) GLfloat shininess;
-};
+    // Takes the newest readback the GPU has finished, if any. The hit is
+    // the pixel under the cursor, or else the nearest one with an object.
+    bool poll(PickResult& result) {
+        bool found(false);
+        for (int i = 0; i < slots; i++) {  // oldest first
+            const int slot((m_next + i) % slots);
+            GLsync& f(m_fences[slot]);
+            if (f == nullptr || !Signaled(f)) continue;
+            glDeleteSync(f);
+            f = nullptr;
 
-template <typename T>
-class Uniform {
-public:
-    Uniform(const T* data = NULL, unsigned int count = 1)
-        : m_buffer(new UniformBuffer(data, count)) {}
-    virtual ~Uniform() {}
-    void set(const T* data, unsigned int i = 0, unsigned int count = 1) const {
-        glBindBuffer(GL_UNIFORM_BUFFER, m_buffer->ubo);
-        for (unsigned int i = 0; i < count; i++) {
-            glBufferSubData(GL_UNIFORM_BUFFER, i * m_buffer->block_size,
-                            sizeof(T), data + i);
+            const Rect& r(m_rects[slot]);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, m_pbo[slot]);
+            const GLuint* const ids(static_cast<const GLuint*>(
+                glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                 r.w * r.h * 2 * sizeof(GLuint),
+                                 GL_MAP_READ_BIT)));
+            if (ids == nullptr) {
+                glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+                continue;
+            }
+            result = {0, 0, r.cx, m_target.height() - 1 - r.cy};
+            GLint best(INT_MAX);
+            for (GLint y = 0; y < r.h; y++) {
+                for (GLint x = 0; x < r.w; x++) {
+                    const GLuint* const id(ids + (y * r.w + x) * 2);
+                    const GLint dx(r.x + x - r.cx), dy(r.y + y - r.cy);
+                    if (id[0] == 0 || dx * dx + dy * dy >= best) continue;
+                    best = dx * dx + dy * dy;
+                    result = {id[0], id[1], r.x + x,
+                              m_target.height() - 1 - (r.y + y)};
+                }
+            }
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            found = true;
         }
+        return found;
     }
-    void select(unsigned int i = 0, GLuint binding_point = 0) const {
-        glBindBufferRange(GL_UNIFORM_BUFFER, binding_point, m_buffer->ubo,
-                          i * m_buffer->block_size, sizeof(T));
-    }
+
+    const RenderTarget& target() const { return m_target; }
 
 private:
-    struct UniformBuffer {
-        GLuint ubo;  // uniform buffer object
-        GLsizeiptr block_size;
-        UniformBuffer(const T* data, unsigned int count) {
-            // Get uniform block size
-            GLint alignment;
-            glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
-            block_size = (((sizeof(T) - 1) / alignment) + 1) * alignment;
+    PickBuffer(const PickBuffer& o);
+    PickBuffer& operator=(const PickBuffer& o);
 
-            // Create ubo
-            glGenBuffers(1, &ubo);
-            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
-            glBufferData(GL_UNIFORM_BUFFER, count * block_size, NULL,
-                         GL_STATIC_DRAW);
-            for (unsigned int i = 0; i < count; i++) {
-                glBufferSubData(GL_UNIFORM_BUFFER, i * block_size, sizeof(T),
-                                data + i);
-            }
-        }
+    static constexpr int slots = 3;
 
-        ~UniformBuffer() { glDeleteBuffers(1, &ubo); }
+    struct Rect {
+        GLint x, y, w, h;  // read area, bottom-left origin
+        GLint cx, cy;      // cursor
     };
 
-    const std::shared_ptr<const UniformBuffer> m_buffer;
+    static bool Signaled(GLsync f) {
+        const GLenum r(glClientWaitSync(f, 0, 0));
+        return r == GL_ALREADY_SIGNALED || r == GL_CONDITION_SATISFIED;
+    }
+
+    void Restore() const {
+        RenderTarget::BindDefault(m_target.width(), m_target.height());
+    }
+
+    static const char* VertexSource() {
+        return "#version 150 core\n"
+               "uniform mat4 modelview;\n"
+               "uniform mat4 projection;\n"
+               "in vec4 position;\n"
+               "void main() { gl_Position = projection * modelview * "
+               "position; }\n";
+    }
+
+    static const char* FragmentSource() {
+        return "#version 150 core\n"
+               "uniform int object;\n"
+               "out uvec2 fragment;\n"
+               "void main() {\n"
+               "    fragment = uvec2(object, gl_PrimitiveID + 1);\n"
+               "}\n";
+    }
+
+    RenderTarget m_target;
+    Program m_program;
+    const GLsizei m_region;
+    GLuint m_pbo[slots];
+    GLsync m_fences[slots];
+    Rect m_rects[slots];
+    int m_next;  // slot of the next readback
+    MemoryRecord m_memory;
 };
 
-// ============================= Primitive =================================
+// ========================== Implementation ===============================
+// Exactly one translation unit defines TGR_IMPLEMENTATION before including
+// this header (tiny_glfw_renderer.cpp when built as a library).
+#ifdef TGR_IMPLEMENTATION
 
+template class Object<2>;
+template class Object<3>;
+template class Geometry<2>;
+template class Geometry<3>;
+template class GeometryIndex<2>;
+template class GeometryIndex<3>;
+template class DynamicGeometry<2>;
+template class DynamicGeometry<3>;
+template class Uniform<Material>;
+
+// ============================= Primitive =================================
 std::unique_ptr<const Geometry2D> Rectangle(GLfloat x, GLfloat y, GLfloat w,
                                             GLfloat h) {
     const Vertex2D rectangle_vtx[] = {
@@ -255,20 +8515,28 @@ std::unique_ptr<const Geometry2D> Rectangle(GLfloat x, GLfloat y, GLfloat w,
     return shape;
 }
 
-std::unique_ptr<const Geometry3D> Octahedron(GLfloat s = 1.0f) {
+std::unique_ptr<const Geometry3D> Octahedron(GLfloat s) {
+    // normals point away from the center
     const Vertex3D octahedron_vtx[] = {
-        {{0.0f, s, 0.0f}},  {{-s, 0.0f, 0.0f}}, {{0.0f, -s, 0.0f}},
-        {{s, 0.0f, 0.0f}},  {{0.0f, s, 0.0f}},  {{0.0f, 0.0f, s}},
-        {{0.0f, -s, 0.0f}}, {{0.0f, 0.0f, -s}}, {{-s, 0.0f, 0.0f}},
-        {{0.0f, 0.0f, s}},  {{s, 0.0f, 0.0f}},  {{0.0f, 0.0f, -s}}};
+        {{0.0f, s, 0.0f}, {0.0f, 1.0f, 0.0f}},
+        {{-s, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f}},
+        {{0.0f, -s, 0.0f}, {0.0f, -1.0f, 0.0f}},
+        {{s, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}},
+        {{0.0f, s, 0.0f}, {0.0f, 1.0f, 0.0f}},
+        {{0.0f, 0.0f, s}, {0.0f, 0.0f, 1.0f}},
+        {{0.0f, -s, 0.0f}, {0.0f, -1.0f, 0.0f}},
+        {{0.0f, 0.0f, -s}, {0.0f, 0.0f, -1.0f}},
+        {{-s, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f}},
+        {{0.0f, 0.0f, s}, {0.0f, 0.0f, 1.0f}},
+        {{s, 0.0f, 0.0f}, {1.0f, 0.0f, 0.0f}},
+        {{0.0f, 0.0f, -s}, {0.0f, 0.0f, -1.0f}}};
     std::unique_ptr<const Geometry3D> shape(
         new Geometry3D(3, 12, octahedron_vtx));
     return shape;
 }
 
-std::unique_ptr<const GeometryIndex3D> WireCube(GLfloat s = 1.0f,
-                                                GLfloat d = 0.8f,
-                                                GLfloat t = 0.1f) {
+std::unique_ptr<const GeometryIndex3D> WireCube(GLfloat s, GLfloat d,
+                                                GLfloat t) {
     const Vertex3D cube_vtx[] = {
         {{-s, -s, -s}, {t, t, t}},  // 0
         {{-s, -s, s}, {t, t, d}},   // 1
@@ -298,7 +8566,7 @@ std::unique_ptr<const GeometryIndex3D> WireCube(GLfloat s = 1.0f,
     return shape;
 }
 
-std::unique_ptr<const GeometryIndex3D> SolidCube(GLfloat s = 1.0f) {
+std::unique_ptr<const GeometryIndex3D> SolidCube(GLfloat s) {
     const Vertex3D cube_vtx[] = {
         // left
         {{-s, -s, -s}, {-1.0f, 0.0f, 0.0f}},
@@ -351,184 +8619,96 @@ std::unique_ptr<const GeometryIndex3D> SolidCube(GLfloat s = 1.0f) {
 
     const GLuint cube_idx[] = {
         0,  1,  2,  3,  4,  5,   // left
-        6,  7,  8,  9,  10, 11,  // back
-        12, 13, 14, 15, 16, 17,  // bottom
-        18, 19, 20, 21, 22, 23,  // right
-        24, 25, 26, 27, 28, 29,  // top
-        30, 31, 32, 33, 34, 35   // front
-    };
-
-    std::unique_ptr<const GeometryIndex3D> shape(
-        new GeometryIndex3D(3, 36, cube_vtx, 36, cube_idx));
-    return shape;
-}
-
-std::unique_ptr<const GeometryIndex3D> SolidSphere(int samples = 8) {
-    const float PI = 3.141592653;
-    const int slices(2 * samples), stacks(samples);
-
-    std::vector<Vertex3D> sphere_vtx;
-    for (int j = 0; j <= stacks; j++) {
-        const float t(static_cast<float>(j) / static_cast<float>(stacks));
-        const float y(std::cos(PI * t)), r(std::sin(PI * t));
-        for (int i = 0; i <= slices; i++) {
-            const float s(static_cast<float>(i) / static_cast<float>(samples));
-            const float z(r * std::cos(2 * PI * s)),
-                x(r * std::sin(2 * PI * s));
-            const Vertex3D v = {{x, y, z}, {x, y, z}};
-            sphere_vtx.emplace_back(v);
-        }
-    }
-
-    std::vector<GLuint> sphere_idx;
-    for (int j = 0; j < stacks; j++) {
-        const int k((slices + 1) * j);
-        for (int i = 0; i < slices; i++) {
-            const GLuint k0(k + i);
-            const GLuint k1(k0 + 1);
-            const GLuint k2(k1 + slices);
-            const GLuint k3(k2 + 1);
-
-            // left bottom
-            sphere_idx.emplace_back(k0);
-            sphere_idx.emplace_back(k2);
-            sphere_idx.emplace_back(k3);
-
-            // right up
-            sphere_idx.emplace_back(k0);
-            sphere_idx.emplace_back(k3);
-            sphere_idx.emplace_back(k1);
-        }
-    }
-
-    std::unique_ptr<const GeometryIndex3D> shape(new GeometryIndex3D(
-        3, static_cast<GLsizei>(sphere_vtx.size()), sphere_vtx.data(),
-        static_cast<GLsizei>(sphere_idx.size()), sphere_idx.data()));
-    return shape;
-}
-
-// ============================ Initializer ================================
-
-inline void Initialize() {
-    assert(glfwInit());
-    atexit(glfwTerminate);
-
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 2);
-    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-}
-
-inline GLboolean PrintShaderInfoLog(GLuint shader, const char* str) {
-    // Get compile outputs
-    GLint status;
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
-    if (status == GL_FALSE) std::cerr << "Error in " << str << std::endl;
-
-    // Get length of compile logs
-    GLsizei buf_size;
-    glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &buf_size);
-
-    // Show logs
-    if (buf_size > 1) {
-        std::vector<GLchar> info_log(buf_size);
-        GLsizei length;
-        glGetShaderInfoLog(shader, buf_size, &length, &info_log[0]);
-        std::cerr << &info_log[0] << std::endl;
-    }
-    return static_cast<GLboolean>(status);
-}
-
-inline GLboolean PrintProgramInfoLog(GLuint program) {
-    GLint status;
-    glGetProgramiv(program, GL_LINK_STATUS, &status);
-    if (status == GL_FALSE) std::cerr << "Link Error" << std::endl;
-
-    // Get length of link logs
-    GLsizei buf_size;
-    glGetProgramiv(program, GL_INFO_LOG_LENGTH, &buf_size);
-
-    // Show logs
-    if (buf_size > 1) {
-        std::vector<GLchar> info_log(buf_size);
-        GLsizei length;
-        glGetProgramInfoLog(program, buf_size, &length, &info_log[0]);
-        std::cerr << &info_log[0] << std::endl;
-    }
-    return static_cast<GLboolean>(status);
-}
-
-inline GLuint CreateProgram(const char* vsrc, const char* fsrc,
-                            bool use_normal = false) {
-    const GLuint program(glCreateProgram());
-    if (vsrc == nullptr || fsrc == nullptr) {
-        std::cout << "Incompatible shader source." << std::endl;
-        exit(1);
-    }
-
-    // Compile vertex shader
-    const GLuint vobj(glCreateShader(GL_VERTEX_SHADER));
-    glShaderSource(vobj, 1, &vsrc, NULL);
-    glCompileShader(vobj);
-    if (PrintShaderInfoLog(vobj, "vertex shader"))
-        glAttachShader(program, vobj);
-    glDeleteShader(vobj);
-
-    // Compile fragment shader
-    const GLuint fobj(glCreateShader(GL_FRAGMENT_SHADER));
-    glShaderSource(fobj, 1, &fsrc, NULL);
-    glCompileShader(fobj);
-    if (PrintShaderInfoLog(fobj, "fragment shader"))
-        glAttachShader(program, fobj);
-    glDeleteShader(fobj);
-
-    // Link shaders
-    glBindAttribLocation(program, 0, "position");
-    if (use_normal) {
-        glBindAttribLocation(program, 1, "normal");
-    }
-    glBindFragDataLocation(program, 0, "fragment");
-    glLinkProgram(program);
-    if (PrintProgramInfoLog(program)) return program;
-    glDeleteProgram(program);
-    return 0;
+        6,  7,  8,  9,  10, 11,  // back
+        12, 13, 14, 15, 16, 17,  // bottom
+        18, 19, 20, 21, 22, 23,  // right
+        24, 25, 26, 27, 28, 29,  // top
+        30, 31, 32, 33, 34, 35   // front
+    };
+
+    std::unique_ptr<const GeometryIndex3D> shape(
+        new GeometryIndex3D(3, 36, cube_vtx, 36, cube_idx));
+    return shape;
 }
 
-inline GLboolean ReadShaderSource(const std::string name,
-                                  std::vector<GLchar>& buffer) {
-    std::ifstream file(name, std::ios::binary);
-    if (file.fail()) {
-        std::cerr << "Error: Can't open " << name << std::endl;
-        return false;
+std::unique_ptr<const GeometryIndex3D> SolidSphere(int samples) {
+    const float PI = 3.141592653;
+    const int slices(2 * samples), stacks(samples);
+
+    TrackedVector<Vertex3D> sphere_vtx(
+        TrackingAllocator<Vertex3D>(MemoryTag::MESH));
+    for (int j = 0; j <= stacks; j++) {
+        const float t(static_cast<float>(j) / static_cast<float>(stacks));
+        const float y(std::cos(PI * t)), r(std::sin(PI * t));
+        for (int i = 0; i <= slices; i++) {
+            const float s(static_cast<float>(i) / static_cast<float>(samples));
+            const float z(r * std::cos(2 * PI * s)),
+                x(r * std::sin(2 * PI * s));
+            const Vertex3D v = {{x, y, z}, {x, y, z}};
+            sphere_vtx.emplace_back(v);
+        }
     }
 
-    // Allocate memory
-    file.seekg(0L, std::ios::end);
-    GLsizei length = static_cast<GLsizei>(file.tellg());
-    buffer.resize(length + 1);
+    TrackedVector<GLuint> sphere_idx(
+        TrackingAllocator<GLuint>(MemoryTag::MESH));
+    for (int j = 0; j < stacks; j++) {
+        const int k((slices + 1) * j);
+        for (int i = 0; i < slices; i++) {
+            const GLuint k0(k + i);
+            const GLuint k1(k0 + 1);
+            const GLuint k2(k1 + slices);
+            const GLuint k3(k2 + 1);
 
-    // Open file
-    file.seekg(0L, std::ios::beg);
-    file.read(buffer.data(), length);
-    buffer[length] = '\0';
+            // left bottom
+            sphere_idx.emplace_back(k0);
+            sphere_idx.emplace_back(k2);
+            sphere_idx.emplace_back(k3);
 
-    if (file.fail()) {
-        std::cerr << "Error: Could not read " << name << std::endl;
-        file.close();
-        return false;
+            // right up
+            sphere_idx.emplace_back(k0);
+            sphere_idx.emplace_back(k3);
+            sphere_idx.emplace_back(k1);
+        }
     }
 
-    file.close();
-    return true;
+    std::unique_ptr<const GeometryIndex3D> shape(new GeometryIndex3D(
+        3, static_cast<GLsizei>(sphere_vtx.size()), sphere_vtx.data(),
+        static_cast<GLsizei>(sphere_idx.size()), sphere_idx.data()));
+    return shape;
 }
 
-inline GLuint LoadProgram(const std::string vert_shader_file,
-                          const std::string frag_shader_file,
-                          bool use_normal = false) {
-    std::vector<GLchar> vsrc, fsrc;
-    const bool vst(ReadShaderSource(vert_shader_file, vsrc));
-    const bool fst(ReadShaderSource(frag_shader_file, fsrc));
-    return vst && fst ? CreateProgram(vsrc.data(), fsrc.data(), use_normal) : 0;
+std::unique_ptr<const TexturedGeometry> TexturedCube(GLfloat s) {
+    // normal, u and v axis of each face (u x v = normal)
+    static constexpr GLfloat faces[6][3][3] = {
+        {{1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, -1.0f}, {0.0f, 1.0f, 0.0f}},
+        {{-1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f}, {0.0f, 1.0f, 0.0f}},
+        {{0.0f, 1.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, -1.0f}},
+        {{0.0f, -1.0f, 0.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 0.0f, 1.0f}},
+        {{0.0f, 0.0f, 1.0f}, {1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}},
+        {{0.0f, 0.0f, -1.0f}, {-1.0f, 0.0f, 0.0f}, {0.0f, 1.0f, 0.0f}}};
+    static constexpr GLfloat corners[4][2] = {
+        {0.0f, 0.0f}, {1.0f, 0.0f}, {1.0f, 1.0f}, {0.0f, 1.0f}};
+
+    TrackedVector<TexturedVertex> cube_vtx(
+        TrackingAllocator<TexturedVertex>(MemoryTag::MESH));
+    TrackedVector<GLuint> cube_idx(TrackingAllocator<GLuint>(MemoryTag::MESH));
+    for (const auto& f : faces) {
+        const GLuint k(static_cast<GLuint>(cube_vtx.size()));
+        for (const auto& c : corners) {
+            TexturedVertex v = {{}, {f[0][0], f[0][1], f[0][2]}, {c[0], c[1]}};
+            for (int i = 0; i < 3; i++) {
+                v.position[i] = s * (f[0][i] + (2.0f * c[0] - 1.0f) * f[1][i] +
+                                     (2.0f * c[1] - 1.0f) * f[2][i]);
+            }
+            cube_vtx.emplace_back(v);
+        }
+        for (GLuint i : {0u, 1u, 2u, 0u, 2u, 3u}) cube_idx.emplace_back(k + i);
+    }
+
+    std::unique_ptr<const TexturedGeometry> shape(new TexturedGeometry(
+        static_cast<GLsizei>(cube_vtx.size()), cube_vtx.data(),
+        static_cast<GLsizei>(cube_idx.size()), cube_idx.data()));
+    return shape;
 }
 
 // ============================== GUI ===================================
@@ -538,7 +8718,18 @@ Window::Window(int width, int height, const char* title, GLFWmonitor* monitor,
       m_width(width),
       m_height(height),
       m_scale(100.0f),
-      m_location{0.0f, 0.0f} {
+      m_location{0.0f, 0.0f},
+      m_keys(GLFW_KEY_LAST + 1, false),
+      m_dragging(false),
+      m_cursor{0.0, 0.0},
+      m_last_time(0.0),
+      m_capture_fbo(0),
+      m_capture_rbo{0, 0},
+      m_capture_size{0, 0},
+      m_frames(0),
+      m_frame(0),
+      m_presented(0),
+      m_frame_start(0.0) {
     if (m_window == NULL) {
         std::cerr << "Can't create GLFW window." << std::endl;
         exit(1);
@@ -549,55 +8740,223 @@ Window::Window(int width, int height, const char* title, GLFWmonitor* monitor,
         std::cerr << "Can't initialize GLEW." << std::endl;
         exit(1);
     }
-    glfwSwapInterval(1);
+    const char* const capture(std::getenv("TGR_CAPTURE"));
+    const char* const frames(std::getenv("TGR_FRAMES"));
+    if (capture != nullptr) {
+        m_capture = capture;
+        m_frames = frames != nullptr ? std::max(std::atoi(frames), 1) : 60;
+    }
+    SetSwapInterval(m_capture.empty() ? 1 : 0);
+#ifdef TGR_ENABLE_TRACE
+    int fb_width, fb_height;
+    glfwGetFramebufferSize(m_window, &fb_width, &fb_height);
+    TraceRecorder::Start(fb_width, fb_height);
+#endif
+    // rendered at the window size, like the viewport set by Resize()
+    if (!m_capture.empty()) CaptureTarget(width, height);
     glfwSetWindowUserPointer(m_window, this);
     glfwSetWindowSizeCallback(m_window, Resize);
     glfwSetScrollCallback(m_window, Wheel);
+    glfwSetKeyCallback(m_window, Key);
+    glfwSetMouseButtonCallback(m_window, MouseButton);
+    glfwSetCursorPosCallback(m_window, Cursor);
     Resize(m_window, m_width, m_height);
     m_location[0] = m_location[1] = 0.0f;
+    m_last_time = GetTime();
 }
 
-Window::~Window() { glfwDestroyWindow(m_window); }
+Window::~Window() {
+#ifdef TGR_ENABLE_TRACE
+    TraceRecorder::Stop();
+#endif
+    CaptureTarget(0, 0);
+    glfwDestroyWindow(m_window);
+}
 
 int Window::ShouldClose() const {
-    return glfwWindowShouldClose(m_window) ||
-           glfwGetKey(m_window, GLFW_KEY_ESCAPE);
+    return glfwWindowShouldClose(m_window) || IsKeyDown(GLFW_KEY_ESCAPE) ||
+           (!m_capture.empty() && m_frame >= m_frames);
 }
 
 void Window::SwapBuffers() {
+    Present();
+    ProcessEvents();
+}
+
+void Window::Present() {
+    Present(static_cast<int>(m_width), static_cast<int>(m_height));
+}
+
+void Window::Present(int width, int height) {
+    if (!m_capture.empty()) {
+        Capture();
+        // follows resizes from the next frame on
+        if (width != m_capture_size[0] || height != m_capture_size[1]) {
+            CaptureTarget(width, height);
+        }
+    }
+#ifdef TGR_ENABLE_TRACE
+    TraceRecorder::Frame();
+#endif
     glfwSwapBuffers(m_window);
+    DefaultMemoryTracker().frame();
+}
+
+void Window::ProcessEvents() {
+    m_frame++;
     glfwPollEvents();
 
+    // Arrow keys move by 2 pixels per 1/60 s regardless of the frame rate
+    const double now(GetTime());
+    const GLfloat dt(
+        std::min(static_cast<GLfloat>(now - m_last_time) * 60.0f, 15.0f));
+    m_last_time = now;
+
     // Left or Right
-    if (glfwGetKey(m_window, GLFW_KEY_LEFT) != GLFW_RELEASE) {
-        m_location[0] -= 2.0f / m_width;
-    } else if (glfwGetKey(m_window, GLFW_KEY_RIGHT) != GLFW_RELEASE) {
-        m_location[0] += 2.0f / m_width;
+    if (IsKeyDown(GLFW_KEY_LEFT)) {
+        m_location[0] -= 2.0f * dt / m_width;
+    } else if (IsKeyDown(GLFW_KEY_RIGHT)) {
+        m_location[0] += 2.0f * dt / m_width;
     }
 
     // Down or Up
-    if (glfwGetKey(m_window, GLFW_KEY_DOWN) != GLFW_RELEASE) {
-        m_location[1] -= 2.0f / m_height;
-    } else if (glfwGetKey(m_window, GLFW_KEY_UP) != GLFW_RELEASE) {
-        m_location[1] += 2.0f / m_height;
+    if (IsKeyDown(GLFW_KEY_DOWN)) {
+        m_location[1] -= 2.0f * dt / m_height;
+    } else if (IsKeyDown(GLFW_KEY_UP)) {
+        m_location[1] += 2.0f * dt / m_height;
     }
 
     // Mouse
-    if (glfwGetMouseButton(m_window, GLFW_MOUSE_BUTTON_1) != GLFW_RELEASE) {
-        double x, y;
-        glfwGetCursorPos(m_window, &x, &y);
-        m_location[0] = static_cast<GLfloat>(x) * 2.0f / m_width - 1.0f;
-        m_location[1] = 1.0f - static_cast<GLfloat>(y) * 2.0f / m_height;
+    if (m_dragging) {
+        const GLfloat x(static_cast<GLfloat>(m_cursor[0]));
+        const GLfloat y(static_cast<GLfloat>(m_cursor[1]));
+        m_location[0] = x * 2.0f / m_width - 1.0f;
+        m_location[1] = 1.0f - y * 2.0f / m_height;
+    }
+}
+
+double Window::GetTime() const {
+    return m_capture.empty() ? glfwGetTime() : m_frame / 60.0;
+}
+
+// Times every frame including the GPU work, and writes the last frame to
+// <TGR_CAPTURE>.ppm and the frame times in milliseconds to <TGR_CAPTURE>.csv
+void Window::Capture() {
+    glFinish();
+    const double now(glfwGetTime());
+    if (m_presented > 0) {
+        m_frame_times.emplace_back((now - m_frame_start) * 1e3);
+    }
+    m_frame_start = now;
+    if (++m_presented < m_frames) return;
+
+    // pixels of a hidden window fail the pixel ownership test, so the frame
+    // was rendered into the capture target
+    Image image(m_capture_size[0], m_capture_size[1], 3);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, m_capture_fbo);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, image.width, image.height, GL_RGB, GL_UNSIGNED_BYTE,
+                 image.pixels.data());
+    WriteImage(m_capture + ".ppm", image);
+
+    std::ofstream file(m_capture + ".csv");
+    file << "frame_ms\n";
+    for (const double t : m_frame_times) file << t << "\n";
+}
+
+// (Re)creates the offscreen framebuffer of a captured run and makes it the
+// DefaultFramebuffer(); a zero size releases it.
+void Window::CaptureTarget(int width, int height) {
+    if (m_capture_fbo != 0) {
+        glDeleteFramebuffers(1, &m_capture_fbo);
+        glDeleteRenderbuffers(2, m_capture_rbo);
+        DefaultMemoryTracker().release(
+            MemoryTag::TARGET, MemoryKind::GPU,
+            8ull * m_capture_size[0] * m_capture_size[1], 2);
+        m_capture_fbo = DefaultFramebuffer() = 0;
+    }
+    m_capture_size[0] = width;
+    m_capture_size[1] = height;
+    if (width <= 0 || height <= 0) return;
+
+    static constexpr GLenum formats[] = {GL_RGBA8, GL_DEPTH24_STENCIL8};
+    static constexpr GLenum attachments[] = {GL_COLOR_ATTACHMENT0,
+                                             GL_DEPTH_STENCIL_ATTACHMENT};
+    glGenFramebuffers(1, &m_capture_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_capture_fbo);
+    glGenRenderbuffers(2, m_capture_rbo);
+    for (int i = 0; i < 2; i++) {
+        glBindRenderbuffer(GL_RENDERBUFFER, m_capture_rbo[i]);
+        // the multisample entry point with 0 samples is traced
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, 0, formats[i],
+                                         width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, attachments[i],
+                                  GL_RENDERBUFFER, m_capture_rbo[i]);
+        DefaultMemoryTracker().allocate(MemoryTag::TARGET, MemoryKind::GPU,
+                                        4ull * width * height);
+    }
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Error: Incomplete capture framebuffer." << std::endl;
+    }
+    DefaultFramebuffer() = m_capture_fbo;
+}
+
+void Window::MakeContextCurrent() { glfwMakeContextCurrent(m_window); }
+
+void Window::ReleaseContext() { glfwMakeContextCurrent(NULL); }
+
+void Window::SetSwapInterval(int interval) {
+    if (interval < 0 && !glfwExtensionSupported("WGL_EXT_swap_control_tear") &&
+        !glfwExtensionSupported("GLX_EXT_swap_control_tear")) {
+        interval = 1;
+    }
+    glfwSwapInterval(interval);
+}
+
+bool Window::PollEvent(InputEvent& e) {
+    if (m_events.empty()) return false;
+    e = m_events.front();
+    m_events.pop_front();
+    return true;
+}
+
+void Window::OnResize(const std::function<void(int, int)>& listener) {
+    m_resize_listeners.emplace_back(listener);
+}
+
+bool Window::IsKeyDown(int key) const {
+    return key >= 0 && key < static_cast<int>(m_keys.size()) && m_keys[key];
+}
+
+void Window::Push(const InputEvent& e) {
+    // keep the queue bounded when nobody consumes it, giving up cursor
+    // motion, which GetCursor() still reports, before keys and buttons
+    if (m_events.size() >= 256) {
+        if (e.type == InputEvent::CURSOR &&
+            m_events.back().type == InputEvent::CURSOR) {
+            m_events.back() = e;
+            return;
+        }
+        const auto cursor(std::find_if(
+            m_events.begin(), m_events.end(),
+            [](const InputEvent& q) { return q.type == InputEvent::CURSOR; }));
+        m_events.erase(cursor != m_events.end() ? cursor : m_events.begin());
     }
+    m_events.emplace_back(e);
 }
 
 void Window::Resize(GLFWwindow* const window, int width, int height) {
-    glViewport(0, 0, width, height);
+    // a RenderThread sets the viewport itself
+    if (glfwGetCurrentContext() == window) glViewport(0, 0, width, height);
     Window* const instance(
         static_cast<Window*>(glfwGetWindowUserPointer(window)));
     if (instance != nullptr) {
         instance->m_width = width;
         instance->m_height = height;
+        for (const auto& listener : instance->m_resize_listeners) {
+            listener(width, height);
+        }
     }
 }
 
@@ -606,6 +8965,44 @@ void Window::Wheel(GLFWwindow* const window, double x, double y) {
         static_cast<Window*>(glfwGetWindowUserPointer(window)));
     if (instance != NULL) {
         instance->m_scale += static_cast<GLfloat>(y);
+        instance->Push({InputEvent::SCROLL, 0, 0, 0, x, y, glfwGetTime()});
+    }
+}
+
+void Window::Key(GLFWwindow* const window, int key, int scancode, int action,
+                 int mods) {
+    Window* const instance(
+        static_cast<Window*>(glfwGetWindowUserPointer(window)));
+    if (instance != nullptr) {
+        if (key >= 0 && key <= GLFW_KEY_LAST) {
+            instance->m_keys[key] = action != GLFW_RELEASE;
+        }
+        instance->Push({InputEvent::KEY, key, action, mods, 0.0, 0.0,
+                        glfwGetTime()});
+    }
+}
+
+void Window::MouseButton(GLFWwindow* const window, int button, int action,
+                         int mods) {
+    Window* const instance(
+        static_cast<Window*>(glfwGetWindowUserPointer(window)));
+    if (instance != nullptr) {
+        if (button == GLFW_MOUSE_BUTTON_1) {
+            instance->m_dragging = action != GLFW_RELEASE;
+        }
+        instance->Push({InputEvent::MOUSE_BUTTON, button, action, mods,
+                        instance->m_cursor[0], instance->m_cursor[1],
+                        glfwGetTime()});
+    }
+}
+
+void Window::Cursor(GLFWwindow* const window, double x, double y) {
+    Window* const instance(
+        static_cast<Window*>(glfwGetWindowUserPointer(window)));
+    if (instance != nullptr) {
+        instance->m_cursor[0] = x;
+        instance->m_cursor[1] = y;
+        instance->Push({InputEvent::CURSOR, 0, 0, 0, x, y, glfwGetTime()});
     }
 }
 
@@ -614,24 +9011,9 @@ GLfloat Window::GetHeight() const { return m_height; }
 GLfloat Window::GetAspect() const { return m_width / m_height; }
 GLfloat Window::GetScale() const { return m_scale; }
 const GLfloat* Window::GetLocation() const { return m_location; }
+const double* Window::GetCursor() const { return m_cursor; }
 
 // ============================= Matrix =================================
-Matrix::Matrix(const GLfloat* a) { std::copy(a, a + 16, m_matrix); }
-
-const GLfloat* Matrix::Data() const { return m_matrix; }
-
-Matrix Matrix::operator*(const Matrix& m) const {
-    Matrix t;
-    for (int i = 0; i < 16; i++) {
-        const int j(i & 3), k(i & ~3);
-        t.m_matrix[i] = m_matrix[0 + j] * m.m_matrix[k + 0] +
-                        m_matrix[4 + j] * m.m_matrix[k + 1] +
-                        m_matrix[8 + j] * m.m_matrix[k + 2] +
-                        m_matrix[12 + j] * m.m_matrix[k + 3];
-    }
-    return t;
-}
-
 void Matrix::GetNormalMatrix(GLfloat* m) const {
     m[0] = m_matrix[5] * m_matrix[10] - m_matrix[6] * m_matrix[9];
     m[1] = m_matrix[6] * m_matrix[8] - m_matrix[4] * m_matrix[10];
@@ -644,29 +9026,6 @@ void Matrix::GetNormalMatrix(GLfloat* m) const {
     m[8] = m_matrix[0] * m_matrix[5] - m_matrix[1] * m_matrix[4];
 }
 
-Matrix Matrix::Identity() {
-    Matrix t;
-    std::fill(t.m_matrix, t.m_matrix + 16, 0.0f);
-    t.m_matrix[0] = t.m_matrix[5] = t.m_matrix[10] = t.m_matrix[15] = 1.0f;
-    return t;
-}
-
-Matrix Matrix::Translate(GLfloat x, GLfloat y, GLfloat z) {
-    Matrix t(Identity());
-    t.m_matrix[12] = x;
-    t.m_matrix[13] = y;
-    t.m_matrix[14] = z;
-    return t;
-}
-
-Matrix Matrix::Scale(GLfloat x, GLfloat y, GLfloat z) {
-    Matrix t(Identity());
-    t.m_matrix[0] = x;
-    t.m_matrix[5] = y;
-    t.m_matrix[10] = z;
-    return t;
-}
-
 Matrix Matrix::Rotate(GLfloat theta, GLfloat x, GLfloat y, GLfloat z) {
     Matrix t(Identity());
     const GLfloat d(std::sqrt(x * x + y * y + z * z));
@@ -674,122 +9033,23 @@ Matrix Matrix::Rotate(GLfloat theta, GLfloat x, GLfloat y, GLfloat z) {
 
     // Rodrigues' rotation formula
     const GLfloat l(x / d), m(y / d), n(z / d);
+    const GLfloat c(std::cos(theta)), s(std::sin(theta)), v(1.0f - c);
 
-    t.m_matrix[0] = l * l * (1 - std::cos(theta)) + std::cos(theta);
-    t.m_matrix[1] = l * m * (1 - std::cos(theta)) + n * std::sin(theta);
-    t.m_matrix[2] = l * n * (1 - std::cos(theta)) - m * std::sin(theta);
-
-    t.m_matrix[4] = l * m * (1 - std::cos(theta)) - n * std::sin(theta);
-    t.m_matrix[5] = m * m * (1 - std::cos(theta)) + std::cos(theta);
-    t.m_matrix[6] = m * n * (1 - std::cos(theta)) + l * std::sin(theta);
-
-    t.m_matrix[8] = l * n * (1 - std::cos(theta)) + m * std::sin(theta);
-    t.m_matrix[9] = m * n * (1 - std::cos(theta)) - l * std::sin(theta);
-    t.m_matrix[10] = n * n * (1 - std::cos(theta)) + std::cos(theta);
-
-    return t;
-}
-Matrix Matrix::LookAt(GLfloat ex, GLfloat ey, GLfloat ez,  // eye position
-                      GLfloat gx, GLfloat gy, GLfloat gz,  // target position
-                      GLfloat ux, GLfloat uy, GLfloat uz   // upper vector
-) {
-    // translation
-    const Matrix tv(Translate(-ex, -ey, -ez));
-
-    // t = e - g
-    const GLfloat tx(ex - gx);
-    const GLfloat ty(ey - gy);
-    const GLfloat tz(ez - gz);
-
-    // r = u x t
-    const GLfloat rx(uy * tz - uz * ty);
-    const GLfloat ry(uz * tx - ux * tz);
-    const GLfloat rz(ux * ty - uy * tx);
-
-    // s = t x r
-    const GLfloat sx(ty * rz - tz * ry);
-    const GLfloat sy(tz * rx - tx * rz);
-    const GLfloat sz(tx * ry - ty * rx);
-
-    const GLfloat s2(sx * sx + sy * sy + sz * sz);
-    if (s2 == 0.0f) return tv;
-
-    Matrix rv(Identity());  // rotation
-
-    const GLfloat r(std::sqrt(rx * rx + ry * ry + rz * rz));
-    rv.m_matrix[0] = rx / r;
-    rv.m_matrix[4] = ry / r;
-    rv.m_matrix[8] = rz / r;
-
-    const GLfloat s(std::sqrt(s2));
-    rv.m_matrix[1] = sx / s;
-    rv.m_matrix[5] = sy / s;
-    rv.m_matrix[9] = sz / s;
-
-    const GLfloat t(std::sqrt(tx * tx + ty * ty + tz * tz));
-    rv.m_matrix[2] = tx / t;
-    rv.m_matrix[6] = ty / t;
-    rv.m_matrix[10] = tz / t;
-
-    return rv * tv;
-}
-
-Matrix Matrix::Orthogonal(GLfloat left, GLfloat right, GLfloat bottom,
-                          GLfloat top, GLfloat z_near, GLfloat z_far) {
-    Matrix t(Identity());
-    const GLfloat dx(right - left);
-    const GLfloat dy(top - bottom);
-    const GLfloat dz(z_far - z_near);
-
-    if (dx != 0.0f && dy != 0.0f && dz != 0.0f) {
-        t.m_matrix[0] = 2.0f / dx;
-        t.m_matrix[5] = 2.0f / dy;
-        t.m_matrix[10] = -2.0f / dz;
-        t.m_matrix[12] = -(right + left) / dx;
-        t.m_matrix[13] = -(top + bottom) / dy;
-        t.m_matrix[14] = -(z_far + z_near) / dz;
-    }
-
-    return t;
-}
+    t.m_matrix[0] = l * l * v + c;
+    t.m_matrix[1] = l * m * v + n * s;
+    t.m_matrix[2] = l * n * v - m * s;
 
-Matrix Matrix::Frustum(GLfloat left, GLfloat right, GLfloat bottom, GLfloat top,
-                       GLfloat z_near, GLfloat z_far) {
-    Matrix t(Identity());
-    const GLfloat dx(right - left);
-    const GLfloat dy(top - bottom);
-    const GLfloat dz(z_far - z_near);
+    t.m_matrix[4] = l * m * v - n * s;
+    t.m_matrix[5] = m * m * v + c;
+    t.m_matrix[6] = m * n * v + l * s;
 
-    if (dx != 0.0f && dy != 0.0f && dz != 0.0f) {
-        t.m_matrix[0] = 2.0f + z_near / dx;
-        t.m_matrix[5] = 2.0f + z_near / dy;
-        t.m_matrix[8] = (right + left) / dx;
-        t.m_matrix[9] = (top + bottom) / dy;
-        t.m_matrix[10] = -(z_far + z_near) / dz;
-        t.m_matrix[11] = -1.0f;
-        t.m_matrix[14] = -2.0f * z_far * z_near / dz;
-        t.m_matrix[15] = 0.0f;
-    }
+    t.m_matrix[8] = l * n * v + m * s;
+    t.m_matrix[9] = m * n * v - l * s;
+    t.m_matrix[10] = n * n * v + c;
 
     return t;
 }
 
-Matrix Matrix::Perspective(GLfloat fovy, GLfloat aspect, GLfloat z_near,
-                           GLfloat z_far) {
-    Matrix t(Identity());
-    const GLfloat dz(z_far - z_near);
-
-    if (dz != 0.0f) {
-        float f = 1.0f / std::tan(fovy * 0.5f);
-        t.m_matrix[0] = f / aspect;
-        t.m_matrix[5] = f;
-        t.m_matrix[10] = -(z_far + z_near) / dz;
-        t.m_matrix[11] = -1.0f;
-        t.m_matrix[14] = -2.0f * z_far * z_near / dz;
-        t.m_matrix[15] = 0.0f;
-    }
-
-    return t;
-}
+#endif  // TGR_IMPLEMENTATION
 
 }  // namespace tiny_glfw_renderer